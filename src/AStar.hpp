@@ -0,0 +1,210 @@
+#ifndef ASTAR_HPP
+#define ASTAR_HPP
+
+#include <cstdint>
+#include <memory>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "BucketQueue.hpp"
+
+
+/* A* search for a shortest path, guided by the Manhattan distance to the
+ * goals.
+ *
+ * For a set of goals the estimate is the distance to their bounding box,
+ * which never overestimates and is cheap to compute. All steps cost one, so
+ * the open list is a BucketQueue keyed on the estimated total length; cells
+ * with equal keys come out newest first, which follows one promising
+ * corridor instead of widening across all of them.
+ *
+ * The result is always a shortest path, of the same length as the one bfs()
+ * finds, but not necessarily the same path. The workspace reuses its arrays
+ * between calls with generation stamps, as SearchWorkspace does.
+ */
+template<int m, int n>
+class AStarSearch
+{
+public:
+    template<class MazeT>
+    bool solve(const MazeT& maze,
+               Node start,
+               const BitArray2D<m, n>& goals,
+               NodeStack<m, n>& path,
+               SearchStats* stats = nullptr);
+
+private:
+    static const int cells = m * n;
+    typedef typename PackedType<bitsFor(cells)>::type Distance;
+
+    std::uint32_t generation = 0;
+    std::uint32_t stamp[cells] = {};  // Cell has a distance in this search
+    std::uint32_t closed[cells] = {}; // Cell was expanded in this search
+    Distance dist[cells];
+    unsigned char from[cells];
+    BucketQueue<cells, cells + m + n> open;
+};
+
+
+/* The same interface as bfs(), on a workspace owned by the calling thread */
+template<int m, int n, class MazeT>
+bool astar(const MazeT& maze,
+           Node start,
+           Node goal,
+           NodeStack<m, n>& path,
+           SearchStats* stats = nullptr);
+
+template<int m, int n, class MazeT>
+bool astar(const MazeT& maze,
+           Node start,
+           const BitArray2D<m, n>& goals,
+           NodeStack<m, n>& path,
+           SearchStats* stats = nullptr);
+
+
+template<int m, int n>
+template<class MazeT>
+bool AStarSearch<m, n>::solve(const MazeT& maze,
+                              Node start,
+                              const BitArray2D<m, n>& goals,
+                              NodeStack<m, n>& path,
+                              SearchStats* stats)
+{
+    static_assert(MazeT::rows == m && MazeT::cols == n,
+                  "maze and path sizes differ");
+
+    path.clear();
+
+    // Bounding box of the goals, skipping empty bytes of the goal set
+    int iMin = m;
+    int iMax = -1;
+    int jMin = n;
+    int jMax = -1;
+    for (int b = 0; b < goals.size(); ++b)
+    {
+        for (int bit = 0; goals[b] >> bit; ++bit)
+        {
+            if (!((goals[b] >> bit) & 0x1))
+                continue;
+
+            int i = (b * 8 + bit) % m;
+            int j = (b * 8 + bit) / m;
+            iMin = i < iMin ? i : iMin;
+            iMax = i > iMax ? i : iMax;
+            jMin = j < jMin ? j : jMin;
+            jMax = j > jMax ? j : jMax;
+        }
+    }
+    if (iMax < 0)
+        return false;
+
+    auto estimate = [&](Node v) {
+        int di = v.i < iMin ? iMin - v.i : (v.i > iMax ? v.i - iMax : 0);
+        int dj = v.j < jMin ? jMin - v.j : (v.j > jMax ? v.j - jMax : 0);
+        return di + dj;
+    };
+
+    if (++generation == 0)
+    {
+        for (int c = 0; c < cells; ++c)
+            stamp[c] = closed[c] = 0;
+        generation = 1;
+    }
+
+    int s = start.i + start.j * m;
+    stamp[s] = generation;
+    dist[s] = 0;
+    open.push(s, estimate(start));
+
+    while (!open.empty())
+    {
+        int c = open.pop();
+        Node v = {c % m, c / m};
+        closed[c] = generation;
+
+        if (stats)
+            ++stats->expanded;
+
+        if (goals.get(v.i, v.j))
+        {
+            open.clear();
+
+            path.push(v);
+            while (v != start)
+            {
+                int wall = from[v.i + v.j * m];
+                if (0 == wall)
+                    --v.i;
+                else if (1 == wall)
+                    --v.j;
+                else if (2 == wall)
+                    ++v.i;
+                else
+                    ++v.j;
+                path.push(v);
+            }
+
+            return true;
+        }
+
+        auto cw = maze.getCellWalls(v.i, v.j);
+        int d = dist[c] + 1;
+
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (cw[wall])
+                continue;
+
+            Node u = v;
+            if (0 == wall)
+                ++u.i;
+            else if (1 == wall)
+                ++u.j;
+            else if (2 == wall)
+                --u.i;
+            else
+                --u.j;
+
+            // The estimate is consistent, so expanded cells are final
+            int t = u.i + u.j * m;
+            if (closed[t] == generation || (stamp[t] == generation && dist[t] <= d))
+                continue;
+
+            stamp[t] = generation;
+            dist[t] = d;
+            from[t] = wall;
+            open.push(t, d + estimate(u));
+        }
+    }
+
+    return false;
+}
+
+
+template<int m, int n, class MazeT>
+bool astar(const MazeT& maze,
+           Node start,
+           Node goal,
+           NodeStack<m, n>& path,
+           SearchStats* stats)
+{
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+    return astar(maze, start, goals, path, stats);
+}
+
+
+template<int m, int n, class MazeT>
+bool astar(const MazeT& maze,
+           Node start,
+           const BitArray2D<m, n>& goals,
+           NodeStack<m, n>& path,
+           SearchStats* stats)
+{
+    thread_local std::unique_ptr<AStarSearch<m, n>> work;
+    if (!work)
+        work.reset(new AStarSearch<m, n>);
+    return work->solve(maze, start, goals, path, stats);
+}
+
+#endif // ASTAR_HPP
@@ -0,0 +1,280 @@
+#ifndef ANALYSIS_HPP
+#define ANALYSIS_HPP
+
+#include <cstdint>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+
+
+/* Structure of a maze, for characterizing mazes before simulating them.
+ *
+ * MazeAnalyzer reads the wall planes a line of 64 walls at a time into one
+ * nibble of open sides per cell, and derives everything from those:
+ *   - dead ends and corridors from the number of open sides of each cell
+ *   - the cycle rank from the number of open walls, counted with popcounts
+ *     over the planes, and the number of connected components
+ *   - the reachable cells, the distance to the goal, the number of distinct
+ *     shortest paths to it and the largest distance from one breadth-first
+ *     search from the start that counts paths as it goes
+ * A corridor is a maximal run of neighbouring cells with two open sides
+ * each; a ring of such cells is one corridor too.
+ *
+ * The analyzer keeps its tables in the object, so reusing one analyzer does
+ * not allocate. It is large for big mazes (about 1.1 MB at 256x256); make it
+ * static or put it on the heap.
+ */
+const int corridorBins = 6; // Corridor lengths 1, 2, 3-4, 5-8, 9-16 and 17 or more
+
+// Number of open sides of a cell from its nibble of open sides; cheaper than
+// a popcount without hardware support
+const unsigned char openSides[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+
+struct MazeStats
+{
+    int reachable = 0;       // Cells reachable from the start, the start included
+    int deadEnds = 0;        // Cells with exactly one open side
+    int components = 0;      // Groups of cells connected to each other
+    int loops = 0;           // Cycle rank: open walls - cells + components
+    int shortestLength = -1; // Steps from the start to the nearest goal cell, -1 if none is reachable
+    int longestShortest = 0; // Steps from the start to the farthest reachable cell
+
+    // Distinct paths of shortestLength steps to the goal cells, saturating
+    // at the largest uint64_t
+    std::uint64_t shortestPaths = 0;
+
+    int corridors[corridorBins] = {}; // Corridors by length in cells
+};
+
+
+template<int m, int n>
+class MazeAnalyzer
+{
+public:
+    void analyze(const Maze<m, n>& maze, Node start, const BitArray2D<m, n>& goals,
+                 MazeStats& stats);
+
+private:
+    static const int cells = m * n;
+
+    void readWalls(const Maze<m, n>& maze);
+    void search(int start, MazeStats& stats);
+    int countComponents();
+    void countCorridors(MazeStats& stats);
+
+    // Bit d of open[c] is set if side d of cell c = i + j * m is open, with
+    // d as in Maze::getCellWalls
+    unsigned char open[cells];
+    int dist[cells];
+    std::uint64_t paths[cells];
+    int queue[cells];
+    BitArray2D<m, n> inCorridor;
+};
+
+
+template<int m, int n>
+void MazeAnalyzer<m, n>::analyze(const Maze<m, n>& maze, Node start, const BitArray2D<m, n>& goals,
+                                 MazeStats& stats)
+{
+    stats = MazeStats();
+    readWalls(maze);
+
+    // Open walls are the bits that are not set in either plane
+    int walls = 0;
+    const BitArray2D<m - 1, n>& mWalls = maze.getMWalls();
+    const BitArray2D<m, n - 1>& nWalls = maze.getNWalls();
+    for (int pos = 0; pos < (m - 1) * n; pos += 64)
+        walls += __builtin_popcountll(mWalls.getBits(pos, (m - 1) * n - pos < 64 ? (m - 1) * n - pos : 64));
+    for (int pos = 0; pos < m * (n - 1); pos += 64)
+        walls += __builtin_popcountll(nWalls.getBits(pos, m * (n - 1) - pos < 64 ? m * (n - 1) - pos : 64));
+    int openWalls = (m - 1) * n + m * (n - 1) - walls;
+
+    search(start.i + start.j * m, stats);
+
+    for (int c = 0; c < cells; ++c)
+    {
+        if (!goals.get(c % m, c / m) || dist[c] < 0)
+            continue;
+        if (stats.shortestLength < 0 || dist[c] < stats.shortestLength)
+        {
+            stats.shortestLength = dist[c];
+            stats.shortestPaths = 0;
+        }
+        if (dist[c] == stats.shortestLength)
+        {
+            std::uint64_t sum = stats.shortestPaths + paths[c];
+            stats.shortestPaths = sum < paths[c] ? UINT64_MAX : sum;
+        }
+    }
+
+    stats.components = countComponents();
+    stats.loops = openWalls - cells + stats.components;
+    countCorridors(stats);
+}
+
+
+// Builds the open sides of every cell from the planes, 64 cells of a line
+// at a time
+template<int m, int n>
+void MazeAnalyzer<m, n>::readWalls(const Maze<m, n>& maze)
+{
+    const BitArray2D<m - 1, n>& mWalls = maze.getMWalls();
+    const BitArray2D<m, n - 1>& nWalls = maze.getNWalls();
+
+    for (int j = 0; j < n; ++j)
+    {
+        for (int first = 0; first < m; first += 64)
+        {
+            int count = m - first < 64 ? m - first : 64;
+
+            // Bit k is the wall on the +i side of cell first + k, and on
+            // the -i side after shifting in the wall before cell first
+            std::uint64_t plusI = ~std::uint64_t(0);
+            if (first < m - 1)
+            {
+                int mCount = m - 1 - first < 64 ? m - 1 - first : 64;
+                plusI = mWalls.getBits(j * (m - 1) + first, mCount);
+                if (mCount < 64)
+                    plusI |= ~std::uint64_t(0) << mCount;
+            }
+            bool minusFirst = first == 0 || mWalls.get(first - 1, j);
+            std::uint64_t minusI = plusI << 1 | (minusFirst ? 1 : 0);
+
+            std::uint64_t plusJ = j < n - 1 ? nWalls.getBits(j * m + first, count) : ~std::uint64_t(0);
+            std::uint64_t minusJ = j > 0 ? nWalls.getBits((j - 1) * m + first, count) : ~std::uint64_t(0);
+
+            for (int k = 0; k < count; ++k)
+            {
+                open[first + k + j * m] = (~plusI >> k & 1) | (~plusJ >> k & 1) << 1 |
+                                          (~minusI >> k & 1) << 2 | (~minusJ >> k & 1) << 3;
+            }
+        }
+    }
+}
+
+
+// Breadth-first search from start that adds up the number of shortest paths
+// to every cell
+template<int m, int n>
+void MazeAnalyzer<m, n>::search(int start, MazeStats& stats)
+{
+    const int step[4] = {1, m, -1, -m};
+
+    for (int c = 0; c < cells; ++c)
+        dist[c] = -1;
+
+    int head = 0;
+    int tail = 0;
+    dist[start] = 0;
+    paths[start] = 1;
+    queue[tail++] = start;
+
+    while (head < tail)
+    {
+        int c = queue[head++];
+        for (int d = 0; d < 4; ++d)
+        {
+            if (!(open[c] >> d & 1))
+                continue;
+
+            int next = c + step[d];
+            if (dist[next] < 0)
+            {
+                dist[next] = dist[c] + 1;
+                paths[next] = paths[c];
+                queue[tail++] = next;
+            }
+            else if (dist[next] == dist[c] + 1)
+            {
+                std::uint64_t sum = paths[next] + paths[c];
+                paths[next] = sum < paths[c] ? UINT64_MAX : sum;
+            }
+        }
+    }
+
+    stats.reachable = tail;
+    stats.longestShortest = dist[queue[tail - 1]];
+}
+
+
+// Floods every cell the search from the start did not reach; the start's
+// component is the first
+template<int m, int n>
+int MazeAnalyzer<m, n>::countComponents()
+{
+    const int step[4] = {1, m, -1, -m};
+    int components = 1;
+
+    for (int c = 0; c < cells; ++c)
+    {
+        if (dist[c] >= 0)
+            continue;
+
+        ++components;
+        int head = 0;
+        int tail = 0;
+        dist[c] = 0;
+        queue[tail++] = c;
+        while (head < tail)
+        {
+            int v = queue[head++];
+            for (int d = 0; d < 4; ++d)
+            {
+                if ((open[v] >> d & 1) && dist[v + step[d]] < 0)
+                {
+                    dist[v + step[d]] = 0;
+                    queue[tail++] = v + step[d];
+                }
+            }
+        }
+    }
+
+    return components;
+}
+
+
+template<int m, int n>
+void MazeAnalyzer<m, n>::countCorridors(MazeStats& stats)
+{
+    const int step[4] = {1, m, -1, -m};
+    inCorridor.setAll(false);
+
+    for (int c = 0; c < cells; ++c)
+    {
+        int sides = openSides[open[c]];
+        if (sides == 1)
+            ++stats.deadEnds;
+        if (sides != 2 || inCorridor.get(c % m, c / m))
+            continue;
+
+        // Follow the corridor out of both sides of c
+        inCorridor.set(c % m, c / m, true);
+        int length = 1;
+        for (int d = 0; d < 4; ++d)
+        {
+            if (!(open[c] >> d & 1))
+                continue;
+
+            int from = d;
+            int v = c + step[d];
+            while (openSides[open[v]] == 2 && !inCorridor.get(v % m, v / m))
+            {
+                inCorridor.set(v % m, v / m, true);
+                ++length;
+
+                // Leave by the side that is not the one we came in by
+                int back = (from + 2) % 4;
+                from = __builtin_ctz(open[v] & ~(1 << back));
+                v += step[from];
+            }
+        }
+
+        int bin = 0;
+        while (bin < corridorBins - 1 && (1 << bin) < length)
+            ++bin;
+        ++stats.corridors[bin];
+    }
+}
+
+#endif // ANALYSIS_HPP
@@ -1,10 +1,16 @@
 #ifndef BFS_HPP
 #define BFS_HPP
 
+#include <climits>
+#include <cstdint>
+#include <type_traits>
+#ifndef MAZE_EMBEDDED
+#include <memory>
+#endif
 #include "Maze.hpp"
 #include "BitArray2D.hpp"
-
-#define MAX_NODES (16*16)
+#include "Random.hpp"
+#include "Trace.hpp"
 
 
 struct Node
@@ -30,93 +36,463 @@ struct Edge
 };
 
 
+// Work counters a search adds to when the caller asks for them
+struct SearchStats
+{
+    long expanded = 0; // Cells taken off the queue
+};
+
+
+// Number of bits needed to store any value in [0, count)
+constexpr int bitsFor(int count)
+{
+    return count <= 1 ? 0 : 1 + bitsFor((count + 1) / 2);
+}
+
+
+// Smallest unsigned integer type with at least the given number of bits
+template<int bits>
+struct PackedType
+{
+    static_assert(bits <= 64, "packed value does not fit in 64 bits");
+
+    typedef typename std::conditional<bits <= 8, std::uint8_t,
+            typename std::conditional<bits <= 16, std::uint16_t,
+            typename std::conditional<bits <= 32, std::uint32_t,
+                                      std::uint64_t>::type>::type>::type type;
+};
+
+
+/* Packs nodes and edges of an m x n maze into the smallest integers that can
+ * hold them. The i coordinate takes the low bits and j the bits above it, so
+ * a 16x16 maze packs a node into one byte and an edge into two.
+ */
+template<int m, int n>
+struct NodePacking
+{
+    static_assert(m > 0 && n > 0, "maze dimensions must be positive");
+    static_assert(m <= INT_MAX / n, "maze has more cells than fit in an int");
+
+    static const int iBits = bitsFor(m);
+    static const int jBits = bitsFor(n);
+    static const int nodeBits = iBits + jBits;
+
+    static_assert(nodeBits <= 32, "node coordinates do not fit in 32 bits");
+
+    typedef typename PackedType<nodeBits>::type NodeType;
+    typedef typename PackedType<2 * nodeBits>::type EdgeType;
+
+    static NodeType pack(Node node)
+    {
+        return NodeType(NodeType(node.i) | NodeType(node.j) << iBits);
+    }
+    static Node unpack(NodeType p)
+    {
+        return {int(p & ((1u << iBits) - 1)), int(p >> iBits)};
+    }
+    static EdgeType pack(Edge edge)
+    {
+        return EdgeType(EdgeType(pack(edge.a)) |
+                        EdgeType(pack(edge.b)) << nodeBits);
+    }
+    static Edge unpackEdge(EdgeType e)
+    {
+        return {unpack(NodeType(e & ((EdgeType(1) << nodeBits) - 1))),
+                unpack(NodeType(e >> nodeBits))};
+    }
+};
+
+
+template<int m, int n>
 class EdgeStack
 {
+    typedef NodePacking<m, n> Packing;
+
 public:
     void push(Edge edge)
     {
-        data[head++] = ((edge.a.i & 0xf) << 0 |
-                        (edge.a.j & 0xf) << 4 |
-                        (edge.b.i & 0xf) << 8 |
-                        (edge.b.j & 0xf) << 12);
+        data[head++] = Packing::pack(edge);
     }
     Edge pop()
     {
-        auto e = data[--head];
-        return {{(e >> 0) & 0xf, (e >>  4) & 0xf},
-            {(e >> 8) & 0xf, (e >> 12) & 0xf}};
+        return Packing::unpackEdge(data[--head]);
     }
     bool empty() { return head <= 0; }
     
 private:
-    unsigned short data[MAX_NODES];
+    typename Packing::EdgeType data[m * n];
     int head = 0;
 };
 
     
+template<int m, int n>
 class NodeStack
 {
+    typedef NodePacking<m, n> Packing;
+
 public:
     void push(Node node)
     {
-        data[head++] = ((node.i & 0xf) << 0 | (node.j & 0xf) << 4);
+        data[head++] = Packing::pack(node);
     }
     Node pop()
     {
-        auto n = data[--head];
-        return {(n >> 0) & 0xf, (n >> 4) & 0xf};
+        return Packing::unpack(data[--head]);
     }
     Node peek() const
     {
-        auto n = data[head - 1];
-        return {(n >> 0) & 0xf, (n >> 4) & 0xf};
+        return Packing::unpack(data[head - 1]);
     }
     void clear() { head = 0; }
-    bool empty() { return head <= 0; }
+    bool empty() const { return head <= 0; }
     Node operator[](int i) const
     {
-        auto n = data[head - 1 - i];
-        return {(n >> 0) & 0xf, (n >> 4) & 0xf};
+        return Packing::unpack(data[head - 1 - i]);
+    }
+    int size() const { return head; }
+
+    // For filling a stack of known size from the top: resize, then set
+    // each entry, with 0 the top as for operator[]
+    void resize(int size) { head = size; }
+    void set(int i, Node node)
+    {
+        data[head - 1 - i] = Packing::pack(node);
     }
-    int size() { return head; }
     
 private:
-    unsigned char data[MAX_NODES];
+    typename Packing::NodeType data[m * n];
     int head = 0;
 };
 
 
+template<int m, int n>
 class NodeQueue
 {
+    typedef NodePacking<m, n> Packing;
+
 public:
     void push(Node node)
     {
-        data[tail] = ((node.i & 0xf) << 0 | (node.j & 0xf) << 4);
-        tail = (tail + 1) % MAX_NODES;
+        data[tail] = Packing::pack(node);
+        tail = (tail + 1) % (m * n);
     }
     Node pop()
     {
-        auto n = data[head];
-        head = (head + 1) % MAX_NODES;
-        return {(n >> 0) & 0xf, (n >> 4) & 0xf};
+        auto p = data[head];
+        head = (head + 1) % (m * n);
+        return Packing::unpack(p);
     }
+    void clear() { head = tail = 0; }
     bool empty() { return head == tail; }
+    int size() const { return (tail - head + m * n) % (m * n); }
 
 private:
-    unsigned char data[MAX_NODES];
+    typename Packing::NodeType data[m * n];
     int head = 0;
     int tail = 0;
 };
 
 
-bool bfs(const Maze<16, 16>& maze,
+/* State of a breadth-first search, kept between searches so that callers
+ * can reuse it instead of setting up new containers for every call.
+ *
+ * Cells are stamped with the number of the search that reached them, so
+ * starting a new search does not clear anything; the stamps are only wiped
+ * when the counter wraps around. For every cell reached by the last search
+ * the workspace keeps its distance from the start and the direction of the
+ * step that reached it, so paths are read back in O(length) and the same
+ * search can answer questions about many cells.
+ *
+ * search() stops as soon as a goal is found, so only cells up to that
+ * distance are known; flood() always reaches every cell it can.
+ */
+template<int m, int n>
+class SearchWorkspace
+{
+public:
+    template<class MazeT>
+    bool search(const MazeT& maze,
+                Node start,
+                const BitArray2D<m, n>& goals,
+                SearchStats* stats = nullptr);
+
+    // Returns the number of cells reached
+    template<class MazeT>
+    int flood(const MazeT& maze, Node start, SearchStats* stats = nullptr);
+
+    // Results of the last search or flood
+    Node start() const { return origin; }
+    Node found() const { return goal; }
+    bool reached(Node v) const { return stamp[v.i + v.j * m] == generation; }
+    int distance(Node v) const { return reached(v) ? dist[v.i + v.j * m] : -1; }
+
+    // The cell the search came from to reach v, v itself for the start. v
+    // must have been reached.
+    Node parent(Node v) const;
+
+    // Path from the start to v in the same order as bfs() returns it. Returns
+    // false with an empty path if v was not reached, or is not a cell (as
+    // found() is after a search that failed).
+    bool path(Node v, NodeStack<m, n>& path) const;
+
+private:
+    typedef typename PackedType<bitsFor(m * n)>::type Distance;
+
+    template<class MazeT>
+    bool run(const MazeT& maze, Node start, const BitArray2D<m, n>* goals, SearchStats* stats);
+    void begin(Node start);
+
+    // The embedded profile trades RAM for a clear of the stamps every 255
+    // searches
+#ifdef MAZE_EMBEDDED
+    typedef std::uint8_t Stamp;
+#else
+    typedef std::uint32_t Stamp;
+#endif
+
+    Stamp generation = 0;
+    Stamp stamp[m * n] = {};
+    Distance dist[m * n];
+    unsigned char from[m * n]; // Wall direction of the step into the cell
+    NodeQueue<m, n> queue;
+    Node origin = {0, 0};
+    Node goal = {-1, -1};
+};
+
+
+// Fills order with the wall directions 0-3 in random order
+void permute(int* order, Rng& rng);
+
+
+/* The maze may be a Maze or anything else with the same getCellWalls()
+ * and rows/cols members, such as a MazeView into a corpus file.
+ *
+ * These run on a workspace owned by the calling thread. Callers that want
+ * the distances or several paths from one search should keep their own
+ * SearchWorkspace instead.
+ */
+template<int m, int n, class MazeT>
+bool bfs(const MazeT& maze,
          Node start,
          Node goal,
-         NodeStack& bfsPath);
+         NodeStack<m, n>& bfsPath,
+         SearchStats* stats = nullptr);
 
-bool bfs(const Maze<16, 16>& maze,
+template<int m, int n, class MazeT>
+bool bfs(const MazeT& maze,
          Node start,
-         const BitArray2D<16, 16>& goals,
-         NodeStack& bfsPath);
+         const BitArray2D<m, n>& goals,
+         NodeStack<m, n>& bfsPath,
+         SearchStats* stats = nullptr);
+
+
+template<int m, int n>
+template<class MazeT>
+bool SearchWorkspace<m, n>::search(const MazeT& maze,
+                                   Node start,
+                                   const BitArray2D<m, n>& goals,
+                                   SearchStats* stats)
+{
+    return run(maze, start, &goals, stats);
+}
+
+
+template<int m, int n>
+template<class MazeT>
+int SearchWorkspace<m, n>::flood(const MazeT& maze, Node start, SearchStats* stats)
+{
+    SearchStats work;
+    run(maze, start, nullptr, &work);
+
+    if (stats)
+        stats->expanded += work.expanded;
+
+    // Every reached cell is expanded exactly once
+    return work.expanded;
+}
+
+
+template<int m, int n>
+void SearchWorkspace<m, n>::begin(Node start)
+{
+    if (++generation == 0)
+    {
+        for (int c = 0; c < m * n; ++c)
+            stamp[c] = 0;
+        generation = 1;
+    }
+
+    origin = start;
+    goal = {-1, -1};
+    queue.clear();
+
+    int c = start.i + start.j * m;
+    stamp[c] = generation;
+    dist[c] = 0;
+}
+
+
+template<int m, int n>
+template<class MazeT>
+bool SearchWorkspace<m, n>::run(const MazeT& maze,
+                                Node start,
+                                const BitArray2D<m, n>* goals,
+                                SearchStats* stats)
+{
+    static_assert(MazeT::rows == m && MazeT::cols == n,
+                  "maze and workspace sizes differ");
+
+    TRACE_SCOPE("bfs");
+    TRACE_TALLY("bfs_calls");
+    TRACE_ONLY(long expanded = 0;)
+    TRACE_ONLY(int highWater = 0;)
+
+    begin(start);
+
+    if (goals && goals->get(start.i, start.j))
+    {
+        goal = start;
+        return true;
+    }
+
+    // The start is stamped so it is never queued twice; the queue then
+    // holds at most m * n - 1 cells at once
+    queue.push(start);
+    bool found = false;
+
+    while (!found && !queue.empty())
+    {
+        Node v = queue.pop();
+        auto cw = maze.getCellWalls(v.i, v.j);
+        Distance d = dist[v.i + v.j * m] + 1;
+
+        if (stats)
+            ++stats->expanded;
+        TRACE_ONLY(++expanded;)
+
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (cw[wall])
+                continue;
+
+            Node u = v;
+            if (0 == wall)
+                ++u.i;
+            else if (1 == wall)
+                ++u.j;
+            else if (2 == wall)
+                --u.i;
+            else
+                --u.j;
+
+            int c = u.i + u.j * m;
+            if (stamp[c] == generation)
+                continue;
+
+            stamp[c] = generation;
+            dist[c] = d;
+            from[c] = wall;
+
+            // Checked when a cell is first reached, so the search stops a
+            // whole level earlier than if it waited for the goal to be
+            // expanded
+            if (goals && goals->get(u.i, u.j))
+            {
+                goal = u;
+                found = true;
+                break;
+            }
+
+            queue.push(u);
+        }
+
+        TRACE_ONLY(highWater = queue.size() > highWater ? queue.size() : highWater;)
+    }
+
+    TRACE_COUNTER("bfs_expanded", expanded);
+    TRACE_COUNTER("bfs_queue_high_water", highWater);
+    return found;
+}
+
+
+template<int m, int n>
+Node SearchWorkspace<m, n>::parent(Node v) const
+{
+    if (v == origin)
+        return v;
+
+    int wall = from[v.i + v.j * m];
+    if (0 == wall)
+        --v.i;
+    else if (1 == wall)
+        --v.j;
+    else if (2 == wall)
+        ++v.i;
+    else
+        ++v.j;
+    return v;
+}
+
+
+template<int m, int n>
+bool SearchWorkspace<m, n>::path(Node v, NodeStack<m, n>& path) const
+{
+    path.clear();
+
+    if (v.i < 0 || v.j < 0 || v.i >= m || v.j >= n || !reached(v))
+        return false;
+
+    // Pushed from the far end, so the start ends up on top
+    path.push(v);
+    while (v != origin)
+    {
+        v = parent(v);
+        path.push(v);
+    }
+
+    return true;
+}
+
+
+template<int m, int n, class MazeT>
+bool bfs(const MazeT& maze,
+         Node start,
+         Node goal,
+         NodeStack<m, n>& bfsPath,
+         SearchStats* stats)
+{
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+    return bfs(maze, start, goals, bfsPath, stats);
+}
+
+
+template<int m, int n, class MazeT>
+bool bfs(const MazeT& maze,
+         Node start,
+         const BitArray2D<m, n>& goals,
+         NodeStack<m, n>& bfsPath,
+         SearchStats* stats)
+{
+#ifdef MAZE_EMBEDDED
+    // No heap and a single thread: one static workspace per maze size
+    static SearchWorkspace<m, n> workspace;
+    SearchWorkspace<m, n>* work = &workspace;
+#else
+    // Too large for the stack on big mazes, so each thread allocates one
+    // the first time it searches a maze of this size
+    thread_local std::unique_ptr<SearchWorkspace<m, n>> work;
+    if (!work)
+        work.reset(new SearchWorkspace<m, n>);
+#endif
+
+    if (!work->search(maze, start, goals, stats))
+    {
+        bfsPath.clear();
+        return false;
+    }
+
+    return work->path(work->found(), bfsPath);
+}
 
 #endif // BFS_HPP
@@ -0,0 +1,245 @@
+#ifndef BIDIRECTIONAL_HPP
+#define BIDIRECTIONAL_HPP
+
+#include <cstdint>
+#include <memory>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+
+
+/* Breadth-first search from both ends at once.
+ *
+ * One search grows from the start and the other from all of the goals
+ * together. Each round expands a whole level of whichever side has the
+ * smaller frontier, so in open areas neither side grows much past half of
+ * the path. The first cell reached by both sides lies on a shortest path:
+ * before that level no cell was reached by both, so the path is longer
+ * than the two depths together, and a cell reached from the other side is
+ * at most that side's depth away from it.
+ *
+ * The result has the same length as the path bfs() finds, but may be a
+ * different path of that length.
+ */
+template<int m, int n>
+class BidirectionalSearch
+{
+public:
+    template<class MazeT>
+    bool solve(const MazeT& maze,
+               Node start,
+               const BitArray2D<m, n>& goals,
+               NodeStack<m, n>& path,
+               SearchStats* stats = nullptr);
+
+private:
+    static const int cells = m * n;
+
+    // Expands one level of the given side. Returns the meeting cell, or -1
+    // if the sides did not meet.
+    template<class MazeT>
+    int expand(const MazeT& maze, int side, SearchStats* stats);
+    Node parent(int side, Node v) const;
+
+    std::uint32_t generation = 0;
+    std::uint32_t stamp[2][cells] = {};
+    unsigned char from[2][cells]; // Wall direction of the step into the cell
+    NodeQueue<m, n> queue[2];
+    int level[2] = {0, 0}; // Cells in the frontier of each side
+    NodeStack<m, n> half;
+};
+
+
+/* The same interface as bfs(), on a workspace owned by the calling thread */
+template<int m, int n, class MazeT>
+bool bidirectionalBfs(const MazeT& maze,
+                      Node start,
+                      Node goal,
+                      NodeStack<m, n>& path,
+                      SearchStats* stats = nullptr);
+
+template<int m, int n, class MazeT>
+bool bidirectionalBfs(const MazeT& maze,
+                      Node start,
+                      const BitArray2D<m, n>& goals,
+                      NodeStack<m, n>& path,
+                      SearchStats* stats = nullptr);
+
+
+template<int m, int n>
+template<class MazeT>
+bool BidirectionalSearch<m, n>::solve(const MazeT& maze,
+                                      Node start,
+                                      const BitArray2D<m, n>& goals,
+                                      NodeStack<m, n>& path,
+                                      SearchStats* stats)
+{
+    static_assert(MazeT::rows == m && MazeT::cols == n,
+                  "maze and path sizes differ");
+
+    path.clear();
+
+    if (goals.get(start.i, start.j))
+    {
+        path.push(start);
+        return true;
+    }
+
+    if (++generation == 0)
+    {
+        for (int c = 0; c < cells; ++c)
+            stamp[0][c] = stamp[1][c] = 0;
+        generation = 1;
+    }
+
+    for (int side = 0; side < 2; ++side)
+    {
+        queue[side].clear();
+        level[side] = 0;
+    }
+
+    stamp[0][start.i + start.j * m] = generation;
+    queue[0].push(start);
+    level[0] = 1;
+
+    for (int j = 0; j < n; ++j)
+    {
+        for (int i = 0; i < m; ++i)
+        {
+            if (goals.get(i, j))
+            {
+                stamp[1][i + j * m] = generation;
+                queue[1].push({i, j});
+                ++level[1];
+            }
+        }
+    }
+
+    int meet = -1;
+    while (meet < 0 && level[0] > 0 && level[1] > 0)
+        meet = expand(maze, level[0] <= level[1] ? 0 : 1, stats);
+
+    if (meet < 0)
+        return false;
+
+    // The goal half first, from the goal back to the meeting cell, then the
+    // start half, so the start ends up on top
+    Node x = {meet % m, meet / m};
+    half.clear();
+    for (Node v = x; !goals.get(v.i, v.j); )
+    {
+        v = parent(1, v);
+        half.push(v);
+    }
+    while (!half.empty())
+        path.push(half.pop());
+
+    path.push(x);
+    for (Node v = x; v != start; )
+    {
+        v = parent(0, v);
+        path.push(v);
+    }
+
+    return true;
+}
+
+
+template<int m, int n>
+template<class MazeT>
+int BidirectionalSearch<m, n>::expand(const MazeT& maze, int side, SearchStats* stats)
+{
+    int other = 1 - side;
+    int count = level[side];
+    int meet = -1;
+
+    level[side] = 0;
+
+    for (int k = 0; k < count && meet < 0; ++k)
+    {
+        Node v = queue[side].pop();
+        auto cw = maze.getCellWalls(v.i, v.j);
+
+        if (stats)
+            ++stats->expanded;
+
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (cw[wall])
+                continue;
+
+            Node u = v;
+            if (0 == wall)
+                ++u.i;
+            else if (1 == wall)
+                ++u.j;
+            else if (2 == wall)
+                --u.i;
+            else
+                --u.j;
+
+            int c = u.i + u.j * m;
+            if (stamp[side][c] == generation)
+                continue;
+
+            stamp[side][c] = generation;
+            from[side][c] = wall;
+
+            if (stamp[other][c] == generation)
+            {
+                meet = c;
+                break;
+            }
+
+            queue[side].push(u);
+            ++level[side];
+        }
+    }
+
+    return meet;
+}
+
+
+template<int m, int n>
+Node BidirectionalSearch<m, n>::parent(int side, Node v) const
+{
+    int wall = from[side][v.i + v.j * m];
+    if (0 == wall)
+        --v.i;
+    else if (1 == wall)
+        --v.j;
+    else if (2 == wall)
+        ++v.i;
+    else
+        ++v.j;
+    return v;
+}
+
+
+template<int m, int n, class MazeT>
+bool bidirectionalBfs(const MazeT& maze,
+                      Node start,
+                      Node goal,
+                      NodeStack<m, n>& path,
+                      SearchStats* stats)
+{
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+    return bidirectionalBfs(maze, start, goals, path, stats);
+}
+
+
+template<int m, int n, class MazeT>
+bool bidirectionalBfs(const MazeT& maze,
+                      Node start,
+                      const BitArray2D<m, n>& goals,
+                      NodeStack<m, n>& path,
+                      SearchStats* stats)
+{
+    thread_local std::unique_ptr<BidirectionalSearch<m, n>> work;
+    if (!work)
+        work.reset(new BidirectionalSearch<m, n>);
+    return work->solve(maze, start, goals, path, stats);
+}
+
+#endif // BIDIRECTIONAL_HPP
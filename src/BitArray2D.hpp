@@ -1,6 +1,8 @@
 #ifndef BITARRAY2D_HPP
 #define BITARRAY2D_HPP
 
+#include <cstdint>
+
 
 template<int m, int n>
 class BitArray2D
@@ -38,6 +40,24 @@ public:
         return (m * n + 7) / 8;
     }
 
+    // Returns count (at most 64) bits starting at bit index pos, where the
+    // bit index of (i, j) is i + j * m, with the first bit in the lowest
+    // position. Cells with the same j are consecutive.
+    std::uint64_t getBits(int pos, int count) const
+    {
+        int byte = pos / 8;
+        int got = 8 - pos % 8;
+        std::uint64_t bits = data[byte++] >> (pos % 8);
+
+        while (got < count)
+        {
+            bits |= std::uint64_t(data[byte++]) << got;
+            got += 8;
+        }
+
+        return count < 64 ? bits & ((std::uint64_t(1) << count) - 1) : bits;
+    }
+
 private:
     unsigned char data[(m * n + 7) / 8] = {};
     
@@ -0,0 +1,95 @@
+#ifndef BUCKETQUEUE_HPP
+#define BUCKETQUEUE_HPP
+
+#include "BFS.hpp"
+
+
+/* Monotone priority queue over the items 0..size-1 with integer keys in
+ * [0, keyCount), by default [0, size). Each key has an intrusive doubly
+ * linked list of items, so push (including moving an item that is already
+ * queued to a new key) and pop are O(1) apart from skipping empty buckets,
+ * and nothing is allocated. Items with equal keys come out last in, first
+ * out.
+ *
+ * Keys pushed must not be smaller than the last key popped unless the queue
+ * is empty. The queue is only valid to reuse once it has been drained, which
+ * avoids an O(size) clear between uses.
+ */
+template<int size, int keyCount = size>
+class BucketQueue
+{
+public:
+    typedef typename PackedType<bitsFor((size > keyCount ? size : keyCount) + 1)>::type Index;
+    static const int none = size > keyCount ? size : keyCount;
+
+    BucketQueue()
+    {
+        for (int k = 0; k < keyCount; ++k)
+            head[k] = none;
+        for (int k = 0; k < size; ++k)
+            keys[k] = none;
+    }
+
+    bool empty() const { return count == 0; }
+    bool contains(int item) const { return keys[item] != none; }
+
+    void push(int item, int key)
+    {
+        if (contains(item))
+            remove(item);
+
+        keys[item] = key;
+        prev[item] = none;
+        next[item] = head[key];
+        if (head[key] != none)
+            prev[head[key]] = item;
+        head[key] = item;
+
+        if (0 == count || key < min)
+            min = key;
+        ++count;
+    }
+
+    // Empties the queue in time proportional to the items left in it
+    void clear()
+    {
+        while (!empty())
+            pop();
+    }
+
+    int pop()
+    {
+        while (head[min] == none)
+            ++min;
+
+        int item = head[min];
+        remove(item);
+        return item;
+    }
+
+private:
+    void remove(int item)
+    {
+        int key = keys[item];
+
+        if (prev[item] != none)
+            next[prev[item]] = next[item];
+        else
+            head[key] = next[item];
+
+        if (next[item] != none)
+            prev[next[item]] = prev[item];
+
+        keys[item] = none;
+        --count;
+    }
+
+    Index head[keyCount];
+    Index next[size];
+    Index prev[size];
+    Index keys[size];
+    int min = 0;
+    int count = 0;
+};
+
+#endif // BUCKETQUEUE_HPP
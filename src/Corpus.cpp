@@ -0,0 +1,161 @@
+#include "Corpus.hpp"
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+std::uint32_t corpusRecordSize(int rows, int cols)
+{
+    return ((rows - 1) * cols + 7) / 8 + (rows * (cols - 1) + 7) / 8;
+}
+
+
+static bool writeHeader(const CorpusHeader& header, std::FILE* file)
+{
+    unsigned char bytes[sizeof(CorpusHeader)];
+    encodeCorpusHeader(header, bytes);
+    return std::fwrite(bytes, sizeof(bytes), 1, file) == 1;
+}
+
+
+Corpus::~Corpus()
+{
+    close();
+}
+
+
+bool Corpus::open(const std::string& path)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        message = "cannot open " + path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        message = "cannot stat " + path;
+        return false;
+    }
+    length = st.st_size;
+
+    if (length >= sizeof(CorpusHeader))
+    {
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            base = static_cast<const unsigned char*>(p);
+            madvise(p, length, MADV_SEQUENTIAL);
+        }
+    }
+    ::close(fd);
+#else
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f)
+    {
+        message = "cannot open " + path;
+        return false;
+    }
+
+    std::fseek(f, 0, SEEK_END);
+    length = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    buffer.resize(length);
+    if (length > 0 && std::fread(buffer.data(), 1, length, f) == length)
+        base = buffer.data();
+    std::fclose(f);
+#endif
+
+    if (!base)
+    {
+        length = 0;
+        message = "cannot read " + path;
+        return false;
+    }
+
+    decodeCorpusHeader(base, header);
+
+    if (std::memcmp(header.magic, corpusMagic, sizeof(corpusMagic)) != 0 ||
+        header.rows < 2 || header.cols < 2 ||
+        header.recordSize != corpusRecordSize(header.rows, header.cols) ||
+        (length - sizeof(CorpusHeader)) / header.recordSize < header.count)
+    {
+        close();
+        message = path + " is not a valid maze corpus";
+        return false;
+    }
+
+    return true;
+}
+
+
+void Corpus::close()
+{
+#ifndef _WIN32
+    if (base)
+        munmap(const_cast<unsigned char*>(base), length);
+#endif
+    buffer.clear();
+    base = nullptr;
+    length = 0;
+    header = CorpusHeader();
+}
+
+
+CorpusWriter::~CorpusWriter()
+{
+    close();
+}
+
+
+bool CorpusWriter::open(const std::string& path, int rows, int cols)
+{
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+
+    std::memcpy(header.magic, corpusMagic, sizeof(corpusMagic));
+    header.rows = rows;
+    header.cols = cols;
+    header.recordSize = corpusRecordSize(rows, cols);
+    header.count = 0;
+
+    return writeHeader(header, file);
+}
+
+
+bool CorpusWriter::append(const unsigned char* record)
+{
+    if (!file || std::fwrite(record, header.recordSize, 1, file) != 1)
+        return false;
+
+    ++header.count;
+    return true;
+}
+
+
+bool CorpusWriter::close()
+{
+    if (!file)
+        return true;
+
+    // Now that the count is known, rewrite the header
+    bool ok = std::fseek(file, 0, SEEK_SET) == 0 &&
+              writeHeader(header, file);
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
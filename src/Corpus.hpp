@@ -0,0 +1,197 @@
+#ifndef CORPUS_HPP
+#define CORPUS_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#ifndef MAZE_EMBEDDED
+#include <string>
+#include <vector>
+#endif
+#include "Maze.hpp"
+
+
+/* Binary maze corpus files.
+ *
+ * A corpus holds any number of mazes of one size as fixed size records, so a
+ * maze is found by its index without parsing anything:
+ *     header   "MZC1", rows, cols, record size (uint32 each), count (uint64)
+ *     records  count x the bytes of Maze::saveBytes()
+ * All integers are little endian, converted explicitly, so corpora move
+ * between machines. The record bytes are the same bytes the hex digits of
+ * Maze::save() spell out.
+ *
+ * Corpus maps the file into memory and hands out MazeView objects that read
+ * the walls straight from the mapping. Views can be passed to bfs() and the
+ * Explorer like a Maze, or copied into a Maze with copyTo().
+ *
+ * The embedded profile (see Embedded.hpp) has the header codec and MazeView
+ * but not Corpus and CorpusWriter, which use std::string.
+ */
+
+
+struct CorpusHeader
+{
+    char magic[4];
+    std::uint32_t rows;
+    std::uint32_t cols;
+    std::uint32_t recordSize;
+    std::uint64_t count;
+};
+
+// The records start right after the header on disk
+static_assert(sizeof(CorpusHeader) == 24, "the corpus header must be 24 bytes");
+
+const char corpusMagic[4] = {'M', 'Z', 'C', '1'};
+
+
+// The header as it is stored, little endian whatever the host's byte order
+inline void encodeCorpusHeader(const CorpusHeader& header, unsigned char* bytes)
+{
+    std::memcpy(bytes, header.magic, 4);
+    std::uint64_t fields[4] = {header.rows, header.cols, header.recordSize, header.count};
+    int widths[4] = {4, 4, 4, 8};
+    for (int f = 0, pos = 4; f < 4; pos += widths[f++])
+        for (int b = 0; b < widths[f]; ++b)
+            bytes[pos + b] = (unsigned char)(fields[f] >> (8 * b));
+}
+
+
+inline void decodeCorpusHeader(const unsigned char* bytes, CorpusHeader& header)
+{
+    std::memcpy(header.magic, bytes, 4);
+    std::uint64_t fields[4] = {0, 0, 0, 0};
+    int widths[4] = {4, 4, 4, 8};
+    for (int f = 0, pos = 4; f < 4; pos += widths[f++])
+        for (int b = 0; b < widths[f]; ++b)
+            fields[f] |= std::uint64_t(bytes[pos + b]) << (8 * b);
+    header.rows = std::uint32_t(fields[0]);
+    header.cols = std::uint32_t(fields[1]);
+    header.recordSize = std::uint32_t(fields[2]);
+    header.count = fields[3];
+}
+
+
+template<int m, int n>
+class MazeView
+{
+public:
+    static const int rows = m;
+    static const int cols = n;
+
+    explicit MazeView(const unsigned char* record) : data(record) {}
+
+    // Same meaning as Maze::getCellWalls
+    std::array<bool, 4> getCellWalls(int i, int j) const
+    {
+        if (i < 0 || j < 0 || i >= m || j >= n)
+            return {false, false, false, false};
+
+        std::array<bool, 4> cw = {
+            (m - 1 == i) || mWall(i, j),
+            (n - 1 == j) || nWall(i, j),
+            (0 == i) || mWall(i - 1, j),
+            (0 == j) || nWall(i, j - 1) };
+
+        return cw;
+    }
+
+    void copyTo(Maze<m, n>& maze) const { maze.loadBytes(data); }
+    void saveBytes(unsigned char* bytes) const { std::memcpy(bytes, data, Maze<m, n>::byteCount); }
+
+private:
+    static const int mBytes = ((m - 1) * n + 7) / 8;
+
+    bool mWall(int i, int j) const
+    {
+        int b = i + j * (m - 1);
+        return (data[b / 8] >> (b % 8)) & 0x1;
+    }
+    bool nWall(int i, int j) const
+    {
+        int b = i + j * m;
+        return (data[mBytes + b / 8] >> (b % 8)) & 0x1;
+    }
+
+    const unsigned char* data;
+};
+
+
+#ifndef MAZE_EMBEDDED
+class Corpus
+{
+public:
+    Corpus() {}
+    ~Corpus();
+
+    Corpus(const Corpus&) = delete;
+    Corpus& operator=(const Corpus&) = delete;
+
+    // Returns false and sets error() if the file cannot be mapped or is not
+    // a valid corpus
+    bool open(const std::string& path);
+    void close();
+
+    int rows() const { return header.rows; }
+    int cols() const { return header.cols; }
+    std::size_t size() const { return header.count; }
+    const std::string& error() const { return message; }
+
+    const unsigned char* record(std::size_t k) const
+    {
+        return base + sizeof(CorpusHeader) + k * header.recordSize;
+    }
+
+    // The corpus must hold m x n mazes; check rows() and cols() first
+    template<int m, int n>
+    MazeView<m, n> view(std::size_t k) const { return MazeView<m, n>(record(k)); }
+
+private:
+    CorpusHeader header = {};
+    const unsigned char* base = nullptr;
+    std::size_t length = 0;
+    std::vector<unsigned char> buffer; // Used where mmap is not available
+    std::string message;
+};
+
+
+// Writes a corpus file. The count in the header is filled in by close().
+class CorpusWriter
+{
+public:
+    CorpusWriter() {}
+    ~CorpusWriter();
+
+    CorpusWriter(const CorpusWriter&) = delete;
+    CorpusWriter& operator=(const CorpusWriter&) = delete;
+
+    bool open(const std::string& path, int rows, int cols);
+    bool append(const unsigned char* record);
+    bool close();
+
+    // Returns false, writing nothing, if the maze is not of the size the
+    // corpus was opened with
+    template<int m, int n>
+    bool append(const Maze<m, n>& maze)
+    {
+        if (m != int(header.rows) || n != int(header.cols))
+            return false;
+
+        unsigned char record[Maze<m, n>::byteCount];
+        maze.saveBytes(record);
+        return append(record);
+    }
+
+private:
+    std::FILE* file = nullptr;
+    CorpusHeader header = {};
+};
+
+
+// Size of one record for an m x n maze
+std::uint32_t corpusRecordSize(int rows, int cols);
+#endif
+
+#endif // CORPUS_HPP
@@ -0,0 +1,55 @@
+#ifndef EMBEDDED_HPP
+#define EMBEDDED_HPP
+
+#include <cstddef>
+#include "Explorer.hpp"
+
+
+/* Embedded profile of the solver, for the mouse's microcontroller.
+ *
+ * With MAZE_EMBEDDED defined, the headers the mouse needs (Maze, BitArray2D,
+ * BFS, FloodFill, WallMap, Policy, Explorer) allocate nothing on the heap,
+ * throw nothing and use no iostreams or std::string, so they build with
+ * -fno-exceptions -fno-rtti and no allocator:
+ *   - Maze has no load() and save(); walls come from the sensors, or from
+ *     loadBytes() when testing
+ *   - the tracing macros are empty
+ *   - bfs() and turnSearch() use one static workspace per maze size
+ *   - search stamps are bytes, cleared every 255 searches
+ *   - Explorer keeps no TurnSearch, which is larger than all the rest of
+ *     it, and ends a mapping run with the shortest path through known-open
+ *     walls instead of the cheapest one
+ * None of the .cpp files of the core (corpus files, generators, thread
+ * pool, tracing) are part of the profile. Corpus.hpp still gives it the
+ * corpus header codec and MazeView, for reading test mazes.
+ *
+ * The whole state of the mouse is one Explorer, which fits in a static
+ * object. Its size in bytes with the default policy:
+ *
+ *                                       16x16    32x32
+ *     WallMap (two mazes)                 160      528
+ *     unvisited, inferred, goal cells      96      384
+ *     FloodFill                          2904    12568
+ *     CandidateFirst policy              1084     6300
+ *     proof SearchWorkspace              1052     6172
+ *     three NodeStacks                    780     6156
+ *     the rest                             76       76
+ *     Explorer                           6152    32184
+ *
+ * These are for a 64-bit build; the budgets below are checked at compile
+ * time, so a change that outgrows them fails the build. A step keeps
+ * little on the stack: a few scalars per call, a few calls deep, and at
+ * most one BitArray2D of goal cells (128 bytes at 32x32).
+ *
+ * make maze-embedded builds a harness that runs the profile over a corpus
+ * and reports the CPU cost per step.
+ */
+const std::size_t embeddedBudget16 = 6 * 1024 + 512;
+const std::size_t embeddedBudget32 = 32 * 1024;
+
+#ifdef MAZE_EMBEDDED
+static_assert(sizeof(Explorer<16, 16>) <= embeddedBudget16, "16x16 explorer outgrew its RAM budget");
+static_assert(sizeof(Explorer<32, 32>) <= embeddedBudget32, "32x32 explorer outgrew its RAM budget");
+#endif
+
+#endif // EMBEDDED_HPP
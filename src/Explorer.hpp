@@ -0,0 +1,319 @@
+#ifndef EXPLORER_HPP
+#define EXPLORER_HPP
+
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "FloodFill.hpp"
+#include "TurnSearch.hpp"
+#include "Policy.hpp"
+#include "WallMap.hpp"
+
+
+/* Exploration of an unknown maze by a simulated mouse.
+ *
+ * The explorer only learns the walls of the cells it stands in. It keeps a
+ * WallMap of the walls known to be there, known to be open and unknown, the
+ * cells it has not visited yet and the cells whose walls it could infer
+ * because all of their neighbours were visited. The discovered maze is the
+ * optimistic view of the map, with unknown walls open.
+ *
+ * Two runs are supported:
+ *   - search: go from start to goal, replanning as walls are found
+ *   - mapping: explore until the policy's termination rule holds, by
+ *     default until the route is proven: the shortest path from start to
+ *     goal through known-open walls is as short as the shortest path with
+ *     unknown walls open, so nothing left to explore can beat it
+ *
+ * Where the mouse goes while mapping is up to the Policy (see Policy.hpp),
+ * by default the nearest unvisited cell on the best route. Storage is the
+ * wall layout of the WallMap; with CellWalls it is one maze with known
+ * walls instead of two.
+ *
+ * Both keep a FloodFill distance field to the goal that is repaired after
+ * every sensed cell instead of running BFS from scratch. Mapping also runs
+ * one BFS per step over the known-open walls for the proof. When mapping is
+ * over, the final path is the cheapest run through known-open walls
+ * according to the turn costs, found with one TurnSearch. The embedded
+ * profile (see Embedded.hpp) has no room for the TurnSearch state and takes
+ * the shortest path through known-open walls instead.
+ */
+template<int m, int n, class Policy = CandidateFirst<m, n>, class Storage = PlaneWalls<m, n>>
+class Explorer
+{
+public:
+    // The true maze passed to these may be a Maze or a MazeView, and must be
+    // the same for the whole run
+    template<class MazeT>
+    void beginSearch(const MazeT& maze, Node start, Node goal);
+    template<class MazeT>
+    void beginMapping(const MazeT& maze, Node start, Node goal);
+
+    // Moves one cell along the current path, senses the walls there and
+    // plans the next path. Returns false once the run is over.
+    template<class MazeT>
+    bool step(const MazeT& maze);
+
+    void setCosts(const TurnCosts& costs) { runCosts = costs; }
+
+    bool running() const { return active; }
+    Node position() const { return current; }
+    Node target() const { return currentIdeal; }
+
+    const Maze<m, n, Storage>& discovered() const { return wallMap.optimistic(); }
+    const WallMap<m, n, Storage>& walls() const { return wallMap; }
+    const BitArray2D<m, n>& unvisited() const { return unvisitedNodes; }
+    const BitArray2D<m, n>& inferred() const { return inferredNodes; }
+    const NodeStack<m, n>& path() const { return bfsPath; }
+    const NodeStack<m, n>& finalPath() const { return bfsFinal; }
+
+    Policy& policy() { return explorePolicy; }
+
+    // Shortest distance from start to goal with unknown walls open and
+    // through known-open walls only (m * n if there is no such path yet),
+    // as of the last mapping step. The route is proven once they are equal.
+    int bestCase() const { return flood.distance(start.i, start.j); }
+    int worstCase() const { return knownDistance; }
+    bool proven() const { return bestCase() == worstCase(); }
+
+    // Cells expanded by the planners since the explorer was created
+    long expanded() const
+    {
+#ifdef MAZE_EMBEDDED
+        return searchWork.expanded + flood.stats().expanded;
+#else
+        return searchWork.expanded + flood.stats().expanded + fastest.expanded();
+#endif
+    }
+
+private:
+    template<class MazeT>
+    void sense(const MazeT& maze);
+    void visit(Node v);
+    void prove();
+    MappingState<m, n, Storage> mappingState();
+
+    bool mapping = false;
+    bool active = false;
+    Node start;
+    Node goal;
+    Node current;
+    Node currentIdeal;
+
+    WallMap<m, n, Storage> wallMap;
+    BitArray2D<m, n> unvisitedNodes;
+    BitArray2D<m, n> inferredNodes;
+    FloodFill<m, n> flood;
+    Policy explorePolicy;
+    SearchWorkspace<m, n> proof;
+    BitArray2D<m, n> goalCells;
+    int knownDistance = m * n;
+    bool opened = false; // Walls were found open since the last proof
+#ifndef MAZE_EMBEDDED
+    TurnSearch<m, n> fastest;
+#endif
+    TurnCosts runCosts;
+    SearchStats searchWork;
+
+    NodeStack<m, n> bfsPath;
+    NodeStack<m, n> bfsFinal;
+    NodeStack<m, n> changed; // Cells visit() still has to look around
+};
+
+
+template<int m, int n, class Policy, class Storage>
+template<class MazeT>
+void Explorer<m, n, Policy, Storage>::beginSearch(const MazeT& maze, Node start, Node goal)
+{
+    mapping = false;
+    active = true;
+    this->start = start;
+    this->goal = goal;
+    current = start;
+    currentIdeal = goal;
+
+    wallMap.clear();
+    wallMap.sense(start.i, start.j, maze.getCellWalls(start.i, start.j));
+    flood.reset(wallMap.optimistic(), goal);
+    flood.path(wallMap.optimistic(), current, bfsPath);
+    bfsFinal.clear();
+
+    // A search that starts on its goal is over before the first step
+    if (start == goal)
+        active = false;
+}
+
+
+template<int m, int n, class Policy, class Storage>
+template<class MazeT>
+void Explorer<m, n, Policy, Storage>::beginMapping(const MazeT& maze, Node start, Node goal)
+{
+    mapping = true;
+    active = true;
+    this->start = start;
+    this->goal = goal;
+    current = start;
+    currentIdeal = start;
+
+    wallMap.clear();
+    wallMap.sense(start.i, start.j, maze.getCellWalls(start.i, start.j));
+    unvisitedNodes.setAll(true);
+    unvisitedNodes.set(start.i, start.j, false);
+    inferredNodes.setAll(false);
+    flood.reset(wallMap.optimistic(), goal);
+    goalCells.setAll(false);
+    goalCells.set(goal.i, goal.j, true);
+    knownDistance = m * n;
+    opened = true;
+
+    bfsFinal.clear();
+    if (start == goal)
+    {
+        // The route is a single cell and proven before the first step
+        active = false;
+        knownDistance = 0;
+        bfsPath.clear();
+        bfsFinal.push(start);
+        return;
+    }
+
+    explorePolicy.begin(mappingState(), bfsPath, currentIdeal);
+}
+
+
+template<int m, int n, class Policy, class Storage>
+template<class MazeT>
+bool Explorer<m, n, Policy, Storage>::step(const MazeT& maze)
+{
+    if (!active)
+        return false;
+
+    TRACE_SCOPE("explorer_step");
+
+    if (bfsPath.size() > 1)
+    {
+        bfsPath.pop(); // First node is the current node; remove it
+        current = bfsPath.pop(); // Set position to next node
+    }
+
+    sense(maze);
+
+    if (mapping)
+    {
+        visit(current);
+        flood.path(wallMap.optimistic(), start, bfsFinal);
+        prove();
+
+        MappingState<m, n, Storage> state = mappingState();
+        explorePolicy.sensed(state);
+        if (explorePolicy.done(state) || !explorePolicy.next(state, bfsPath, currentIdeal))
+            bfsPath.clear();
+    }
+    else
+    {
+        flood.path(wallMap.optimistic(), current, bfsPath);
+    }
+
+    // Stop when the goal is reached or there is nothing left to do
+    if ((!mapping && current == goal) || bfsPath.size() == 0)
+        active = false;
+
+    if (mapping && !active)
+    {
+        // The best route is known; find the fastest run through walls known
+        // to be open
+#ifdef MAZE_EMBEDDED
+        proof.search(wallMap.pessimistic(), start, goalCells, &searchWork);
+        proof.path(goal, bfsFinal);
+#else
+        fastest.solve(wallMap.pessimistic(), start, goalCells, bfsFinal, runCosts);
+#endif
+    }
+
+    TRACE_FLUSH("bfs_calls_per_step", "bfs_calls");
+    return active;
+}
+
+
+// Reads the true walls around the current cell into the discovered maze
+template<int m, int n, class Policy, class Storage>
+template<class MazeT>
+void Explorer<m, n, Policy, Storage>::sense(const MazeT& maze)
+{
+    static_assert(MazeT::rows == m && MazeT::cols == n, "maze sizes differ");
+
+    auto before = wallMap.optimistic().getCellWalls(current.i, current.j);
+    auto closed = wallMap.pessimistic().getCellWalls(current.i, current.j);
+    auto cw = maze.getCellWalls(current.i, current.j);
+
+    for (int wall = 0; wall < 4; ++wall)
+        opened = opened || (closed[wall] && !cw[wall]);
+
+    wallMap.sense(current.i, current.j, cw);
+    flood.update(wallMap.optimistic(), current, before);
+}
+
+
+// Marks a cell visited. A cell whose neighbours have all been visited or
+// inferred is inferred too, which may in turn complete its own neighbours,
+// so only the area around the visited cell is examined.
+template<int m, int n, class Policy, class Storage>
+void Explorer<m, n, Policy, Storage>::visit(Node v)
+{
+    if (!unvisitedNodes.get(v.i, v.j))
+        return;
+
+    TRACE_SCOPE("infer");
+    changed.clear();
+    unvisitedNodes.set(v.i, v.j, false);
+    changed.push(v);
+
+    while (!changed.empty())
+    {
+        Node c = changed.pop();
+        Node around[4] = {{c.i + 1, c.j}, {c.i, c.j + 1}, {c.i - 1, c.j}, {c.i, c.j - 1}};
+
+        for (auto u : around)
+        {
+            int i = u.i;
+            int j = u.j;
+
+            if (i < 0 || j < 0 || i >= m || j >= n || !unvisitedNodes.get(i, j))
+                continue;
+
+            if ((i + 1 >= m || !unvisitedNodes.get(i + 1, j)) &&
+                (j + 1 >= n || !unvisitedNodes.get(i, j + 1)) &&
+                (i - 1 < 0 || !unvisitedNodes.get(i - 1, j)) &&
+                (j - 1 < 0 || !unvisitedNodes.get(i, j - 1)))
+            {
+                unvisitedNodes.set(i, j, false);
+                inferredNodes.set(i, j, true);
+                changed.push(u);
+            }
+        }
+    }
+}
+
+// Finds the shortest distance from start to goal through known-open walls
+template<int m, int n, class Policy, class Storage>
+void Explorer<m, n, Policy, Storage>::prove()
+{
+    // Known-open walls are never lost, so the distance can only shrink, and
+    // only when walls were found open since the last proof
+    if (!opened || knownDistance == bestCase())
+        return;
+
+    opened = false;
+    if (proof.search(wallMap.pessimistic(), start, goalCells, &searchWork))
+        knownDistance = proof.distance(goal);
+}
+
+
+template<int m, int n, class Policy, class Storage>
+MappingState<m, n, Storage> Explorer<m, n, Policy, Storage>::mappingState()
+{
+    return MappingState<m, n, Storage>{wallMap.optimistic(), unvisitedNodes, flood, bfsFinal,
+                              bestCase(), knownDistance, start, goal, current, searchWork};
+}
+
+#endif // EXPLORER_HPP
@@ -0,0 +1,134 @@
+#ifndef FARM_HPP
+#define FARM_HPP
+
+#include <memory>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "Simulator.hpp"
+#include "TurnSearch.hpp"
+#include "PathScore.hpp"
+#include "Recording.hpp"
+#include "SpeedRun.hpp"
+
+
+/* Headless evaluation of the exploration on one maze, for running the
+ * simulation over whole corpora.
+ *
+ * Each maze gets two unthrottled runs of the Simulator from start to goal: a
+ * search run, which heads straight for the goal, and a mapping run, which
+ * explores until the best route is known. All state lives in the
+ * FarmWorkspace passed in, so workers on different threads only need their
+ * own workspace. The workspace type selects the exploration policy of the
+ * mapping run.
+ *
+ * The runs are deterministic, so a maze whose result looks wrong can be run
+ * again with recordings to replay it (see Recording.hpp).
+ */
+struct FarmResult
+{
+    int visited = 0;       // Cells entered during the mapping run
+    int inferred = 0;      // Cells whose walls were inferred without a visit
+    int searchSteps = -1;  // Steps of the search run to the goal, -1 if not reached
+    int goalSteps = -1;    // Steps of the mapping run until it first entered the goal
+    int mappingSteps = 0;  // Steps until the map was good enough to stop
+    float score = 0.f;     // ScorePath() of the final path after mapping
+    float bestScore = 0.f; // ScorePath() of the best path in the true maze
+
+    // Seconds of the fastest speed run through known-open walls after
+    // mapping and through the true maze, -1 if there is none, when the
+    // workspace plans speed runs
+    float runTime = 0.f;
+    float bestRunTime = 0.f;
+};
+
+
+// Version of the results of simulateMaze(), stored with them in result
+// caches. Bump it with any change to the explorer, the policies, the
+// Simulator, the scores or the speed run planner that can change a result,
+// so that cached results of the old code are not used.
+const int farmResultVersion = 2;
+
+
+template<int m, int n, class Policy = CandidateFirst<m, n>>
+struct FarmWorkspace
+{
+    Simulator<m, n, Maze<m, n>, Policy> sim;
+    TurnSearch<m, n> best;
+    NodeStack<m, n> path;
+
+    // Set to also plan speed runs (see SpeedRun.hpp)
+    std::unique_ptr<SpeedRunPlanner<m, n>> planner;
+    RobotParams robot;
+};
+
+
+// True if the mouse did not reach the goal, mapping was cut off, or the
+// final path is worse than the best one
+inline bool resultFailed(const FarmResult& r, int stepLimit)
+{
+    return r.searchSteps < 0 || r.mappingSteps >= stepLimit || r.score > r.bestScore;
+}
+
+
+// Runs are cut off after Simulator::stepLimit() steps. The runs are recorded
+// into searchRun and mappingRun unless they are null.
+template<int m, int n, class Policy>
+FarmResult simulateMaze(const Maze<m, n>& maze, Node start, Node goal,
+                        FarmWorkspace<m, n, Policy>& work,
+                        RunRecording<m, n>* searchRun = nullptr,
+                        RunRecording<m, n>* mappingRun = nullptr)
+{
+    FarmResult result;
+    Simulator<m, n, Maze<m, n>, Policy>& sim = work.sim;
+    const Explorer<m, n, Policy>& explorer = sim.state();
+
+    sim.setRecording(searchRun);
+    sim.startSearch(maze, start, goal);
+    sim.finish();
+    if (sim.position() == goal)
+        result.searchSteps = sim.stepsTaken();
+
+    sim.setRecording(mappingRun);
+    sim.startMapping(maze, start, goal);
+    while (sim.running())
+    {
+        sim.step();
+        if (result.goalSteps < 0 && sim.position() == goal)
+            result.goalSteps = sim.stepsTaken();
+    }
+    result.mappingSteps = sim.stepsTaken();
+    sim.setRecording(nullptr);
+
+    for (int i = 0; i < m; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            if (explorer.inferred().get(i, j))
+                ++result.inferred;
+            else if (!explorer.unvisited().get(i, j))
+                ++result.visited;
+        }
+    }
+
+    work.path = explorer.finalPath();
+    result.score = ScorePath(work.path);
+
+    // The reference: the best run with the whole maze known
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+    work.best.solve(maze, start, goals, work.path);
+    result.bestScore = ScorePath(work.path);
+
+    if (work.planner)
+    {
+        bool found = work.planner->solve(explorer.walls().pessimistic(), start, goals, work.robot);
+        result.runTime = found ? work.planner->time() : -1.f;
+        found = work.planner->solve(maze, start, goals, work.robot);
+        result.bestRunTime = found ? work.planner->time() : -1.f;
+    }
+
+    return result;
+}
+
+#endif // FARM_HPP
@@ -0,0 +1,293 @@
+#ifndef FLOODFILL_HPP
+#define FLOODFILL_HPP
+
+#include <array>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "BucketQueue.hpp"
+#include "Trace.hpp"
+
+
+/* Distance field from every cell to a set of goal cells that is kept up to
+ * date incrementally as walls change (a modified flood fill).
+ *
+ * reset() floods the whole maze once. After that, whenever the walls around
+ * one cell are changed with setCellWalls, update() is given the walls the
+ * cell had before and repairs the field in two passes:
+ *   1. Starting from both sides of every wall that closed, collect the cells
+ *      that are no longer supported by an open neighbour one step closer to
+ *      a goal. Cells are examined in order of increasing distance, so each
+ *      cell's possible supports are settled before it is checked.
+ *   2. Re-seed the collected cells from their unaffected neighbours and relax
+ *      them, together with both sides of every wall that opened, in order of
+ *      distance.
+ * Only cells whose distance changes (and their neighbours) are touched.
+ *
+ * The same maze must be passed to every call; the field does not keep a copy
+ * of the walls. It may be a Maze of either wall layout, a MazeView or a
+ * view of a WallMap.
+ */
+template<int m, int n>
+class FloodFill
+{
+public:
+    typedef typename PackedType<bitsFor(m * n + 1)>::type Distance;
+    static const int unreachable = m * n;
+
+    template<class MazeT>
+    void reset(const MazeT& maze, Node goal);
+    template<class MazeT>
+    void reset(const MazeT& maze, const BitArray2D<m, n>& goals);
+    template<class MazeT>
+    void update(const MazeT& maze, Node cell, std::array<bool, 4> oldWalls);
+
+    int distance(int i, int j) const { return dist[i + j * m]; }
+    const SearchStats& stats() const { return work; }
+    template<class MazeT>
+    bool path(const MazeT& maze, Node start, NodeStack<m, n>& path) const;
+
+private:
+    template<class MazeT>
+    bool supported(const MazeT& maze, int c) const;
+    template<class MazeT>
+    void relax(const MazeT& maze);
+
+    static Node node(int c) { return {c % m, c / m}; }
+    static Node neighbor(Node v, int wall);
+
+    Distance dist[m * n];
+    BitArray2D<m, n> goals;
+    BitArray2D<m, n> affected;
+    NodeStack<m, n> affectedCells;
+    BucketQueue<m * n> queue;
+    SearchStats work;
+};
+
+
+template<int m, int n>
+Node FloodFill<m, n>::neighbor(Node v, int wall)
+{
+    if (0 == wall)
+        ++v.i;
+    else if (1 == wall)
+        ++v.j;
+    else if (2 == wall)
+        --v.i;
+    else if (3 == wall)
+        --v.j;
+    return v;
+}
+
+
+template<int m, int n>
+template<class MazeT>
+void FloodFill<m, n>::reset(const MazeT& maze, Node goal)
+{
+    BitArray2D<m, n> g;
+    g.set(goal.i, goal.j, true);
+    reset(maze, g);
+}
+
+
+template<int m, int n>
+template<class MazeT>
+void FloodFill<m, n>::reset(const MazeT& maze, const BitArray2D<m, n>& goals)
+{
+    this->goals = goals;
+
+    for (int c = 0; c < m * n; ++c)
+    {
+        Node v = node(c);
+        dist[c] = goals.get(v.i, v.j) ? 0 : unreachable;
+        if (0 == dist[c])
+            queue.push(c, 0);
+    }
+
+    relax(maze);
+}
+
+
+template<int m, int n>
+template<class MazeT>
+void FloodFill<m, n>::update(const MazeT& maze, Node cell, std::array<bool, 4> oldWalls)
+{
+    TRACE_SCOPE("flood_update");
+
+    auto cw = maze.getCellWalls(cell.i, cell.j);
+
+    // Pass 1: find the cells that lost their support through a closed wall
+    for (int wall = 0; wall < 4; ++wall)
+    {
+        if (!cw[wall] || oldWalls[wall])
+            continue;
+
+        Node ends[2] = {cell, neighbor(cell, wall)};
+        for (auto v : ends)
+        {
+            int c = v.i + v.j * m;
+            if (dist[c] != 0 && dist[c] != unreachable)
+                queue.push(c, dist[c]);
+        }
+    }
+
+    while (!queue.empty())
+    {
+        int x = queue.pop();
+        ++work.expanded;
+        if (supported(maze, x))
+            continue;
+
+        Node v = node(x);
+        affected.set(v.i, v.j, true);
+        affectedCells.push(v);
+
+        auto vw = maze.getCellWalls(v.i, v.j);
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (vw[wall])
+                continue;
+
+            Node u = neighbor(v, wall);
+            int z = u.i + u.j * m;
+            if (dist[z] == dist[x] + 1 && !affected.get(u.i, u.j))
+                queue.push(z, dist[z]);
+        }
+    }
+
+    // Pass 2: re-seed the affected cells from the rest of the field and
+    // relax them along with the cells on both sides of any opened wall
+    for (int k = 0; k < affectedCells.size(); ++k)
+    {
+        Node v = affectedCells[k];
+        dist[v.i + v.j * m] = unreachable;
+    }
+
+    while (!affectedCells.empty())
+    {
+        Node v = affectedCells.pop();
+        affected.set(v.i, v.j, false);
+
+        int best = unreachable;
+        auto vw = maze.getCellWalls(v.i, v.j);
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (vw[wall])
+                continue;
+
+            Node u = neighbor(v, wall);
+            int d = dist[u.i + u.j * m] + 1;
+            if (d < best)
+                best = d;
+        }
+
+        if (best < unreachable)
+        {
+            dist[v.i + v.j * m] = best;
+            queue.push(v.i + v.j * m, best);
+        }
+    }
+
+    for (int wall = 0; wall < 4; ++wall)
+    {
+        if (cw[wall] || !oldWalls[wall])
+            continue;
+
+        Node ends[2] = {cell, neighbor(cell, wall)};
+        for (auto v : ends)
+        {
+            int c = v.i + v.j * m;
+            if (dist[c] != unreachable)
+                queue.push(c, dist[c]);
+        }
+    }
+
+    relax(maze);
+}
+
+
+template<int m, int n>
+template<class MazeT>
+bool FloodFill<m, n>::supported(const MazeT& maze, int c) const
+{
+    Node v = node(c);
+    auto cw = maze.getCellWalls(v.i, v.j);
+
+    for (int wall = 0; wall < 4; ++wall)
+    {
+        if (cw[wall])
+            continue;
+
+        Node u = neighbor(v, wall);
+        if (dist[u.i + u.j * m] + 1 == dist[c] && !affected.get(u.i, u.j))
+            return true;
+    }
+
+    return false;
+}
+
+
+template<int m, int n>
+template<class MazeT>
+void FloodFill<m, n>::relax(const MazeT& maze)
+{
+    while (!queue.empty())
+    {
+        int c = queue.pop();
+        Node v = node(c);
+        auto cw = maze.getCellWalls(v.i, v.j);
+        ++work.expanded;
+
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (cw[wall])
+                continue;
+
+            Node u = neighbor(v, wall);
+            int z = u.i + u.j * m;
+            if (dist[c] + 1 < dist[z])
+            {
+                dist[z] = dist[c] + 1;
+                queue.push(z, dist[z]);
+            }
+        }
+    }
+}
+
+
+// Follows the field downhill from start. The path is returned in the same
+// order as bfs(): start on top of the stack, goal at the bottom.
+template<int m, int n>
+template<class MazeT>
+bool FloodFill<m, n>::path(const MazeT& maze, Node start, NodeStack<m, n>& path) const
+{
+    path.clear();
+
+    if (dist[start.i + start.j * m] == unreachable)
+        return false;
+
+    // The length is known, so the path is written in place from the top
+    // instead of being reversed through a second stack
+    Node v = start;
+    path.resize(dist[start.i + start.j * m] + 1);
+    path.set(0, v);
+
+    for (int k = 1; k < path.size(); ++k)
+    {
+        auto cw = maze.getCellWalls(v.i, v.j);
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            Node u = neighbor(v, wall);
+            if (!cw[wall] && dist[u.i + u.j * m] + 1 == dist[v.i + v.j * m])
+            {
+                v = u;
+                break;
+            }
+        }
+        path.set(k, v);
+    }
+
+    return true;
+}
+
+#endif // FLOODFILL_HPP
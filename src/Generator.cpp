@@ -0,0 +1,35 @@
+#include "Generator.hpp"
+
+
+const char* algorithmName(MazeAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+    case MazeAlgorithm::Backtracker: return "backtracker";
+    case MazeAlgorithm::Kruskal:     return "kruskal";
+    case MazeAlgorithm::Wilson:      return "wilson";
+    case MazeAlgorithm::Micromouse:  return "micromouse";
+    }
+    return "";
+}
+
+
+bool parseAlgorithm(const std::string& name, MazeAlgorithm& algorithm)
+{
+    const MazeAlgorithm all[] = {
+        MazeAlgorithm::Backtracker,
+        MazeAlgorithm::Kruskal,
+        MazeAlgorithm::Wilson,
+        MazeAlgorithm::Micromouse };
+
+    for (MazeAlgorithm a : all)
+    {
+        if (name == algorithmName(a))
+        {
+            algorithm = a;
+            return true;
+        }
+    }
+
+    return false;
+}
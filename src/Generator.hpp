@@ -0,0 +1,432 @@
+#ifndef GENERATOR_HPP
+#define GENERATOR_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "Random.hpp"
+
+
+/* Maze generators.
+ *
+ * Backtracker, Kruskal and Wilson make perfect mazes: every cell is reachable
+ * and there is exactly one path between any two cells.
+ *     Backtracker  randomized depth-first search; long winding corridors
+ *     Kruskal      random spanning tree by union-find; many short dead ends
+ *     Wilson       loop-erased random walks; a uniformly random spanning tree
+ *
+ * Micromouse follows the competition layout rules instead:
+ *     - the goal is the center 2x2 room (the center cell for odd sizes),
+ *       with no walls inside it and a single entrance
+ *     - the start cell (m - 1, 0) is closed on every side but +j
+ *     - every post outside the goal room touches at least one wall
+ * It starts from a spanning tree and then removes some walls to add loops
+ * (about one per 32 cells unless asked otherwise), so that following a wall
+ * does not reach the goal.
+ *
+ * A maze is fully determined by its algorithm, seed and stream. The stream
+ * lets batches give every maze its own number without changing the seed, so
+ * maze k of a batch is the same however the batch is split between threads.
+ *
+ * The working arrays are kept in the object and reused between calls, so
+ * make one generator per thread and keep it. For large mazes allocate it on
+ * the heap, or use generateMaze().
+ */
+
+
+enum class MazeAlgorithm
+{
+    Backtracker,
+    Kruskal,
+    Wilson,
+    Micromouse
+};
+
+const char* algorithmName(MazeAlgorithm algorithm);
+bool parseAlgorithm(const std::string& name, MazeAlgorithm& algorithm);
+
+
+template<int m, int n>
+class MazeGenerator
+{
+public:
+    void generate(Maze<m, n>& maze, MazeAlgorithm algorithm,
+                  std::uint64_t seed, std::uint64_t stream = 0);
+
+    void backtracker(Maze<m, n>& maze, Rng& rng);
+    void kruskal(Maze<m, n>& maze, Rng& rng);
+    void wilson(Maze<m, n>& maze, Rng& rng);
+
+    // loops < 0 picks the default number of walls to remove
+    void micromouse(Maze<m, n>& maze, Rng& rng, int loops = -1);
+
+private:
+    static const int cells = m * n;
+    static const int mEdges = (m - 1) * n;
+    static const int edges = mEdges + m * (n - 1);
+
+    static Node neighbor(Node v, int wall);
+    static bool inside(Node v) { return v.i >= 0 && v.i < m && v.j >= 0 && v.j < n; }
+
+    // Edge e joins cell a to cell b through wall direction 0 or 1 of a
+    static void edgeCells(int e, Node& a, Node& b, int& wall);
+
+    int find(int c);
+    bool unite(int a, int b);
+    void shuffleEdges(Rng& rng, int count);
+    int spanningTree(Maze<m, n>& maze, int count, int needed);
+    bool lastWall(const Maze<m, n>& maze, int pi, int pj) const;
+
+    int parent[cells];
+    int order[edges];
+    unsigned char walk[cells];
+    BitArray2D<m, n> marked;
+    NodeStack<m, n> stack;
+};
+
+
+// Generates one maze with a temporary generator allocated on the heap
+template<int m, int n>
+void generateMaze(Maze<m, n>& maze, MazeAlgorithm algorithm,
+                  std::uint64_t seed, std::uint64_t stream = 0);
+
+
+template<int m, int n>
+void MazeGenerator<m, n>::generate(Maze<m, n>& maze, MazeAlgorithm algorithm,
+                                   std::uint64_t seed, std::uint64_t stream)
+{
+    Rng rng(seed, stream);
+
+    switch (algorithm)
+    {
+    case MazeAlgorithm::Backtracker: backtracker(maze, rng); break;
+    case MazeAlgorithm::Kruskal:     kruskal(maze, rng); break;
+    case MazeAlgorithm::Wilson:      wilson(maze, rng); break;
+    case MazeAlgorithm::Micromouse:  micromouse(maze, rng); break;
+    }
+}
+
+
+template<int m, int n>
+void MazeGenerator<m, n>::backtracker(Maze<m, n>& maze, Rng& rng)
+{
+    maze.fill();
+    marked.setAll(false);
+    stack.clear();
+
+    Node start = {int(rng.below(m)), int(rng.below(n))};
+    marked.set(start.i, start.j, true);
+    stack.push(start);
+
+    while (!stack.empty())
+    {
+        Node v = stack.peek();
+
+        int open[4];
+        int count = 0;
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            Node u = neighbor(v, wall);
+            if (inside(u) && !marked.get(u.i, u.j))
+                open[count++] = wall;
+        }
+
+        if (0 == count)
+        {
+            stack.pop();
+            continue;
+        }
+
+        int wall = open[rng.below(count)];
+        Node u = neighbor(v, wall);
+        maze.setWall(v.i, v.j, wall, false);
+        marked.set(u.i, u.j, true);
+        stack.push(u);
+    }
+}
+
+
+template<int m, int n>
+void MazeGenerator<m, n>::kruskal(Maze<m, n>& maze, Rng& rng)
+{
+    maze.fill();
+
+    for (int c = 0; c < cells; ++c)
+        parent[c] = c;
+    for (int e = 0; e < edges; ++e)
+        order[e] = e;
+    shuffleEdges(rng, edges);
+    spanningTree(maze, edges, cells - 1);
+}
+
+
+template<int m, int n>
+void MazeGenerator<m, n>::wilson(Maze<m, n>& maze, Rng& rng)
+{
+    maze.fill();
+    marked.setAll(false); // Cells in the tree
+
+    int root = rng.below(cells);
+    marked.set(root % m, root / m, true);
+
+    for (int c = 0; c < cells; ++c)
+    {
+        Node v = {c % m, c / m};
+
+        // Random walk until the tree is hit, remembering only the last exit
+        // from each cell, which erases the loops
+        while (!marked.get(v.i, v.j))
+        {
+            Node u;
+            int wall;
+            do
+            {
+                wall = rng.next() >> 62;
+                u = neighbor(v, wall);
+            }
+            while (!inside(u));
+
+            walk[v.i + v.j * m] = wall;
+            v = u;
+        }
+
+        // Add the loop-erased path to the tree
+        v = {c % m, c / m};
+        while (!marked.get(v.i, v.j))
+        {
+            int wall = walk[v.i + v.j * m];
+            marked.set(v.i, v.j, true);
+            maze.setWall(v.i, v.j, wall, false);
+            v = neighbor(v, wall);
+        }
+    }
+}
+
+
+template<int m, int n>
+void MazeGenerator<m, n>::micromouse(Maze<m, n>& maze, Rng& rng, int loops)
+{
+    maze.fill();
+
+    if (loops < 0)
+        loops = cells / 32;
+
+    for (int c = 0; c < cells; ++c)
+        parent[c] = c;
+
+    // The goal room is one node of the tree: open its inside walls and put
+    // its cells in one set
+    int gi = (m - 1) / 2;
+    int gj = (n - 1) / 2;
+    int gm = (m % 2 == 0 && m >= 4) ? 2 : 1;
+    int gn = (n % 2 == 0 && n >= 4) ? 2 : 1;
+    auto inGoal = [&](Node v) {
+        return v.i >= gi && v.i < gi + gm && v.j >= gj && v.j < gj + gn;
+    };
+    int joined = 0;
+    for (int i = gi; i < gi + gm; ++i)
+    {
+        for (int j = gj; j < gj + gn; ++j)
+        {
+            if (i + 1 < gi + gm)
+                maze.setWall(i, j, 0, false);
+            if (j + 1 < gj + gn)
+                maze.setWall(i, j, 1, false);
+            joined += unite(gi + gj * m, i + j * m);
+        }
+    }
+
+    Node start = {m - 1, 0};
+
+    // Edges out of the goal room and out of the start cell, other than the
+    // chosen entrance and the +j exit, are left out of the shuffle
+    int kept = 0;
+    int entrances = 0;
+    int entrance = -1;
+    for (int e = 0; e < edges; ++e)
+    {
+        Node a;
+        Node b;
+        int wall;
+        edgeCells(e, a, b, wall);
+
+        if (inGoal(a) && inGoal(b))
+            continue;
+        if (inGoal(a) != inGoal(b))
+        {
+            // Reservoir sample one entrance
+            if (!(a == start || b == start) && rng.below(++entrances) == 0)
+                entrance = e;
+            continue;
+        }
+        if ((a == start || b == start) && !(1 == wall && a == start))
+            continue;
+
+        order[kept++] = e;
+    }
+
+    if (entrance >= 0)
+    {
+        Node a;
+        Node b;
+        int wall;
+        edgeCells(entrance, a, b, wall);
+        maze.setWall(a.i, a.j, wall, false);
+        joined += unite(a.i + a.j * m, b.i + b.j * m);
+    }
+
+    shuffleEdges(rng, kept);
+    spanningTree(maze, kept, cells - 1 - joined);
+
+    // Knock out walls to make loops, as long as neither end post is left
+    // without walls. Walls of the goal room and start cell stay.
+    for (int attempt = 0; loops > 0 && attempt < 8 * cells; ++attempt)
+    {
+        int e = order[rng.below(kept)];
+        Node a;
+        Node b;
+        int wall;
+        edgeCells(e, a, b, wall);
+
+        if (!maze.getCellWalls(a.i, a.j)[wall] || a == start || b == start)
+            continue;
+
+        // Posts at the ends of the wall, numbered by the cell corner below
+        // and to the right of them
+        int pi1 = 0 == wall ? a.i + 1 : a.i;
+        int pj1 = 0 == wall ? a.j : a.j + 1;
+        int pi2 = a.i + 1;
+        int pj2 = a.j + 1;
+        if (lastWall(maze, pi1, pj1) || lastWall(maze, pi2, pj2))
+            continue;
+
+        maze.setWall(a.i, a.j, wall, false);
+        --loops;
+    }
+}
+
+
+template<int m, int n>
+Node MazeGenerator<m, n>::neighbor(Node v, int wall)
+{
+    if (0 == wall)
+        ++v.i;
+    else if (1 == wall)
+        ++v.j;
+    else if (2 == wall)
+        --v.i;
+    else
+        --v.j;
+    return v;
+}
+
+
+template<int m, int n>
+void MazeGenerator<m, n>::edgeCells(int e, Node& a, Node& b, int& wall)
+{
+    if (e < mEdges)
+    {
+        a = {e % (m - 1), e / (m - 1)};
+        b = {a.i + 1, a.j};
+        wall = 0;
+    }
+    else
+    {
+        e -= mEdges;
+        a = {e % m, e / m};
+        b = {a.i, a.j + 1};
+        wall = 1;
+    }
+}
+
+
+// Union-find with path halving
+template<int m, int n>
+int MazeGenerator<m, n>::find(int c)
+{
+    while (parent[c] != c)
+    {
+        parent[c] = parent[parent[c]];
+        c = parent[c];
+    }
+    return c;
+}
+
+
+template<int m, int n>
+bool MazeGenerator<m, n>::unite(int a, int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return false;
+    parent[b] = a;
+    return true;
+}
+
+
+// Fisher-Yates shuffle of the first count entries of order
+template<int m, int n>
+void MazeGenerator<m, n>::shuffleEdges(Rng& rng, int count)
+{
+    for (int k = count - 1; k > 0; --k)
+    {
+        int r = rng.below(k + 1);
+        int t = order[k];
+        order[k] = order[r];
+        order[r] = t;
+    }
+}
+
+
+// Opens the first count edges of order that join two separate trees, until
+// needed edges have been opened. Returns the number still needed.
+template<int m, int n>
+int MazeGenerator<m, n>::spanningTree(Maze<m, n>& maze, int count, int needed)
+{
+    for (int k = 0; k < count && needed > 0; ++k)
+    {
+        Node a;
+        Node b;
+        int wall;
+        edgeCells(order[k], a, b, wall);
+        if (unite(a.i + a.j * m, b.i + b.j * m))
+        {
+            maze.setWall(a.i, a.j, wall, false);
+            --needed;
+        }
+    }
+
+    return needed;
+}
+
+
+// True if post (pi, pj) is inside the maze and touches at most one wall
+template<int m, int n>
+bool MazeGenerator<m, n>::lastWall(const Maze<m, n>& maze, int pi, int pj) const
+{
+    if (pi <= 0 || pi >= m || pj <= 0 || pj >= n)
+        return false;
+
+    const BitArray2D<m - 1, n>& mWalls = maze.getMWalls();
+    const BitArray2D<m, n - 1>& nWalls = maze.getNWalls();
+
+    int count = mWalls.get(pi - 1, pj - 1) + mWalls.get(pi - 1, pj) +
+                nWalls.get(pi - 1, pj - 1) + nWalls.get(pi, pj - 1);
+
+    return count <= 1;
+}
+
+
+template<int m, int n>
+void generateMaze(Maze<m, n>& maze, MazeAlgorithm algorithm,
+                  std::uint64_t seed, std::uint64_t stream)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    generator->generate(maze, algorithm, seed, stream);
+}
+
+#endif // GENERATOR_HPP
@@ -0,0 +1,340 @@
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "Maze.hpp"
+
+
+/* Edit history of a maze with unlimited undo and redo.
+ *
+ * Every edit is kept as the list of walls it changed, so a single toggled
+ * wall costs one WallDelta however large the maze is. Walls are stored by
+ * the cell on their -i or -j side, as wall 0 (+i) or 1 (+j), which is where
+ * Maze keeps them. Whole-maze snapshots are only taken once the deltas
+ * since the last snapshot use as much memory as a snapshot, which bounds
+ * the snapshots by the deltas and lets jump() reach any point in the
+ * history by loading a snapshot and applying a bounded number of deltas.
+ *
+ * The history mirrors the state of the maze at its current position. Edits
+ * either go through setWall(), or are made to the maze directly and then
+ * recorded as one edit with commit(), which compares the maze with the
+ * mirror. Recording an edit after undoing drops the edits that could have
+ * been redone.
+ */
+template<int m, int n>
+class MazeHistory
+{
+public:
+    struct WallDelta
+    {
+        std::uint32_t cell; // i + j * m
+        std::uint8_t wall;  // 0 (+i) or 1 (+j)
+        bool before;
+        bool after;
+    };
+
+    explicit MazeHistory(int snapshotDeltas = defaultSnapshotDeltas());
+
+    // Forgets all edits and starts a new history at the given maze
+    void reset(const Maze<m, n>& maze);
+
+    // Sets a wall of the maze and records the change as one edit. Returns
+    // false for border walls; setting a wall to its current value records
+    // nothing.
+    bool setWall(Maze<m, n>& maze, int i, int j, int wall, bool b);
+
+    // Records every wall that differs between the maze and the current
+    // position as one edit. Returns the number of walls changed.
+    int commit(const Maze<m, n>& maze);
+
+    // These first commit any changes made to the maze since the last edit.
+    // They return false, leaving the maze unchanged, when there is nothing
+    // to undo or redo or the position is outside [0, size()].
+    bool undo(Maze<m, n>& maze);
+    bool redo(Maze<m, n>& maze);
+    bool jump(Maze<m, n>& maze, int position);
+
+    // Number of edits recorded, and the number of them currently applied
+    int size() const { return int(edits.size()); }
+    int position() const { return current; }
+
+    // Bytes used by the deltas and snapshots
+    std::size_t memory() const;
+
+    // Writes the maze the history started from as a save() string on the
+    // first line, then one line per edit with its changed walls as
+    // "i,j,wall,before,after" separated by ';'
+    bool exportTo(std::ostream& out) const;
+
+    static int defaultSnapshotDeltas()
+    {
+        int perSnapshot = int(Maze<m, n>::byteCount / sizeof(WallDelta));
+        return perSnapshot > 64 ? perSnapshot : 64;
+    }
+
+private:
+    struct Snapshot
+    {
+        int position;
+        std::vector<unsigned char> bytes;
+    };
+
+    std::size_t offset(int position) const
+    {
+        return position < size() ? edits[position] : deltas.size();
+    }
+
+    void record(int i, int j, int wall, bool b);
+    void endEdit(std::size_t first);
+    void apply(Maze<m, n>& maze, int from, int to);
+
+    int snapshotDeltas;
+    int current = 0;
+    Maze<m, n> state;
+    std::vector<WallDelta> deltas;
+    std::vector<std::uint32_t> edits; // Index of the first delta of each edit
+    std::vector<Snapshot> snapshots;  // In order of position, the first at 0
+};
+
+
+template<int m, int n>
+MazeHistory<m, n>::MazeHistory(int snapshotDeltas)
+    : snapshotDeltas(snapshotDeltas > 0 ? snapshotDeltas : 1)
+{
+    reset(state);
+}
+
+
+template<int m, int n>
+void MazeHistory<m, n>::reset(const Maze<m, n>& maze)
+{
+    state = maze;
+    current = 0;
+    deltas.clear();
+    edits.clear();
+    snapshots.clear();
+
+    snapshots.push_back(Snapshot{0, std::vector<unsigned char>(Maze<m, n>::byteCount)});
+    state.saveBytes(snapshots.back().bytes.data());
+}
+
+
+template<int m, int n>
+bool MazeHistory<m, n>::setWall(Maze<m, n>& maze, int i, int j, int wall, bool b)
+{
+    commit(maze);
+
+    bool before = maze.getCellWalls(i, j)[wall & 3];
+    if (!maze.setWall(i, j, wall, b))
+        return false;
+
+    if (before != b)
+    {
+        std::size_t first = deltas.size();
+        record(i, j, wall, b);
+        endEdit(first);
+    }
+
+    return true;
+}
+
+
+template<int m, int n>
+int MazeHistory<m, n>::commit(const Maze<m, n>& maze)
+{
+    std::size_t first = deltas.size();
+    const BitArray2D<m - 1, n>& mWalls = maze.getMWalls();
+    const BitArray2D<m, n - 1>& nWalls = maze.getNWalls();
+
+    // Only the bytes that differ are looked at bit by bit; the unused bits
+    // at the end of each plane are skipped
+    for (int k = 0; k < mWalls.size(); ++k)
+    {
+        unsigned char diff = mWalls[k] ^ state.getMWalls()[k];
+        for (int bit = 0; diff >> bit; ++bit)
+        {
+            int index = k * 8 + bit;
+            if (((diff >> bit) & 0x1) && index < (m - 1) * n)
+                record(index % (m - 1), index / (m - 1), 0, mWalls.get(index % (m - 1), index / (m - 1)));
+        }
+    }
+
+    for (int k = 0; k < nWalls.size(); ++k)
+    {
+        unsigned char diff = nWalls[k] ^ state.getNWalls()[k];
+        for (int bit = 0; diff >> bit; ++bit)
+        {
+            int index = k * 8 + bit;
+            if (((diff >> bit) & 0x1) && index < m * (n - 1))
+                record(index % m, index / m, 1, nWalls.get(index % m, index / m));
+        }
+    }
+
+    int changed = int(deltas.size() - first);
+    if (changed > 0)
+        endEdit(first);
+    return changed;
+}
+
+
+template<int m, int n>
+bool MazeHistory<m, n>::undo(Maze<m, n>& maze)
+{
+    commit(maze);
+    return jump(maze, current - 1);
+}
+
+
+template<int m, int n>
+bool MazeHistory<m, n>::redo(Maze<m, n>& maze)
+{
+    commit(maze);
+    return jump(maze, current + 1);
+}
+
+
+template<int m, int n>
+bool MazeHistory<m, n>::jump(Maze<m, n>& maze, int position)
+{
+    commit(maze);
+
+    if (position < 0 || position > size())
+        return false;
+
+    // Either step there from the current position, or start from the last
+    // snapshot before it, whichever touches fewer bytes
+    std::size_t stepping = offset(position) > offset(current) ?
+                           offset(position) - offset(current) :
+                           offset(current) - offset(position);
+
+    int s = int(snapshots.size()) - 1;
+    while (snapshots[s].position > position)
+        --s;
+    std::size_t loading = Maze<m, n>::byteCount / sizeof(WallDelta) +
+                          offset(position) - offset(snapshots[s].position);
+
+    if (loading < stepping)
+    {
+        maze.loadBytes(snapshots[s].bytes.data());
+        state.loadBytes(snapshots[s].bytes.data());
+        current = snapshots[s].position;
+    }
+
+    apply(maze, current, position);
+    current = position;
+    return true;
+}
+
+
+template<int m, int n>
+std::size_t MazeHistory<m, n>::memory() const
+{
+    std::size_t bytes = deltas.capacity() * sizeof(WallDelta) +
+                        edits.capacity() * sizeof(std::uint32_t) +
+                        snapshots.capacity() * sizeof(Snapshot);
+    for (const Snapshot& s : snapshots)
+        bytes += s.bytes.capacity();
+    return bytes;
+}
+
+
+template<int m, int n>
+bool MazeHistory<m, n>::exportTo(std::ostream& out) const
+{
+    Maze<m, n> base;
+    base.loadBytes(snapshots.front().bytes.data());
+    out << base.save() << '\n';
+
+    for (int e = 0; e < size(); ++e)
+    {
+        for (std::size_t k = offset(e); k < offset(e + 1); ++k)
+        {
+            const WallDelta& d = deltas[k];
+            if (k > offset(e))
+                out << ';';
+            out << d.cell % m << ',' << d.cell / m << ',' << int(d.wall) << ','
+                << d.before << ',' << d.after;
+        }
+        out << '\n';
+    }
+
+    return bool(out);
+}
+
+
+// Adds a delta for a wall that is about to change to b in the mirror
+template<int m, int n>
+void MazeHistory<m, n>::record(int i, int j, int wall, bool b)
+{
+    // Store the wall by the cell on its -i or -j side
+    if (2 == wall)
+    {
+        --i;
+        wall = 0;
+    }
+    else if (3 == wall)
+    {
+        --j;
+        wall = 1;
+    }
+
+    deltas.push_back(WallDelta{std::uint32_t(i + j * m), std::uint8_t(wall), !b, b});
+    state.setWall(i, j, wall, b);
+}
+
+
+// Closes the edit made of the deltas from first on
+template<int m, int n>
+void MazeHistory<m, n>::endEdit(std::size_t first)
+{
+    // Drop the edits that were undone, with their deltas and snapshots;
+    // the new deltas are moved down over them
+    if (current < size())
+    {
+        std::size_t end = offset(current);
+        deltas.erase(deltas.begin() + end, deltas.begin() + first);
+        edits.resize(current);
+        while (snapshots.back().position > current)
+            snapshots.pop_back();
+        first = end;
+    }
+
+    edits.push_back(std::uint32_t(first));
+    ++current;
+
+    if (deltas.size() - offset(snapshots.back().position) >= std::size_t(snapshotDeltas))
+    {
+        snapshots.push_back(Snapshot{current, std::vector<unsigned char>(Maze<m, n>::byteCount)});
+        state.saveBytes(snapshots.back().bytes.data());
+    }
+}
+
+
+// Applies the edits between two positions to the maze and the mirror,
+// backwards if to is before from
+template<int m, int n>
+void MazeHistory<m, n>::apply(Maze<m, n>& maze, int from, int to)
+{
+    if (to >= from)
+    {
+        for (std::size_t k = offset(from); k < offset(to); ++k)
+        {
+            const WallDelta& d = deltas[k];
+            maze.setWall(d.cell % m, d.cell / m, d.wall, d.after);
+            state.setWall(d.cell % m, d.cell / m, d.wall, d.after);
+        }
+    }
+    else
+    {
+        for (std::size_t k = offset(from); k > offset(to); --k)
+        {
+            const WallDelta& d = deltas[k - 1];
+            maze.setWall(d.cell % m, d.cell / m, d.wall, d.before);
+            state.setWall(d.cell % m, d.cell / m, d.wall, d.before);
+        }
+    }
+}
+
+#endif // HISTORY_HPP
@@ -2,12 +2,17 @@
 #define MAZE_HPP
 
 #include <array>
-#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#ifndef MAZE_EMBEDDED
 #include <string>
 #include <sstream>
 #include <iomanip>
-#include <cstdlib>
+#endif
 #include "BitArray2D.hpp"
+#include "WallStorage.hpp"
+#include "Trace.hpp"
 
 
 /* The get/setCellsWalls functions take and return arrays of booleans
@@ -21,6 +26,18 @@
  * operation will succeed and the function will return false to signal the
  * invalid wall setting.
  *
+ * hash() is computed from the walls the first time it is needed after they
+ * change, so caches keyed on it can cheaply notice edits. The cached value
+ * is atomic, so a maze can be read, hash() included, from several threads at
+ * once; threads that race to compute it store the same value.
+ *
+ * The embedded profile (MAZE_EMBEDDED, see Embedded.hpp) leaves out the
+ * string codec load()/save(); loadBytes()/saveBytes() are always there.
+ *
+ * Storage selects how the walls are laid out in memory: PlaneWalls, two bit
+ * planes, or CellWalls, a byte of walls and known walls per cell (see
+ * WallStorage.hpp). The interface and the saved formats are the same.
+ *
  * The maze is drawn using matrix convention for indices and directions:
  * +-------+-------+---> j
  * | (0,0) | (0,1) |
@@ -33,58 +50,107 @@
  */
 
 
-template<int m, int n>
+template<int m, int n, class Storage = PlaneWalls<m, n>>
 class Maze
 {
 public:
+    static const int rows = m;
+    static const int cols = n;
+
     Maze();
+    Maze(const Maze& other);
+    Maze& operator=(const Maze& other);
 
     std::array<bool, 4> getCellWalls(int i, int j) const;
     bool setCellWalls(int i, int j, std::array<bool, 4> cw);
+
+    // Sets a single wall of a cell, using the same direction index as cw.
+    // Returns false for border walls, which cannot be removed.
+    bool setWall(int i, int j, int wall, bool b);
     
     void fill();
     void clear();
+
+    // Sets every wall bit at random. The result is noise, usually with closed
+    // off regions; use MazeGenerator (Generator.hpp) to make real mazes.
     void randomize();
 
+#ifndef MAZE_EMBEDDED
     bool load(std::string);
     std::string save() const;
-    
-    void draw(sf::RenderTarget& target,
-              float cellSize = 16.f,
-              float lineThickness = 2.f,
-              sf::Color lineColor = sf::Color::White) const;
+#endif
+
+    // Raw wall bytes in the same order as the hex digits of save(): the m
+    // walls followed by the n walls, byteCount bytes in total
+    static const int byteCount = ((m - 1) * n + 7) / 8 + (m * (n - 1) + 7) / 8;
+    void loadBytes(const unsigned char* bytes);
+    void saveBytes(unsigned char* bytes) const;
+
+    // The wall planes: getMWalls().get(i, j) is the wall between (i, j) and
+    // (i + 1, j), getNWalls().get(i, j) the wall between (i, j) and (i, j + 1).
+    // References with PlaneWalls, copies built on the fly with CellWalls.
+    typename Storage::MPlane getMWalls() const { return walls.getMWalls(); }
+    typename Storage::NPlane getNWalls() const { return walls.getNWalls(); }
+
+    // Which walls of a cell are known: all of them unless forgetWalls() has
+    // opened them since, and the walls that are there or unknown. Only with
+    // CellWalls storage.
+    std::array<bool, 4> getKnownWalls(int i, int j) const;
+    std::array<bool, 4> getClosedWalls(int i, int j) const;
+    void forgetWalls();
+
+    std::uint64_t hash() const;
 
 private:
-    BitArray2D<m - 1, n> mWalls;
-    BitArray2D<m, n - 1> nWalls;
+    static const int mBytes = ((m - 1) * n + 7) / 8;
+
+    Storage walls;
+
+    void invalidateHash() { hashValid.store(false, std::memory_order_relaxed); }
+
+    mutable std::atomic<std::uint64_t> hashValue{0};
+    mutable std::atomic<bool> hashValid{false};
 };
 
 
-template<int m, int n>
-Maze<m, n>::Maze()
+template<int m, int n, class Storage>
+Maze<m, n, Storage>::Maze()
 {
     clear();
 }
 
 
-template<int m, int n>
-std::array<bool, 4> Maze<m, n>::getCellWalls(int i, int j) const
+template<int m, int n, class Storage>
+Maze<m, n, Storage>::Maze(const Maze& other)
+    : walls(other.walls)
+{
+    hashValue.store(other.hashValue.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    hashValid.store(other.hashValid.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+
+template<int m, int n, class Storage>
+Maze<m, n, Storage>& Maze<m, n, Storage>::operator=(const Maze& other)
+{
+    walls = other.walls;
+    hashValue.store(other.hashValue.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    hashValid.store(other.hashValid.load(std::memory_order_acquire), std::memory_order_relaxed);
+    return *this;
+}
+
+
+template<int m, int n, class Storage>
+std::array<bool, 4> Maze<m, n, Storage>::getCellWalls(int i, int j) const
 {
     if (i < 0 || j < 0 || i >= m || j >= n)
         return {false, false, false, false};
 
-    std::array<bool, 4> cw = {
-        (m - 1 == i) || mWalls.get(i, j),
-        (n - 1 == j) || nWalls.get(i, j),
-        (0 == i) || mWalls.get(i - 1, j),
-        (0 == j) || nWalls.get(i, j - 1) };
-
-    return cw;
+    return walls.cell(i, j);
 }
 
 
-template<int m, int n>
-bool Maze<m, n>::setCellWalls(int i, int j, std::array<bool, 4> cw)
+template<int m, int n, class Storage>
+bool Maze<m, n, Storage>::setCellWalls(int i, int j, std::array<bool, 4> cw)
 {
     if (i < 0 || j < 0 || i >= m || j >= n)
         return false;
@@ -95,57 +161,105 @@ bool Maze<m, n>::setCellWalls(int i, int j, std::array<bool, 4> cw)
                   (0 == j && !cw[3]));
 
     if (i < m - 1)
-        mWalls.set(i, j, cw[0]);
+        walls.set(i, j, 0, cw[0]);
 
     if (j < n - 1)
-        nWalls.set(i, j, cw[1]);
+        walls.set(i, j, 1, cw[1]);
 
     if (i > 0)
-        mWalls.set(i - 1, j, cw[2]);
+        walls.set(i, j, 2, cw[2]);
 
     if (j > 0)
-        nWalls.set(i, j - 1, cw[3]);
+        walls.set(i, j, 3, cw[3]);
+
+    invalidateHash();
 
     // Returns false if the caller tried to set the boundary walls to false
     return !error;
 }
 
 
-template<int m, int n>
-void Maze<m, n>::clear()
+template<int m, int n, class Storage>
+bool Maze<m, n, Storage>::setWall(int i, int j, int wall, bool b)
 {
-    mWalls.setAll(false);
-    nWalls.setAll(false);
+    if ((0 == wall && i >= 0 && i < m - 1 && j >= 0 && j < n) ||
+        (1 == wall && i >= 0 && i < m && j >= 0 && j < n - 1) ||
+        (2 == wall && i > 0 && i < m && j >= 0 && j < n) ||
+        (3 == wall && i >= 0 && i < m && j > 0 && j < n))
+        walls.set(i, j, wall, b);
+    else
+        return false;
+
+    invalidateHash();
+    return true;
 }
 
 
-template<int m, int n>
-void Maze<m, n>::fill()
+template<int m, int n, class Storage>
+void Maze<m, n, Storage>::clear()
 {
-    mWalls.setAll(true);
-    nWalls.setAll(true);
+    walls.setAll(false);
+    invalidateHash();
 }
 
 
-template<int m, int n>
-void Maze<m, n>::randomize()
+template<int m, int n, class Storage>
+void Maze<m, n, Storage>::fill()
 {
-    for (int i = 0; i < mWalls.size(); ++i)
-        mWalls[i] = std::rand() % 256;
-    
-    for (int i = 0; i < nWalls.size(); ++i)
-        nWalls[i] = std::rand() % 256;
+    walls.setAll(true);
+    invalidateHash();
 }
 
 
-template<int m, int n>
-bool Maze<m, n>::load(std::string mazestr)
+template<int m, int n, class Storage>
+void Maze<m, n, Storage>::randomize()
 {
+    unsigned char bytes[byteCount];
+    for (int i = 0; i < byteCount; ++i)
+        bytes[i] = std::rand() % 256;
+
+    loadBytes(bytes);
+}
+
+
+template<int m, int n, class Storage>
+std::array<bool, 4> Maze<m, n, Storage>::getKnownWalls(int i, int j) const
+{
+    if (i < 0 || j < 0 || i >= m || j >= n)
+        return {false, false, false, false};
+
+    return walls.known(i, j);
+}
+
+
+template<int m, int n, class Storage>
+std::array<bool, 4> Maze<m, n, Storage>::getClosedWalls(int i, int j) const
+{
+    if (i < 0 || j < 0 || i >= m || j >= n)
+        return {false, false, false, false};
+
+    return walls.closed(i, j);
+}
+
+
+template<int m, int n, class Storage>
+void Maze<m, n, Storage>::forgetWalls()
+{
+    walls.forget();
+    invalidateHash();
+}
+
+
+#ifndef MAZE_EMBEDDED
+template<int m, int n, class Storage>
+bool Maze<m, n, Storage>::load(std::string mazestr)
+{
+    TRACE_SCOPE("maze_load");
+
     std::istringstream ss(mazestr);
     std::string tmp;
 
-    BitArray2D<m - 1, n> mwTmp;
-    BitArray2D<m, n - 1> nwTmp;
+    unsigned char bytes[byteCount];
     
     try
     {
@@ -163,96 +277,67 @@ bool Maze<m, n>::load(std::string mazestr)
 
         if (!std::getline(ss, tmp, ':'))
             return false;
-        for (int i = 0; i < mwTmp.size(); ++i)
-            mwTmp[i] = std::stoi(tmp.substr(i*2, 2), nullptr, 16);
+        for (int i = 0; i < mBytes; ++i)
+            bytes[i] = std::stoi(tmp.substr(i*2, 2), nullptr, 16);
 
         if (!std::getline(ss, tmp, ':'))
             return false;
-        for (int i = 0; i < nwTmp.size(); ++i)
-            nwTmp[i] = std::stoi(tmp.substr(i*2, 2), nullptr, 16);
+        for (int i = 0; i < byteCount - mBytes; ++i)
+            bytes[mBytes + i] = std::stoi(tmp.substr(i*2, 2), nullptr, 16);
     }
     catch (...)
     {
         return false;
     }
 
-    for (int i = 0; i < mWalls.size(); ++i)
-        mWalls[i] = mwTmp[i];
-    for (int i = 0; i < nWalls.size(); ++i)
-        nWalls[i] = nwTmp[i];
-
+    loadBytes(bytes);
     return true;
 }
 
 
-template<int m, int n>
-std::string Maze<m, n>::save() const
+template<int m, int n, class Storage>
+std::string Maze<m, n, Storage>::save() const
 {
+    unsigned char bytes[byteCount];
+    saveBytes(bytes);
+
     std::ostringstream ss;
     ss << m << ":" << n << ":" << std::hex << std::setfill('0');
-    for (int i = 0; i < mWalls.size(); ++i)
-        ss << std::setw(2) << int(mWalls[i]);
+    for (int i = 0; i < mBytes; ++i)
+        ss << std::setw(2) << int(bytes[i]);
     ss << ":";
-    for (int i = 0; i < nWalls.size(); ++i)
-        ss << std::setw(2) <<int(nWalls[i]);
+    for (int i = mBytes; i < byteCount; ++i)
+        ss << std::setw(2) << int(bytes[i]);
     return ss.str();
 }
+#endif
 
 
-template<int m, int n>
-void Maze<m, n>::draw(sf::RenderTarget& target, float cellSize, float lineThickness, sf::Color lineColor) const
+template<int m, int n, class Storage>
+void Maze<m, n, Storage>::loadBytes(const unsigned char* bytes)
 {
-    sf::RectangleShape line;
-    line.setFillColor(lineColor);
-
-    // Draw borders
-    line.setSize(sf::Vector2f(lineThickness / 2.f, cellSize * m));
-    line.setPosition(sf::Vector2f(0.f, 0.f));
-    target.draw(line);
+    walls.loadBytes(bytes);
+    invalidateHash();
+}
 
-    line.setPosition(sf::Vector2f(cellSize * n - lineThickness / 2.f, 0.f));
-    target.draw(line);
 
-    line.setSize(sf::Vector2f(cellSize * n, lineThickness / 2.f));
-    line.setPosition(sf::Vector2f(0.f, 0.f));
-    target.draw(line);
+template<int m, int n, class Storage>
+void Maze<m, n, Storage>::saveBytes(unsigned char* bytes) const
+{
+    walls.saveBytes(bytes);
+}
 
-    line.setPosition(sf::Vector2f(0.f, cellSize * m - lineThickness / 2.f));
-    target.draw(line);
 
-    // Draw m walls
-    line.setSize(sf::Vector2f(cellSize, lineThickness));
-    
-    for (int i = 0; i < m - 1; ++i)
-    {
-        for (int j = 0; j < n; ++j)
-        {
-            if (mWalls.get(i, j))
-            {
-                float x = j * cellSize;
-                float y = (i + 1) * cellSize - lineThickness / 2.f;
-                line.setPosition(sf::Vector2f(x, y));
-                target.draw(line);
-            }
-        }
-    }
+template<int m, int n, class Storage>
+std::uint64_t Maze<m, n, Storage>::hash() const
+{
+    if (hashValid.load(std::memory_order_acquire))
+        return hashValue.load(std::memory_order_relaxed);
 
-    // Draw n walls
-    line.setSize(sf::Vector2f(lineThickness, cellSize));
-    
-    for (int i = 0; i < m; ++i)
-    {
-        for (int j = 0; j < n - 1; ++j)
-        {
-            if (nWalls.get(i, j))
-            {
-                float x = (j + 1) * cellSize - lineThickness / 2.f;
-                float y = i * cellSize;
-                line.setPosition(sf::Vector2f(x, y));
-                target.draw(line);
-            }
-        }
-    }
+    std::uint64_t h = walls.hash();
+    hashValue.store(h, std::memory_order_relaxed);
+    hashValid.store(true, std::memory_order_release);
+    return h;
 }
 
 #endif // MAZE_HPP
@@ -0,0 +1,136 @@
+#ifndef MAZEDRAW_HPP
+#define MAZEDRAW_HPP
+
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "Maze.hpp"
+#include "Trace.hpp"
+
+
+/* Rendering lives outside of Maze.hpp so that the maze, the solver and the
+ * headless tools can be built without SFML. Only the GUI includes this file.
+ *
+ * MazeMesh keeps the walls of one maze as a single array of quads, drawn
+ * with one draw call. The quads are rebuilt only when the maze changes, which
+ * is detected through Maze::hash() (recomputed by the maze only after
+ * setCellWalls, setWall, fill, clear, randomize or load), or when the size or
+ * color change. Use one mesh per maze that is drawn every frame.
+ */
+template<int m, int n>
+class MazeMesh
+{
+public:
+    void draw(const Maze<m, n>& maze,
+              sf::RenderTarget& target,
+              float cellSize = 16.f,
+              float lineThickness = 2.f,
+              sf::Color lineColor = sf::Color::White);
+
+    // Number of times the quads were rebuilt
+    long rebuilds() const { return built; }
+
+private:
+    void build(const Maze<m, n>& maze);
+    void quad(float x, float y, float w, float h);
+
+    sf::VertexArray vertices{sf::Quads};
+    bool valid = false;
+    std::uint64_t key = 0;
+    float size = 0.f;
+    float thickness = 0.f;
+    sf::Color color;
+    long built = 0;
+};
+
+
+// Draws a maze once without keeping the quads
+template<int m, int n>
+void drawMaze(const Maze<m, n>& maze,
+              sf::RenderTarget& target,
+              float cellSize = 16.f,
+              float lineThickness = 2.f,
+              sf::Color lineColor = sf::Color::White);
+
+
+template<int m, int n>
+void MazeMesh<m, n>::draw(const Maze<m, n>& maze,
+                          sf::RenderTarget& target,
+                          float cellSize,
+                          float lineThickness,
+                          sf::Color lineColor)
+{
+    if (!valid || maze.hash() != key || cellSize != size ||
+        lineThickness != thickness || lineColor != color)
+    {
+        size = cellSize;
+        thickness = lineThickness;
+        color = lineColor;
+        build(maze);
+        key = maze.hash();
+        valid = true;
+    }
+
+    TRACE_TALLY("draw_calls");
+    target.draw(vertices);
+}
+
+
+template<int m, int n>
+void MazeMesh<m, n>::build(const Maze<m, n>& maze)
+{
+    vertices.clear();
+
+    // Borders
+    quad(0.f, 0.f, thickness / 2.f, size * m);
+    quad(size * n - thickness / 2.f, 0.f, thickness / 2.f, size * m);
+    quad(0.f, 0.f, size * n, thickness / 2.f);
+    quad(0.f, size * m - thickness / 2.f, size * n, thickness / 2.f);
+
+    // m walls
+    const BitArray2D<m - 1, n>& mWalls = maze.getMWalls();
+    for (int i = 0; i < m - 1; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            if (mWalls.get(i, j))
+                quad(j * size, (i + 1) * size - thickness / 2.f, size, thickness);
+        }
+    }
+
+    // n walls
+    const BitArray2D<m, n - 1>& nWalls = maze.getNWalls();
+    for (int i = 0; i < m; ++i)
+    {
+        for (int j = 0; j < n - 1; ++j)
+        {
+            if (nWalls.get(i, j))
+                quad((j + 1) * size - thickness / 2.f, i * size, thickness, size);
+        }
+    }
+
+    ++built;
+}
+
+
+template<int m, int n>
+void MazeMesh<m, n>::quad(float x, float y, float w, float h)
+{
+    vertices.append(sf::Vertex(sf::Vector2f(x, y), color));
+    vertices.append(sf::Vertex(sf::Vector2f(x + w, y), color));
+    vertices.append(sf::Vertex(sf::Vector2f(x + w, y + h), color));
+    vertices.append(sf::Vertex(sf::Vector2f(x, y + h), color));
+}
+
+
+template<int m, int n>
+void drawMaze(const Maze<m, n>& maze,
+              sf::RenderTarget& target,
+              float cellSize,
+              float lineThickness,
+              sf::Color lineColor)
+{
+    MazeMesh<m, n> mesh;
+    mesh.draw(maze, target, cellSize, lineThickness, lineColor);
+}
+
+#endif // MAZEDRAW_HPP
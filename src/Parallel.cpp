@@ -0,0 +1,126 @@
+#include "Parallel.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace
+{
+
+struct Slice
+{
+    std::mutex lock;
+    long begin = 0;
+    long end = 0;
+};
+
+
+// Takes up to grain items from the front of a slice
+bool take(Slice& slice, long grain, long& begin, long& end)
+{
+    std::lock_guard<std::mutex> guard(slice.lock);
+    if (slice.begin >= slice.end)
+        return false;
+
+    begin = slice.begin;
+    end = std::min(slice.end, begin + grain);
+    slice.begin = end;
+    return true;
+}
+
+
+// Moves the back half of the largest other slice into the worker's own
+bool steal(std::vector<std::unique_ptr<Slice>>& slices, int worker)
+{
+    for (;;)
+    {
+        int victim = -1;
+        long most = 0;
+        for (int v = 0; v < int(slices.size()); ++v)
+        {
+            // The sizes may change before the steal; they only pick a victim
+            std::lock_guard<std::mutex> guard(slices[v]->lock);
+            long left = slices[v]->end - slices[v]->begin;
+            if (v != worker && left > most)
+            {
+                victim = v;
+                most = left;
+            }
+        }
+
+        if (victim < 0)
+            return false;
+
+        long begin;
+        long end;
+        {
+            std::lock_guard<std::mutex> guard(slices[victim]->lock);
+            if (slices[victim]->begin >= slices[victim]->end)
+                continue; // Emptied in the meantime; look again
+
+            end = slices[victim]->end;
+            begin = slices[victim]->begin + (end - slices[victim]->begin) / 2;
+            slices[victim]->end = begin;
+        }
+
+        std::lock_guard<std::mutex> guard(slices[worker]->lock);
+        slices[worker]->begin = begin;
+        slices[worker]->end = end;
+        return true;
+    }
+}
+
+}
+
+
+int defaultThreads()
+{
+    int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+
+void parallelFor(long count, int threads,
+                 const std::function<void(int worker, long index)>& body,
+                 long grain)
+{
+    if (threads <= 0)
+        threads = defaultThreads();
+    if (grain < 1)
+        grain = 1;
+
+    std::vector<std::unique_ptr<Slice>> slices;
+    for (int t = 0; t < threads; ++t)
+    {
+        slices.emplace_back(new Slice);
+        slices[t]->begin = count * t / threads;
+        slices[t]->end = count * (t + 1) / threads;
+    }
+
+    auto work = [&](int worker) {
+        long begin;
+        long end;
+        for (;;)
+        {
+            while (take(*slices[worker], grain, begin, end))
+            {
+                for (long k = begin; k < end; ++k)
+                    body(worker, k);
+            }
+
+            // Slices only ever shrink, so once every one is empty there is
+            // nothing left to steal
+            if (!steal(slices, worker))
+                return;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t)
+        pool.emplace_back(work, t);
+    work(0);
+    for (auto& thread : pool)
+        thread.join();
+}
@@ -0,0 +1,27 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+
+
+/* Runs body(worker, index) for every index in [0, count) on a number of
+ * threads, with work stealing to keep them all busy when some items take
+ * much longer than others.
+ *
+ * Every worker starts with an equal slice of the indices and takes grain of
+ * them at a time from the front of its own slice. A worker whose slice is
+ * empty steals the back half of the largest remaining slice, so items stay
+ * in runs of neighbouring indices and the locks are rarely contended.
+ *
+ * worker is in [0, threads) and is the same for all the items run by one
+ * thread, so it can index per-thread state. The calling thread is worker 0.
+ * threads <= 0 uses one thread per core.
+ */
+void parallelFor(long count, int threads,
+                 const std::function<void(int worker, long index)>& body,
+                 long grain = 1);
+
+// Number of threads parallelFor uses for threads <= 0
+int defaultThreads();
+
+#endif // PARALLEL_HPP
@@ -0,0 +1,219 @@
+#ifndef PATHCACHE_HPP
+#define PATHCACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+
+
+/* Distance and next-hop tables for answering many path queries on a maze
+ * without searching.
+ *
+ * There is one row per goal cell, filled by a single BFS from the goal: for
+ * every cell it holds the distance to the goal and the direction of the next
+ * step towards it. A path query is then a walk along the next hops.
+ *
+ * The tables belong to the maze with the hash they were built for. Every
+ * query checks Maze::hash(), which is cached by the maze and recomputed only
+ * after setCellWalls, fill, clear, randomize or load, and drops all rows if
+ * the walls changed.
+ *
+ * By default every row is built on the first query after a change when the
+ * maze has at most 256 cells (a 256x256 table for 16x16). Larger mazes fill
+ * rows lazily, one per goal as it is first asked for, and keep at most
+ * maxRows of them, evicting the oldest.
+ */
+template<int m, int n>
+class PathCache
+{
+public:
+    static const int unreachable = m * n;
+
+    explicit PathCache(int maxRows = m * n <= 256 ? m * n : 64,
+                       bool eager = m * n <= 256);
+
+    bool path(const Maze<m, n>& maze, Node start, Node goal, NodeStack<m, n>& path);
+    int distance(const Maze<m, n>& maze, Node start, Node goal);
+
+    // Number of rows built since the cache was created
+    long rowsBuilt() const { return built; }
+
+private:
+    typedef typename PackedType<bitsFor(m * n + 1)>::type Distance;
+
+    struct Row
+    {
+        Distance dist[m * n];
+        unsigned char next[(m * n + 3) / 4]; // 2-bit wall direction per cell
+    };
+
+    void sync(const Maze<m, n>& maze);
+    const Row& row(const Maze<m, n>& maze, Node goal);
+    void build(const Maze<m, n>& maze, Node goal, Row& row);
+
+    int maxRows;
+    bool eager;
+    std::uint64_t key = 0;
+    bool valid = false;
+    long built = 0;
+
+    std::vector<std::unique_ptr<Row>> rows; // Indexed by goal cell
+    std::vector<int> filled;                // Goal cells in the order built
+    std::vector<std::unique_ptr<Row>> spare;
+};
+
+
+template<int m, int n>
+PathCache<m, n>::PathCache(int maxRows, bool eager)
+    : maxRows(maxRows < 1 ? 1 : maxRows),
+      eager(eager && maxRows >= m * n),
+      rows(m * n)
+{
+}
+
+
+template<int m, int n>
+bool PathCache<m, n>::path(const Maze<m, n>& maze, Node start, Node goal, NodeStack<m, n>& path)
+{
+    path.clear();
+
+    const Row& r = row(maze, goal);
+    if (r.dist[start.i + start.j * m] == unreachable)
+        return false;
+
+    NodeStack<m, n> walk;
+    Node v = start;
+    walk.push(v);
+
+    while (v != goal)
+    {
+        int c = v.i + v.j * m;
+        int wall = (r.next[c / 4] >> (2 * (c % 4))) & 0x3;
+        if (0 == wall)
+            ++v.i;
+        else if (1 == wall)
+            ++v.j;
+        else if (2 == wall)
+            --v.i;
+        else
+            --v.j;
+        walk.push(v);
+    }
+
+    while (!walk.empty())
+        path.push(walk.pop());
+
+    return true;
+}
+
+
+template<int m, int n>
+int PathCache<m, n>::distance(const Maze<m, n>& maze, Node start, Node goal)
+{
+    int d = row(maze, goal).dist[start.i + start.j * m];
+    return d == unreachable ? -1 : d;
+}
+
+
+template<int m, int n>
+void PathCache<m, n>::sync(const Maze<m, n>& maze)
+{
+    if (valid && maze.hash() == key)
+        return;
+
+    for (int goal : filled)
+        spare.push_back(std::move(rows[goal]));
+    filled.clear();
+
+    key = maze.hash();
+    valid = true;
+
+    if (eager)
+    {
+        for (int c = 0; c < m * n; ++c)
+            row(maze, {c % m, c / m});
+    }
+}
+
+
+template<int m, int n>
+const typename PathCache<m, n>::Row& PathCache<m, n>::row(const Maze<m, n>& maze, Node goal)
+{
+    sync(maze);
+
+    int g = goal.i + goal.j * m;
+    if (rows[g])
+        return *rows[g];
+
+    if (int(filled.size()) >= maxRows)
+    {
+        spare.push_back(std::move(rows[filled.front()]));
+        filled.erase(filled.begin());
+    }
+
+    if (spare.empty())
+        rows[g].reset(new Row);
+    else
+    {
+        rows[g] = std::move(spare.back());
+        spare.pop_back();
+    }
+
+    build(maze, goal, *rows[g]);
+    filled.push_back(g);
+    return *rows[g];
+}
+
+
+// BFS outwards from the goal; each cell's next hop points back at the cell
+// it was reached from
+template<int m, int n>
+void PathCache<m, n>::build(const Maze<m, n>& maze, Node goal, Row& row)
+{
+    for (int c = 0; c < m * n; ++c)
+        row.dist[c] = unreachable;
+
+    NodeQueue<m, n> q;
+    row.dist[goal.i + goal.j * m] = 0;
+    q.push(goal);
+
+    while (!q.empty())
+    {
+        Node v = q.pop();
+        int d = row.dist[v.i + v.j * m] + 1;
+        auto cw = maze.getCellWalls(v.i, v.j);
+
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (cw[wall])
+                continue;
+
+            Node u = v;
+            if (0 == wall)
+                ++u.i;
+            else if (1 == wall)
+                ++u.j;
+            else if (2 == wall)
+                --u.i;
+            else
+                --u.j;
+
+            int c = u.i + u.j * m;
+            if (row.dist[c] != unreachable)
+                continue;
+
+            // The step back from u to v goes the opposite way
+            int back = (wall + 2) % 4;
+            row.dist[c] = d;
+            row.next[c / 4] = (row.next[c / 4] & ~(0x3 << (2 * (c % 4)))) | back << (2 * (c % 4));
+            q.push(u);
+        }
+    }
+
+    ++built;
+}
+
+#endif // PATHCACHE_HPP
@@ -0,0 +1,48 @@
+#ifndef PATHSCORE_HPP
+#define PATHSCORE_HPP
+
+#include "BFS.hpp"
+
+
+/* Estimates the cost of running a path: a step that continues along the
+ * same axis as the previous one costs 0.5 and a step that turns costs 1.0.
+ * An empty path (no route found) scores 129.
+ */
+template<int m, int n>
+float ScorePath(NodeStack<m, n> Path)
+{
+    bool orient = 0;
+    bool turn = 0;
+
+    float Score = 0;
+
+    if(Path.size() == 0)
+    {
+        Score = 129;
+        return Score;
+    }
+
+    Node current = Path.pop();
+
+    while(Path.size() != 0)
+    {
+        Node next = Path.pop();
+
+        if(current.i == next.i)
+            {turn = 0;}
+        if(current.j == next.j)
+            {turn = 1;}
+
+        if(orient != turn)
+            {Score = Score+1;}
+        if(orient == turn)
+            {Score = Score+0.5;}
+
+        orient = turn;
+        current = next;
+    }
+
+    return Score;
+}
+
+#endif // PATHSCORE_HPP
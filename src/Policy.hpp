@@ -0,0 +1,201 @@
+#ifndef POLICY_HPP
+#define POLICY_HPP
+
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "FloodFill.hpp"
+
+
+/* Exploration policies decide where the mouse goes during a mapping run.
+ *
+ * A policy is a template parameter of Explorer (and of Simulator and
+ * FarmWorkspace), so the planning calls are resolved at compile time. It
+ * provides, for the wall layouts of the explorers it is used with:
+ *
+ *     void begin(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target)
+ *         a new run starts at s.start; plan the first path
+ *     void sensed(const MappingState<m, n, Storage>& s)
+ *         the walls of s.current were just sensed and the cell marked visited
+ *     bool done(const MappingState<m, n, Storage>& s)
+ *         termination rule: stop mapping here
+ *     bool next(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target)
+ *         plan the path from s.current to the next target. Returns false,
+ *         which also ends the run, if there is nowhere left to go.
+ *
+ * Paths are from s.current (on top) to the target, as bfs() returns them.
+ * The three policies below all stop once the route is proven (see
+ * routeProven()); they differ in where they go until then.
+ */
+template<int m, int n, class Storage = PlaneWalls<m, n>>
+struct MappingState
+{
+    const Maze<m, n, Storage>& discovered; // Walls sensed so far; unknown walls are open
+    const BitArray2D<m, n>& unvisited;     // Cells neither visited nor inferred
+    const FloodFill<m, n>& flood;          // Distances to the goal in the discovered maze
+    const NodeStack<m, n>& route;          // Best known route from start to goal
+    int bestCase;                          // Its length: a lower bound of the true distance
+    int worstCase;                         // Shortest length through known-open walls
+    Node start;
+    Node goal;
+    Node current;
+    SearchStats& stats;                    // Where policies count their expansions
+};
+
+
+// True once a path through known-open walls is as short as the best route
+// with unknown walls open, so no unexplored part of the maze can give a
+// shorter one. This holds at the latest when every cell on the best route
+// has been visited, and often well before.
+template<int m, int n, class Storage>
+bool routeProven(const MappingState<m, n, Storage>& s)
+{
+    return s.worstCase <= s.bestCase;
+}
+
+
+/* Goes to the nearest unvisited cell that lies on the best known route.
+ * Only the cells that could still change the route are explored, so this
+ * maps the least of the maze. The default policy.
+ */
+template<int m, int n>
+class CandidateFirst
+{
+public:
+    template<class Storage>
+    void begin(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target);
+    template<class Storage>
+    void sensed(const MappingState<m, n, Storage>&) {}
+    template<class Storage>
+    bool done(const MappingState<m, n, Storage>& s) { return routeProven(s); }
+    template<class Storage>
+    bool next(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target);
+
+private:
+    SearchWorkspace<m, n> search;
+    BitArray2D<m, n> candidates;
+};
+
+
+/* Goes to the nearest unvisited cell anywhere in the maze, which sweeps the
+ * maze outwards from wherever the mouse is.
+ */
+template<int m, int n>
+class NearestUnvisited
+{
+public:
+    template<class Storage>
+    void begin(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target)
+    {
+        next(s, path, target);
+    }
+    template<class Storage>
+    void sensed(const MappingState<m, n, Storage>&) {}
+    template<class Storage>
+    bool done(const MappingState<m, n, Storage>& s) { return routeProven(s); }
+    template<class Storage>
+    bool next(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target);
+
+private:
+    SearchWorkspace<m, n> search;
+};
+
+
+/* The classic flood-fill mouse: runs to the goal along the flood field,
+ * then back to the start along the shortest known path, and again, until
+ * the route is known.
+ */
+template<int m, int n>
+class FloodFillToCenter
+{
+public:
+    template<class Storage>
+    void begin(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target)
+    {
+        outbound = true;
+        next(s, path, target);
+    }
+    template<class Storage>
+    void sensed(const MappingState<m, n, Storage>&) {}
+    template<class Storage>
+    bool done(const MappingState<m, n, Storage>& s) { return routeProven(s); }
+    template<class Storage>
+    bool next(const MappingState<m, n, Storage>& s, NodeStack<m, n>& path, Node& target);
+
+private:
+    bool outbound = true;
+    SearchWorkspace<m, n> search;
+    BitArray2D<m, n> home;
+};
+
+
+template<int m, int n>
+template<class Storage>
+void CandidateFirst<m, n>::begin(const MappingState<m, n, Storage>& s,
+                                 NodeStack<m, n>& path,
+                                 Node& target)
+{
+    // Nothing is known yet, so take the first step to any neighbour
+    search.search(s.discovered, s.current, s.unvisited, &s.stats);
+    search.path(search.found(), path);
+    target = s.current;
+}
+
+
+template<int m, int n>
+template<class Storage>
+bool CandidateFirst<m, n>::next(const MappingState<m, n, Storage>& s,
+                                NodeStack<m, n>& path,
+                                Node& target)
+{
+    candidates.setAll(false);
+    for (int k = 0; k < s.route.size(); ++k)
+    {
+        Node v = s.route[k];
+        if (s.unvisited.get(v.i, v.j))
+            candidates.set(v.i, v.j, true);
+    }
+
+    if (search.search(s.discovered, s.current, candidates, &s.stats))
+        target = search.found();
+    return search.path(search.found(), path);
+}
+
+
+template<int m, int n>
+template<class Storage>
+bool NearestUnvisited<m, n>::next(const MappingState<m, n, Storage>& s,
+                                  NodeStack<m, n>& path,
+                                  Node& target)
+{
+    if (search.search(s.discovered, s.current, s.unvisited, &s.stats))
+        target = search.found();
+    return search.path(search.found(), path);
+}
+
+
+template<int m, int n>
+template<class Storage>
+bool FloodFillToCenter<m, n>::next(const MappingState<m, n, Storage>& s,
+                                   NodeStack<m, n>& path,
+                                   Node& target)
+{
+    if (s.current == s.goal)
+        outbound = false;
+    else if (s.current == s.start)
+        outbound = true;
+
+    if (outbound)
+    {
+        target = s.goal;
+        return s.flood.path(s.discovered, s.current, path) && path.size() > 1;
+    }
+
+    target = s.start;
+    home.setAll(false);
+    home.set(s.start.i, s.start.j, true);
+    search.search(s.discovered, s.current, home, &s.stats);
+    return search.path(search.found(), path) && path.size() > 1;
+}
+
+#endif // POLICY_HPP
@@ -0,0 +1,88 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <cstdint>
+
+
+/* Small, fast and reproducible random number generator (xoshiro256**).
+ *
+ * The same seed gives the same sequence on every platform, unlike std::rand.
+ * A generator can also be seeded with a (seed, stream) pair so that work split
+ * between threads draws from independent sequences that do not depend on how
+ * the work was split, e.g. one stream per maze index.
+ */
+class Rng
+{
+public:
+    explicit Rng(std::uint64_t seed = 0, std::uint64_t stream = 0)
+    {
+        reseed(seed, stream);
+    }
+
+    void reseed(std::uint64_t seed, std::uint64_t stream = 0)
+    {
+        std::uint64_t x = seed;
+        std::uint64_t y = stream;
+        std::uint64_t mixed = splitMix(x) ^ splitMix(y);
+        for (int k = 0; k < 4; ++k)
+            s[k] = splitMix(mixed);
+    }
+
+    std::uint64_t next()
+    {
+        std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        std::uint64_t t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+
+        return result;
+    }
+
+    // Uniform integer in [0, bound), bound > 0, without modulo bias
+    std::uint32_t below(std::uint32_t bound)
+    {
+        // Multiply-shift with a rejection step (Lemire's method)
+        std::uint64_t product = (next() >> 32) * bound;
+        std::uint32_t low = std::uint32_t(product);
+
+        if (low < bound)
+        {
+            std::uint32_t threshold = -bound % bound;
+            while (low < threshold)
+            {
+                product = (next() >> 32) * bound;
+                low = std::uint32_t(product);
+            }
+        }
+
+        return std::uint32_t(product >> 32);
+    }
+
+    bool coin()
+    {
+        return next() >> 63;
+    }
+
+private:
+    static std::uint64_t rotl(std::uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    static std::uint64_t splitMix(std::uint64_t& x)
+    {
+        std::uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t s[4];
+};
+
+#endif // RANDOM_HPP
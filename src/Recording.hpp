@@ -0,0 +1,443 @@
+#ifndef RECORDING_HPP
+#define RECORDING_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+
+
+/* Recording of a simulated run, step by step, that can be saved and played
+ * back later without simulating the run again.
+ *
+ * Every step records where the mouse went, the target it was heading for,
+ * the length of the path the planner returned, and what changed in the map
+ * of the mouse: its optimistic and pessimistic view of the walls (see
+ * WallMap) and its unvisited and inferred cells. The map is kept as mapBytes
+ * bytes and each step as the bytes that changed, as XOR masks, so a sensed
+ * cell typically costs a few bytes and a delta undoes itself when applied
+ * again. Every keyframeInterval steps the whole map is kept as a keyframe,
+ * so seek() reaches any step by loading the keyframe before it and applying
+ * at most keyframeInterval steps of deltas, however long the run, and plays
+ * backward as cheaply as forward.
+ *
+ * The true maze, start, goal and the seed and stream of the maze generator
+ * are recorded with the run, so a run can be reproduced as well as replayed.
+ *
+ * Step 0 is the state after the run began; step k the state after k steps.
+ * Recording always appends to the last step, wherever the replay was.
+ *
+ * File format, all integers little endian whatever the host's byte order:
+ *     header     "MZR2", rows, cols, keyframe interval, mapping run (0 or
+ *                1) (uint32 each), seed, stream (uint64 each), start i, j,
+ *                goal i, j (uint16 each), steps, deltas (uint32 each)
+ *     maze       the true maze, Maze::byteCount bytes
+ *     steps      steps + 1 records of position i, j, target i, j (uint16
+ *                each) and path length (uint32)
+ *     deltas     for each step, its number of deltas (uint32), then deltas
+ *                of byte offset in the map (uint16) and XOR mask (uint8)
+ *     keyframes  steps / keyframe interval + 1 maps of mapBytes each
+ */
+template<int m, int n>
+class RunRecording
+{
+public:
+    static const int cellBytes = (m * n + 7) / 8;
+    static const int mapBytes = 2 * Maze<m, n>::byteCount + 2 * cellBytes;
+
+    static_assert(mapBytes <= 65536, "map offsets must fit in 16 bits");
+
+    explicit RunRecording(int keyframeInterval = 64);
+
+    // Recorded with the runs begun from now on
+    void setSeed(std::uint64_t seed, std::uint64_t stream = 0);
+
+    // Starts a new recording with the state of the explorer after it began
+    // a run on the maze, which may be a Maze or a MazeView
+    template<class MazeT, class ExplorerT>
+    void begin(const MazeT& maze, Node start, Node goal, bool mapping, const ExplorerT& explorer);
+
+    // Appends the state of the explorer after one more step
+    template<class ExplorerT>
+    void record(const ExplorerT& explorer);
+
+    bool save(std::ostream& out) const;
+
+    // Returns false, leaving an empty recording, if the stream does not hold
+    // a recording of an m x n maze. Shows step 0 otherwise.
+    bool load(std::istream& in);
+
+    // Shows the state after the given step. Returns false, leaving the
+    // replay where it was, if there is no such step.
+    bool seek(int step);
+
+    int steps() const { return int(frames.size()) - 1; }
+    int step() const { return shown; }
+
+    bool mapping() const { return mappingRun; }
+    std::uint64_t seed() const { return mazeSeed; }
+    std::uint64_t stream() const { return mazeStream; }
+    Node start() const { return from; }
+    Node goal() const { return to; }
+    const Maze<m, n>& maze() const { return truth; }
+
+    // The state at step()
+    Node position() const { return frames[shown].position; }
+    Node target() const { return frames[shown].target; }
+    int pathLength() const { return frames[shown].pathLength; }
+    const Maze<m, n>& discovered() const { return optimistic; }
+    const Maze<m, n>& pessimistic() const { return closed; }
+    const BitArray2D<m, n>& unvisited() const { return unvisitedCells; }
+    const BitArray2D<m, n>& inferred() const { return inferredCells; }
+
+    // Bytes used by the steps, deltas and keyframes
+    std::size_t memory() const;
+
+private:
+    struct Frame
+    {
+        Node position;
+        Node target;
+        int pathLength;
+        std::uint32_t firstDelta; // Index of the first delta of this step
+    };
+
+    struct Delta
+    {
+        std::uint16_t offset;
+        std::uint8_t bits;
+    };
+
+    // One past the last delta of a step
+    std::size_t end(int step) const
+    {
+        return step + 1 < int(frames.size()) ? frames[step + 1].firstDelta : deltas.size();
+    }
+
+    template<class ExplorerT>
+    void pack(const ExplorerT& explorer, unsigned char* bytes) const;
+    void unpack();
+
+    // Unsigned integers, little endian
+    template<class T>
+    static void put(std::ostream& out, T value)
+    {
+        unsigned char bytes[sizeof(T)];
+        for (std::size_t b = 0; b < sizeof(T); ++b)
+            bytes[b] = (unsigned char)(std::uint64_t(value) >> (8 * b));
+        out.write(reinterpret_cast<const char*>(bytes), sizeof(T));
+    }
+
+    template<class T>
+    static bool get(std::istream& in, T& value)
+    {
+        unsigned char bytes[sizeof(T)];
+        if (!in.read(reinterpret_cast<char*>(bytes), sizeof(T)))
+            return false;
+        std::uint64_t v = 0;
+        for (std::size_t b = 0; b < sizeof(T); ++b)
+            v |= std::uint64_t(bytes[b]) << (8 * b);
+        value = T(v);
+        return true;
+    }
+
+    int interval;
+    std::uint64_t mazeSeed = 0;
+    std::uint64_t mazeStream = 0;
+    bool mappingRun = false;
+    Node from = {0, 0};
+    Node to = {0, 0};
+    Maze<m, n> truth;
+
+    std::vector<Frame> frames;
+    std::vector<Delta> deltas;
+    std::vector<unsigned char> keyframes; // mapBytes per keyframe
+
+    // The map at step shown, as bytes and unpacked
+    int shown = 0;
+    std::vector<unsigned char> view;
+    std::vector<unsigned char> scratch;
+    Maze<m, n> optimistic;
+    Maze<m, n> closed;
+    BitArray2D<m, n> unvisitedCells;
+    BitArray2D<m, n> inferredCells;
+};
+
+
+template<int m, int n>
+RunRecording<m, n>::RunRecording(int keyframeInterval)
+    : interval(keyframeInterval > 0 ? keyframeInterval : 1),
+      view(mapBytes),
+      scratch(mapBytes)
+{
+    frames.push_back(Frame{from, from, 0, 0});
+    keyframes.assign(view.begin(), view.end());
+}
+
+
+template<int m, int n>
+void RunRecording<m, n>::setSeed(std::uint64_t seed, std::uint64_t stream)
+{
+    mazeSeed = seed;
+    mazeStream = stream;
+}
+
+
+template<int m, int n>
+template<class MazeT, class ExplorerT>
+void RunRecording<m, n>::begin(const MazeT& maze, Node start, Node goal, bool mapping,
+                               const ExplorerT& explorer)
+{
+    maze.saveBytes(view.data());
+    truth.loadBytes(view.data());
+    from = start;
+    to = goal;
+    mappingRun = mapping;
+
+    frames.clear();
+    deltas.clear();
+    keyframes.clear();
+    shown = 0;
+
+    pack(explorer, view.data());
+    keyframes.insert(keyframes.end(), view.begin(), view.end());
+    frames.push_back(Frame{explorer.position(), explorer.target(), explorer.path().size(), 0});
+    unpack();
+}
+
+
+template<int m, int n>
+template<class ExplorerT>
+void RunRecording<m, n>::record(const ExplorerT& explorer)
+{
+    seek(steps());
+
+    // Only the bytes that changed are kept
+    std::uint32_t first = std::uint32_t(deltas.size());
+    pack(explorer, scratch.data());
+    for (int k = 0; k < mapBytes; ++k)
+    {
+        if (scratch[k] != view[k])
+        {
+            deltas.push_back(Delta{std::uint16_t(k), std::uint8_t(scratch[k] ^ view[k])});
+            view[k] = scratch[k];
+        }
+    }
+
+    frames.push_back(Frame{explorer.position(), explorer.target(), explorer.path().size(), first});
+    if (steps() % interval == 0)
+        keyframes.insert(keyframes.end(), view.begin(), view.end());
+
+    ++shown;
+    if (first < deltas.size())
+        unpack();
+}
+
+
+template<int m, int n>
+bool RunRecording<m, n>::seek(int step)
+{
+    if (step < 0 || step > steps())
+        return false;
+
+    // Either apply the deltas between the two steps, or load the keyframe
+    // before the step and apply the rest, whichever touches fewer bytes
+    int lo = step < shown ? step : shown;
+    int hi = step < shown ? shown : step;
+    std::size_t stepping = end(hi) - end(lo);
+
+    int key = step / interval * interval;
+    std::size_t loading = mapBytes / sizeof(Delta) + end(step) - end(key);
+
+    if (loading < stepping)
+    {
+        std::memcpy(view.data(), keyframes.data() + std::size_t(key / interval) * mapBytes, mapBytes);
+        lo = key;
+        hi = step;
+    }
+
+    for (std::size_t k = end(lo); k < end(hi); ++k)
+        view[deltas[k].offset] ^= deltas[k].bits;
+
+    shown = step;
+    unpack();
+    return true;
+}
+
+
+template<int m, int n>
+std::size_t RunRecording<m, n>::memory() const
+{
+    return frames.capacity() * sizeof(Frame) + deltas.capacity() * sizeof(Delta) +
+           keyframes.capacity();
+}
+
+
+template<int m, int n>
+template<class ExplorerT>
+void RunRecording<m, n>::pack(const ExplorerT& explorer, unsigned char* bytes) const
+{
+    explorer.walls().optimistic().saveBytes(bytes);
+    bytes += Maze<m, n>::byteCount;
+    explorer.walls().pessimistic().saveBytes(bytes);
+    bytes += Maze<m, n>::byteCount;
+
+    for (int k = 0; k < cellBytes; ++k)
+    {
+        bytes[k] = explorer.unvisited()[k];
+        bytes[cellBytes + k] = explorer.inferred()[k];
+    }
+}
+
+
+template<int m, int n>
+void RunRecording<m, n>::unpack()
+{
+    const unsigned char* bytes = view.data();
+    optimistic.loadBytes(bytes);
+    bytes += Maze<m, n>::byteCount;
+    closed.loadBytes(bytes);
+    bytes += Maze<m, n>::byteCount;
+
+    for (int k = 0; k < cellBytes; ++k)
+    {
+        unvisitedCells[k] = bytes[k];
+        inferredCells[k] = bytes[cellBytes + k];
+    }
+}
+
+
+template<int m, int n>
+bool RunRecording<m, n>::save(std::ostream& out) const
+{
+    out.write("MZR2", 4);
+    put(out, std::uint32_t(m));
+    put(out, std::uint32_t(n));
+    put(out, std::uint32_t(interval));
+    put(out, std::uint32_t(mappingRun));
+    put(out, mazeSeed);
+    put(out, mazeStream);
+    put(out, std::uint16_t(from.i));
+    put(out, std::uint16_t(from.j));
+    put(out, std::uint16_t(to.i));
+    put(out, std::uint16_t(to.j));
+    put(out, std::uint32_t(steps()));
+    put(out, std::uint32_t(deltas.size()));
+
+    unsigned char bytes[Maze<m, n>::byteCount];
+    truth.saveBytes(bytes);
+    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+
+    for (const Frame& f : frames)
+    {
+        put(out, std::uint16_t(f.position.i));
+        put(out, std::uint16_t(f.position.j));
+        put(out, std::uint16_t(f.target.i));
+        put(out, std::uint16_t(f.target.j));
+        put(out, std::uint32_t(f.pathLength));
+    }
+
+    for (int s = 0; s <= steps(); ++s)
+    {
+        put(out, std::uint32_t(end(s) - frames[s].firstDelta));
+        for (std::size_t k = frames[s].firstDelta; k < end(s); ++k)
+        {
+            put(out, deltas[k].offset);
+            put(out, deltas[k].bits);
+        }
+    }
+
+    out.write(reinterpret_cast<const char*>(keyframes.data()), keyframes.size());
+    return bool(out);
+}
+
+
+template<int m, int n>
+bool RunRecording<m, n>::load(std::istream& in)
+{
+    char magic[4];
+    std::uint32_t rows, cols, keyInterval, mapping, stepCount, deltaCount;
+    std::uint64_t seed, stream;
+    std::uint16_t si, sj, gi, gj;
+
+    frames.assign(1, Frame{Node{0, 0}, Node{0, 0}, 0, 0});
+    deltas.clear();
+    keyframes.assign(mapBytes, 0);
+    view.assign(mapBytes, 0);
+    shown = 0;
+    unpack();
+
+    if (!in.read(magic, 4) || std::memcmp(magic, "MZR2", 4) != 0 ||
+        !get(in, rows) || !get(in, cols) || !get(in, keyInterval) || !get(in, mapping) ||
+        !get(in, seed) || !get(in, stream) ||
+        !get(in, si) || !get(in, sj) || !get(in, gi) || !get(in, gj) ||
+        !get(in, stepCount) || !get(in, deltaCount) ||
+        rows != std::uint32_t(m) || cols != std::uint32_t(n) || keyInterval == 0)
+        return false;
+
+    unsigned char bytes[Maze<m, n>::byteCount];
+    if (!in.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+        return false;
+
+    // The frames grow as they are read, so a corrupt step count fails at
+    // the end of the file instead of allocating for it
+    std::vector<Frame> readFrames;
+    for (std::uint32_t s = 0; s <= stepCount; ++s)
+    {
+        std::uint16_t pi, pj, ti, tj;
+        std::uint32_t length;
+        if (!get(in, pi) || !get(in, pj) || !get(in, ti) || !get(in, tj) || !get(in, length))
+            return false;
+        readFrames.push_back(Frame{Node{pi, pj}, Node{ti, tj}, int(length), 0});
+    }
+
+    std::vector<Delta> readDeltas;
+    for (Frame& f : readFrames)
+    {
+        std::uint32_t count;
+        if (!get(in, count) || count > deltaCount - readDeltas.size())
+            return false;
+
+        f.firstDelta = std::uint32_t(readDeltas.size());
+        for (std::uint32_t k = 0; k < count; ++k)
+        {
+            Delta d;
+            if (!get(in, d.offset) || !get(in, d.bits) || d.offset >= mapBytes)
+                return false;
+            readDeltas.push_back(d);
+        }
+    }
+
+    if (readDeltas.size() != deltaCount)
+        return false;
+
+    // Likewise the keyframes, which can be far larger than the steps
+    std::vector<unsigned char> readKeyframes;
+    for (std::uint32_t k = 0; k <= stepCount / keyInterval; ++k)
+    {
+        readKeyframes.resize(readKeyframes.size() + mapBytes);
+        if (!in.read(reinterpret_cast<char*>(&readKeyframes[readKeyframes.size() - mapBytes]), mapBytes))
+            return false;
+    }
+
+    truth.loadBytes(bytes);
+    interval = int(keyInterval);
+    mazeSeed = seed;
+    mazeStream = stream;
+    mappingRun = mapping != 0;
+    from = Node{si, sj};
+    to = Node{gi, gj};
+    frames.swap(readFrames);
+    deltas.swap(readDeltas);
+    keyframes.swap(readKeyframes);
+
+    std::memcpy(view.data(), keyframes.data(), mapBytes);
+    unpack();
+    return true;
+}
+
+#endif // RECORDING_HPP
@@ -0,0 +1,61 @@
+#include "ResultCache.hpp"
+#include <cstdio>
+
+
+bool ResultCache::open(const std::string& path)
+{
+    close();
+
+    std::ifstream in(path);
+    std::string line;
+    while (in && std::getline(in, line))
+    {
+        // The key, a space, the tag, a space and the value
+        std::size_t tagEnd = line.find(' ', 33);
+        if (line.size() < 34 || line[32] != ' ' || tagEnd == std::string::npos ||
+            line.find_first_not_of("0123456789abcdef") < 32)
+            continue;
+        entries[line.substr(0, tagEnd)] = line.substr(tagEnd + 1);
+    }
+
+    file.open(path, std::ios::app);
+    if (!file)
+    {
+        message = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+
+void ResultCache::close()
+{
+    if (file.is_open())
+        file.close();
+    entries.clear();
+}
+
+
+const std::string* ResultCache::find(const MazeKey& key, const std::string& tag) const
+{
+    auto it = entries.find(entryName(key, tag));
+    return it == entries.end() ? nullptr : &it->second;
+}
+
+
+bool ResultCache::insert(const MazeKey& key, const std::string& tag, const std::string& value)
+{
+    std::string name = entryName(key, tag);
+    entries[name] = value;
+    file << name << ' ' << value << '\n';
+    return bool(file);
+}
+
+
+std::string ResultCache::entryName(const MazeKey& key, const std::string& tag)
+{
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx",
+                  (unsigned long long)key.hi, (unsigned long long)key.lo);
+    return std::string(hex) + ' ' + tag;
+}
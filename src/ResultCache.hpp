@@ -0,0 +1,57 @@
+#ifndef RESULTCACHE_HPP
+#define RESULTCACHE_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include "Symmetry.hpp"
+
+
+/* Persistent cache of results, keyed by the canonical form of the maze and
+ * its start and goal (see Symmetry.hpp), so that a maze is solved or
+ * simulated once however often it, or one of its rotations or mirrors, is
+ * loaded again.
+ *
+ * The file is text, one entry per line:
+ *     <key as 32 hex digits> <tag> <value>
+ * The tag names what was computed and how (the engine, the policy, the
+ * options that change the result), so one file can serve several tools; it
+ * has no spaces. The value is whatever the tool stores, in the canonical
+ * frame, without line breaks. Entries are appended to the file as they are
+ * inserted, so successive runs build up one cache. A later entry for the
+ * same key and tag replaces an earlier one; malformed lines are skipped.
+ *
+ * Lookups may run on several threads at once, insertions may not.
+ */
+class ResultCache
+{
+public:
+    ResultCache() {}
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Loads the entries of the file, creating it if it does not exist.
+    // Returns false and sets error() if it cannot be read or written.
+    bool open(const std::string& path);
+    void close();
+
+    // The value stored for key and tag, or null
+    const std::string* find(const MazeKey& key, const std::string& tag) const;
+
+    // Returns false if the entry could not be written to the file
+    bool insert(const MazeKey& key, const std::string& tag, const std::string& value);
+
+    std::size_t size() const { return entries.size(); }
+    const std::string& error() const { return message; }
+
+private:
+    static std::string entryName(const MazeKey& key, const std::string& tag);
+
+    std::unordered_map<std::string, std::string> entries;
+    std::ofstream file;
+    std::string message;
+};
+
+#endif // RESULTCACHE_HPP
@@ -0,0 +1,191 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP
+
+#include "Maze.hpp"
+#include "BFS.hpp"
+#include "Explorer.hpp"
+#include "Recording.hpp"
+
+
+/* A simulated mouse run on a maze, advanced either one step at a time or by
+ * elapsed time.
+ *
+ * The simulator owns the explorer and everything else about the run; the
+ * true maze is only referenced and must outlive the run. It does not read a
+ * clock itself: callers pass the time that has passed to advance(), which
+ * steps according to the run mode:
+ *     RealTime     one step every stepSeconds (0.5 s by default)
+ *     Scaled       speed times as many steps as RealTime
+ *     Unthrottled  the whole run at once, as fast as it can be computed
+ * step() and finish() ignore the mode, so headless tools can drive the run
+ * directly.
+ *
+ * MazeT may be Maze<m, n> or MazeView<m, n>. Policy is the exploration
+ * policy of mapping runs (see Policy.hpp). Runs can be recorded step by step
+ * into a RunRecording for replaying them later.
+ */
+enum class RunMode
+{
+    RealTime,
+    Scaled,
+    Unthrottled
+};
+
+
+template<int m, int n, class MazeT = Maze<m, n>, class Policy = CandidateFirst<m, n>>
+class Simulator
+{
+public:
+    enum class Run
+    {
+        None,
+        Search,
+        Mapping
+    };
+
+    explicit Simulator(double stepSeconds = 0.5) : stepSeconds(stepSeconds) {}
+
+    void startSearch(const MazeT& maze, Node start, Node goal);
+    void startMapping(const MazeT& maze, Node start, Node goal);
+    void stop() { kind = Run::None; }
+
+    // Takes one step. Returns false once the run is over.
+    bool step();
+
+    // Steps as many times as the mode allows for the time that passed.
+    // Returns the number of steps taken.
+    int advance(double seconds);
+
+    // Steps until the run is over or stepLimit() steps have been taken
+    int finish();
+
+    // Records every run started from now on, or none if recording is null.
+    // The recording must outlive the runs.
+    void setRecording(RunRecording<m, n>* recording) { recorder = recording; }
+
+    void setMode(RunMode mode, double speed = 1.0);
+    RunMode mode() const { return runMode; }
+    double speed() const { return runSpeed; }
+
+    // The last run started, which stays set after the run is over so its
+    // result can still be shown, until stop() is called
+    Run run() const { return kind; }
+    bool running() const { return kind != Run::None && explorer.running() && steps < stepLimit(); }
+
+    Node position() const { return explorer.position(); }
+    Node start() const { return from; }
+    Node goal() const { return to; }
+    int stepsTaken() const { return steps; }
+    static int stepLimit() { return 16 * m * n; }
+
+    const Explorer<m, n, Policy>& state() const { return explorer; }
+    Explorer<m, n, Policy>& state() { return explorer; }
+
+private:
+    Explorer<m, n, Policy> explorer;
+    const MazeT* maze = nullptr;
+    RunRecording<m, n>* recorder = nullptr;
+    Run kind = Run::None;
+    Node from;
+    Node to;
+    int steps = 0;
+
+    RunMode runMode = RunMode::RealTime;
+    double runSpeed = 1.0;
+    double stepSeconds;
+    double pending = 0.0; // Time passed that has not been stepped yet
+};
+
+
+template<int m, int n, class MazeT, class Policy>
+void Simulator<m, n, MazeT, Policy>::startSearch(const MazeT& maze, Node start, Node goal)
+{
+    this->maze = &maze;
+    kind = Run::Search;
+    from = start;
+    to = goal;
+    steps = 0;
+    pending = 0.0;
+    explorer.beginSearch(maze, start, goal);
+    if (recorder)
+        recorder->begin(maze, start, goal, false, explorer);
+}
+
+
+template<int m, int n, class MazeT, class Policy>
+void Simulator<m, n, MazeT, Policy>::startMapping(const MazeT& maze, Node start, Node goal)
+{
+    this->maze = &maze;
+    kind = Run::Mapping;
+    from = start;
+    to = goal;
+    steps = 0;
+    pending = 0.0;
+    explorer.beginMapping(maze, start, goal);
+    if (recorder)
+        recorder->begin(maze, start, goal, true, explorer);
+}
+
+
+template<int m, int n, class MazeT, class Policy>
+bool Simulator<m, n, MazeT, Policy>::step()
+{
+    if (!running())
+        return false;
+
+    ++steps;
+    explorer.step(*maze);
+    if (recorder)
+        recorder->record(explorer);
+    return running();
+}
+
+
+template<int m, int n, class MazeT, class Policy>
+int Simulator<m, n, MazeT, Policy>::advance(double seconds)
+{
+    if (!running())
+        return 0;
+
+    if (runMode == RunMode::Unthrottled)
+        return finish();
+
+    double interval = stepSeconds;
+    if (runMode == RunMode::Scaled)
+        interval /= runSpeed;
+
+    int taken = 0;
+    pending += seconds;
+    while (pending >= interval && running())
+    {
+        pending -= interval;
+        step();
+        ++taken;
+    }
+
+    return taken;
+}
+
+
+template<int m, int n, class MazeT, class Policy>
+int Simulator<m, n, MazeT, Policy>::finish()
+{
+    int taken = 0;
+    while (running())
+    {
+        step();
+        ++taken;
+    }
+    return taken;
+}
+
+
+template<int m, int n, class MazeT, class Policy>
+void Simulator<m, n, MazeT, Policy>::setMode(RunMode mode, double speed)
+{
+    runMode = mode;
+    runSpeed = speed > 0.0 ? speed : 1.0;
+    pending = 0.0;
+}
+
+#endif // SIMULATOR_HPP
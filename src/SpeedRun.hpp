@@ -0,0 +1,633 @@
+#ifndef SPEEDRUN_HPP
+#define SPEEDRUN_HPP
+
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "Trace.hpp"
+
+
+/* What the robot can do, for planning speed runs. Speeds are in m/s and
+ * the acceleration, which is also used for braking, in m/s^2. Turn speeds
+ * above maxSpeed are taken as maxSpeed.
+ */
+struct RobotParams
+{
+    float cellSize = 0.18f;    // Metres between cell centres
+    float maxSpeed = 3.0f;     // Top speed on straights and diagonals
+    float acceleration = 6.0f;
+    float turn45Speed = 1.2f;  // Turns into and out of a diagonal
+    float turn90Speed = 0.9f;  // Turns within one cell
+    float turn180Speed = 0.7f; // Turns around a post, over two cells
+};
+
+
+enum class RunMove
+{
+    Straight, // Along the i or j axis
+    Diagonal,
+    Turn45In,
+    Turn45Out,
+    Turn90,
+    Turn180,
+    Finish    // The straight into the goal cell, where timing stops
+};
+
+
+/* One piece of a planned run. Straights change speed from entrySpeed to at
+ * most peakSpeed and then to exitSpeed; turns are taken at one speed.
+ *
+ * Positions are in half cells: (2i + 1, 2j + 1) is the centre of cell
+ * (i, j), and a point with one odd coordinate is the middle of the wall
+ * between two cells. Headings count from 0 (+i) to 7 in steps of 45
+ * degrees towards +j, so even headings are along an axis and odd headings
+ * diagonal.
+ */
+struct RunSegment
+{
+    RunMove move;
+    int x;             // Where the segment ends
+    int y;
+    int heading;       // Heading at the end
+    float length;      // Metres
+    float entrySpeed;
+    float peakSpeed;
+    float exitSpeed;
+    float time;        // Seconds
+};
+
+
+// Steps in half cells for each heading
+const int headingDi[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+const int headingDj[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+// Lengths of the moves, in cells
+const float diagonalStepLength = 0.70710678f;
+const float turn45Length = 0.75f;
+const float turn90Length = 0.78539816f;
+const float turn180Length = 1.5707963f;
+
+
+inline int headingOf(int di, int dj)
+{
+    for (int h = 0; h < 8; ++h)
+    {
+        if (headingDi[h] == di && headingDj[h] == dj)
+            return h;
+    }
+    return 0;
+}
+
+
+// Time to cover length metres going from speed v0 to v1 with a trapezoidal
+// profile capped at the top speed, and the peak speed on the way. Returns
+// false if the speed cannot change that much.
+inline bool straightTime(float length, float v0, float v1, const RobotParams& p,
+                         float& time, float& peak)
+{
+    float a = p.acceleration;
+    if (std::fabs(v1 * v1 - v0 * v0) > 2.f * a * length * 1.0001f + 1e-6f)
+        return false;
+
+    peak = std::sqrt((2.f * a * length + v0 * v0 + v1 * v1) / 2.f);
+    if (peak > p.maxSpeed)
+        peak = p.maxSpeed;
+    if (peak < v0 || peak < v1)
+        peak = v0 > v1 ? v0 : v1;
+
+    float cruise = length - (2.f * peak * peak - v0 * v0 - v1 * v1) / (2.f * a);
+    time = (2.f * peak - v0 - v1) / a + (peak > 0.f && cruise > 0.f ? cruise / peak : 0.f);
+    return true;
+}
+
+
+/* Fastest run through a known maze, planned in the time domain.
+ *
+ * The run goes over the post-and-edge graph of the maze: its nodes are the
+ * middles of the open walls between cells, which the mouse crosses either
+ * straight or diagonally, so it can run diagonally along staircases of
+ * cells. The moves between nodes are straights along an axis, diagonals,
+ * and turns: 45 degrees into or out of a diagonal, 90 degrees within a cell
+ * and 180 degrees around a post. Each turn is taken at its turn speed.
+ * Between turns the mouse accelerates towards maxSpeed and brakes in time
+ * for the next turn, as a trapezoidal velocity profile.
+ *
+ * Dijkstra's algorithm runs over (node, heading, speed) states, where the
+ * speed is the one the state was reached by turning at, or 0 at the start,
+ * and each transition is a straight of any length followed by a turn, so
+ * the cost of a transition is exactly the time it takes. The run starts at
+ * rest in the centre of the start cell and ends when it enters a goal
+ * cell, at whatever speed it has reached.
+ *
+ * The turns are approximations of real turn geometry: a 90 degree turn is
+ * a quarter circle through the cell, a 180 a half circle around the post
+ * and a 45 degree turn 0.75 cells long. Speed can only change on
+ * straights, so a turn is taken at one speed, at or below its turn speed.
+ * The speeds are quantized to levels: the three turn speeds, and the
+ * slowest of them halved one to four times for a mouse that cannot reach
+ * it in time. A turn is tried at the fastest level the straight before it
+ * can reach and at every slower turn speed, so two turns in a row can
+ * share the speed of the slower one.
+ *
+ * All storage is inside the object, which can be reused between calls, so
+ * a mouse can plan again after every cell it explores. There are 64
+ * states for each wall and about 19 bytes per state, so a planner takes
+ * 0.65 MB at 16x16, 2.6 MB at 32x32 and 160 MB at 256x256. Keep one per
+ * thread and put it on the heap.
+ */
+template<int m, int n>
+class SpeedRunPlanner
+{
+public:
+    // Plans the fastest run from start to any goal cell. The maze may be a
+    // Maze or a MazeView.
+    template<class MazeT>
+    bool solve(const MazeT& maze,
+               Node start,
+               const BitArray2D<m, n>& goals,
+               const RobotParams& robot = RobotParams());
+
+    // Seconds the last plan takes, and its segments from the start
+    float time() const { return best; }
+    const std::vector<RunSegment>& segments() const { return plan; }
+
+    // The cells the last plan runs through, in the same order as bfs()
+    // returns paths: the start on top, the goal cell at the bottom
+    void cells(NodeStack<m, n>& path) const;
+
+    long expanded() const { return work.expanded; }
+
+private:
+    static const int width = 2 * m + 1;
+    static const int grid = (2 * m + 1) * (2 * n + 1);
+
+    // At rest, the speeds of 45, 90 and 180 degree turns, and the slowest
+    // of those halved one to four times
+    static const int speeds = 8;
+
+    // The middles of walls are the odd positions in the grid, as width is
+    // odd, and get the slots x + y * width / 2; the start gets the last one
+    static const int nodes = grid / 2 + 1;
+    static const int states = nodes * 8 * speeds;
+    static const int goalState = states; // Reached by finishing
+
+    int state(int x, int y, int heading, int speed) const
+    {
+        int k = x + y * width;
+        return ((k % 2 != 0 ? k / 2 : nodes - 1) * 8 + heading) * speeds + speed;
+    }
+
+    void decode(int s, int& x, int& y, int& heading, int& speed) const
+    {
+        speed = s % speeds;
+        heading = s / speeds % 8;
+        int node = s / speeds / 8;
+        int k = node == nodes - 1 ? startX + startY * width : 2 * node + 1;
+        x = k % width;
+        y = k / width;
+    }
+
+    bool isOpen(int x, int y) const
+    {
+        return x > 0 && y > 0 && x < 2 * m && y < 2 * n && open[x + y * width];
+    }
+
+    // The cell the mouse enters next when it crosses the wall at (x, y)
+    // with the given heading, as an index in the grid
+    static int crossed(int x, int y, int heading)
+    {
+        if (heading % 2 == 0 || x % 2 == 0)
+            x += headingDi[heading];
+        if (heading % 2 == 0 || y % 2 == 0)
+            y += headingDj[heading];
+        return x + y * width;
+    }
+
+    void relax(int from, int to, float cost, int run, RunMove move);
+    void turn(int from, int x, int y, int heading, float length, float turnSpeed, float turnLength,
+              int run, RunMove move);
+    void expand(int s, const BitArray2D<m, n>& goals);
+    void build();
+
+    void push(int s, float c);
+    int pop();
+    void siftUp(int k);
+    void siftDown(int k);
+
+    RobotParams params;
+    float speedOf[speeds];
+    int startX = 0;
+    int startY = 0;
+
+    unsigned char open[grid]; // Middles of open walls, and the start
+    float costs[states + 1];
+    int parent[states + 1];
+    unsigned short runs[states + 1];  // Straight steps before the move
+    unsigned char moves[states + 1];  // The RunMove into the state
+    int heap[states + 1];
+    int position[states + 1];         // Index in heap, -1 if never queued, -2 if done
+    int heapSize = 0;
+
+    float best = 0.f;
+    std::vector<RunSegment> plan;
+    std::vector<int> trail; // Every position of the plan, for cells()
+    std::vector<int> chain; // States of the plan, from the goal back
+    SearchStats work;
+};
+
+
+template<int m, int n>
+bool planSpeedRun(const Maze<m, n>& maze,
+                  Node start,
+                  Node goal,
+                  std::vector<RunSegment>& plan,
+                  const RobotParams& robot = RobotParams());
+
+
+template<int m, int n>
+template<class MazeT>
+bool SpeedRunPlanner<m, n>::solve(const MazeT& maze,
+                                  Node start,
+                                  const BitArray2D<m, n>& goals,
+                                  const RobotParams& robot)
+{
+    static_assert(MazeT::rows == m && MazeT::cols == n, "maze sizes differ");
+    TRACE_SCOPE("speed_run");
+
+    params = robot;
+    float top = params.maxSpeed;
+    speedOf[0] = 0.f;
+    speedOf[1] = params.turn45Speed < top ? params.turn45Speed : top;
+    speedOf[2] = params.turn90Speed < top ? params.turn90Speed : top;
+    speedOf[3] = params.turn180Speed < top ? params.turn180Speed : top;
+    float slowest = std::fmin(speedOf[1], std::fmin(speedOf[2], speedOf[3]));
+    for (int k = 4; k < speeds; ++k)
+        speedOf[k] = slowest / float(1 << (k - 3));
+
+    plan.clear();
+    trail.clear();
+    best = 0.f;
+
+    startX = 2 * start.i + 1;
+    startY = 2 * start.j + 1;
+    if (goals.get(start.i, start.j))
+    {
+        trail.push_back(startX + startY * width);
+        return true;
+    }
+
+    // The wall on the +i and +j side of each cell
+    for (int k = 0; k < grid; ++k)
+        open[k] = 0;
+    for (int i = 0; i < m; ++i)
+    {
+        for (int j = 0; j < n; ++j)
+        {
+            auto cw = maze.getCellWalls(i, j);
+            open[(2 * i + 2) + (2 * j + 1) * width] = !cw[0];
+            open[(2 * i + 1) + (2 * j + 2) * width] = !cw[1];
+        }
+    }
+    open[startX + startY * width] = 1;
+
+    for (int s = 0; s <= states; ++s)
+        position[s] = -1;
+    heapSize = 0;
+
+    for (int h = 0; h < 8; h += 2)
+    {
+        int s = state(startX, startY, h, 0);
+        parent[s] = -1;
+        push(s, 0.f);
+    }
+
+    while (heapSize > 0)
+    {
+        int s = pop();
+        ++work.expanded;
+
+        if (s == goalState)
+        {
+            best = costs[s];
+            build();
+            return true;
+        }
+
+        expand(s, goals);
+    }
+
+    return false;
+}
+
+
+// Tries every straight from the state followed by every turn, and the
+// straights that end in a goal cell
+template<int m, int n>
+void SpeedRunPlanner<m, n>::expand(int s, const BitArray2D<m, n>& goals)
+{
+    int speed, h, x, y;
+    decode(s, x, y, h, speed);
+    float v0 = speedOf[speed];
+    bool diagonal = h % 2 != 0;
+    int stride = diagonal ? 1 : 2;
+    float cell = params.cellSize;
+    float length = 0.f;
+
+    // From the centre of the start cell, the first node is half a cell away
+    if (x == startX && y == startY)
+    {
+        x += headingDi[h];
+        y += headingDj[h];
+        length = 0.5f * cell;
+    }
+
+    for (int k = 0; isOpen(x, y); ++k)
+    {
+        float straight;
+        float peak;
+
+        // Into the goal cell ahead, at any speed
+        int ahead = crossed(x, y, h);
+        if (goals.get((ahead % width - 1) / 2, (ahead / width - 1) / 2))
+        {
+            float v1 = std::sqrt(v0 * v0 + 2.f * params.acceleration * length);
+            if (v1 > params.maxSpeed)
+                v1 = params.maxSpeed;
+            if (straightTime(length, v0, v1, params, straight, peak))
+                relax(s, goalState, costs[s] + straight, k, RunMove::Finish);
+        }
+
+        if (diagonal)
+        {
+            // Out of the diagonal, crossing the next wall straight
+            int tx = x + headingDi[h];
+            int ty = y + headingDj[h];
+            if (isOpen(tx, ty))
+            {
+                int out = tx % 2 == 0 ? headingOf(headingDi[h], 0) : headingOf(0, headingDj[h]);
+                turn(s, tx, ty, out, length, speedOf[1], turn45Length, k, RunMove::Turn45Out);
+            }
+        }
+        else
+        {
+            for (int side = -2; side <= 2; side += 4)
+            {
+                int turned = (h + side + 8) % 8;
+                int tx = x + headingDi[h] + headingDi[turned];
+                int ty = y + headingDj[h] + headingDj[turned];
+                if (!isOpen(tx, ty))
+                    continue;
+
+                turn(s, tx, ty, turned, length, speedOf[2], turn90Length, k, RunMove::Turn90);
+                turn(s, tx, ty, (h + side / 2 + 8) % 8, length, speedOf[1], turn45Length,
+                     k, RunMove::Turn45In);
+
+                int ux = x + 2 * headingDi[turned];
+                int uy = y + 2 * headingDj[turned];
+                if (isOpen(ux, uy))
+                    turn(s, ux, uy, (h + 4) % 8, length, speedOf[3], turn180Length, k, RunMove::Turn180);
+            }
+        }
+
+        x += stride * headingDi[h];
+        y += stride * headingDj[h];
+        length += (diagonal ? diagonalStepLength : 1.f) * cell;
+    }
+}
+
+
+// A straight of length metres from state from followed by a turn that ends
+// at (x, y) with the given heading, taken at the fastest speed level the
+// straight can reach that is not above turnSpeed, and at every slower turn
+// speed it can reach
+template<int m, int n>
+void SpeedRunPlanner<m, n>::turn(int from, int x, int y, int heading, float length, float turnSpeed,
+                                 float turnLength, int run, RunMove move)
+{
+    float v0 = speedOf[from % speeds];
+    float straight[speeds];
+    bool reached[speeds];
+    int fastest = -1;
+
+    for (int level = 1; level < speeds; ++level)
+    {
+        float peak;
+        reached[level] = speedOf[level] <= turnSpeed &&
+                         straightTime(length, v0, speedOf[level], params, straight[level], peak);
+        if (reached[level] && (fastest < 0 || speedOf[level] > speedOf[fastest]))
+            fastest = level;
+    }
+
+    // Levels 1 to 3 are the turn speeds
+    for (int level = 1; level < speeds; ++level)
+    {
+        float v1 = speedOf[level];
+        if (reached[level] && (level == fastest || level <= 3))
+            relax(from, state(x, y, heading, level),
+                  costs[from] + straight[level] + turnLength * params.cellSize / v1, run, move);
+    }
+}
+
+
+template<int m, int n>
+void SpeedRunPlanner<m, n>::relax(int from, int to, float cost, int run, RunMove move)
+{
+    if (position[to] == -2 || (position[to] >= 0 && costs[to] <= cost))
+        return;
+
+    parent[to] = from;
+    runs[to] = (unsigned short)run;
+    moves[to] = (unsigned char)move;
+    push(to, cost);
+}
+
+
+// Turns the chain of states that reached the goal into segments
+template<int m, int n>
+void SpeedRunPlanner<m, n>::build()
+{
+    chain.clear();
+    for (int s = goalState; s >= 0; s = parent[s])
+        chain.push_back(s);
+
+    trail.push_back(startX + startY * width);
+    float cell = params.cellSize;
+
+    for (int c = int(chain.size()) - 1; c > 0; --c)
+    {
+        int from = chain[c];
+        int to = chain[c - 1];
+        int speed, h, x, y;
+        decode(from, x, y, h, speed);
+        bool diagonal = h % 2 != 0;
+        int stride = diagonal ? 1 : 2;
+        RunMove move = RunMove(moves[to]);
+        float length = 0.f;
+
+        if (x == startX && y == startY)
+        {
+            x += headingDi[h];
+            y += headingDj[h];
+            length = 0.5f * cell;
+            trail.push_back(x + y * width);
+        }
+        for (int k = 0; k < runs[to]; ++k)
+        {
+            trail.push_back(crossed(x, y, h));
+            x += stride * headingDi[h];
+            y += stride * headingDj[h];
+            length += (diagonal ? diagonalStepLength : 1.f) * cell;
+            trail.push_back(x + y * width);
+        }
+
+        float v0 = speedOf[speed];
+        float v1 = to == goalState ? 0.f : speedOf[to % speeds];
+        if (to == goalState)
+        {
+            v1 = std::sqrt(v0 * v0 + 2.f * params.acceleration * length);
+            if (v1 > params.maxSpeed)
+                v1 = params.maxSpeed;
+        }
+
+        float time = 0.f;
+        float peak = v0;
+        straightTime(length, v0, v1, params, time, peak);
+        if (length > 0.f || to == goalState)
+        {
+            RunMove kind = to == goalState ? RunMove::Finish :
+                           (diagonal ? RunMove::Diagonal : RunMove::Straight);
+            plan.push_back(RunSegment{kind, x, y, h, length, v0, peak, v1, time});
+        }
+
+        if (to == goalState)
+        {
+            trail.push_back(crossed(x, y, h));
+            break;
+        }
+
+        int tspeed, th, tx, ty;
+        decode(to, tx, ty, th, tspeed);
+        float turn = move == RunMove::Turn90 ? turn90Length :
+                     (move == RunMove::Turn180 ? turn180Length : turn45Length);
+
+        // The cells the turn passes through; a 180 passes the cell beside
+        // the first one too
+        trail.push_back(crossed(x, y, h));
+        if (move == RunMove::Turn180)
+            trail.push_back(crossed(x, y, h) + (tx - x) + (ty - y) * width);
+        trail.push_back(tx + ty * width);
+
+        plan.push_back(RunSegment{move, tx, ty, th, turn * cell, v1, v1, v1, turn * cell / v1});
+    }
+}
+
+
+template<int m, int n>
+void SpeedRunPlanner<m, n>::cells(NodeStack<m, n>& path) const
+{
+    path.clear();
+    for (int k = int(trail.size()) - 1; k >= 0; --k)
+    {
+        int x = trail[k] % width;
+        int y = trail[k] / width;
+        if (x % 2 == 1 && y % 2 == 1)
+            path.push(Node{(x - 1) / 2, (y - 1) / 2});
+    }
+}
+
+
+template<int m, int n>
+void SpeedRunPlanner<m, n>::push(int s, float c)
+{
+    costs[s] = c;
+
+    if (position[s] < 0)
+    {
+        position[s] = heapSize;
+        heap[heapSize++] = s;
+    }
+
+    siftUp(position[s]);
+}
+
+
+template<int m, int n>
+int SpeedRunPlanner<m, n>::pop()
+{
+    int s = heap[0];
+    position[s] = -2;
+
+    if (--heapSize > 0)
+    {
+        heap[0] = heap[heapSize];
+        position[heap[0]] = 0;
+        siftDown(0);
+    }
+
+    return s;
+}
+
+
+template<int m, int n>
+void SpeedRunPlanner<m, n>::siftUp(int k)
+{
+    int s = heap[k];
+
+    while (k > 0 && costs[heap[(k - 1) / 2]] > costs[s])
+    {
+        heap[k] = heap[(k - 1) / 2];
+        position[heap[k]] = k;
+        k = (k - 1) / 2;
+    }
+
+    heap[k] = s;
+    position[s] = k;
+}
+
+
+template<int m, int n>
+void SpeedRunPlanner<m, n>::siftDown(int k)
+{
+    int s = heap[k];
+
+    for (;;)
+    {
+        int child = 2 * k + 1;
+        if (child >= heapSize)
+            break;
+        if (child + 1 < heapSize && costs[heap[child + 1]] < costs[heap[child]])
+            ++child;
+        if (costs[heap[child]] >= costs[s])
+            break;
+
+        heap[k] = heap[child];
+        position[heap[k]] = k;
+        k = child;
+    }
+
+    heap[k] = s;
+    position[s] = k;
+}
+
+
+template<int m, int n>
+bool planSpeedRun(const Maze<m, n>& maze,
+                  Node start,
+                  Node goal,
+                  std::vector<RunSegment>& plan,
+                  const RobotParams& robot)
+{
+    // The state arrays are too large for the stack
+    std::unique_ptr<SpeedRunPlanner<m, n>> planner(new SpeedRunPlanner<m, n>);
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+
+    bool found = planner->solve(maze, start, goals, robot);
+    plan = planner->segments();
+    return found;
+}
+
+#endif // SPEEDRUN_HPP
@@ -0,0 +1,412 @@
+#ifndef SYMMETRY_HPP
+#define SYMMETRY_HPP
+
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include "Maze.hpp"
+#include "BFS.hpp"
+
+
+/* Symmetry-canonical form and hash of a maze.
+ *
+ * A maze with a start and a goal has up to 8 images under the symmetries of
+ * the square: symmetry t flips i if t & 2, flips j if t & 4 and then swaps i
+ * and j if t & 1. Swapping needs a square maze. The canonical form is the
+ * image with the smallest walls, start and goal (compared as words), and
+ * its key is a 128-bit hash of that image. Mazes that are rotations or
+ * mirrors of each other, with start and goal carried along, get the same
+ * key, so a result computed once in the canonical frame can be reused for
+ * all of them by mapping it back with fromCanonical().
+ *
+ * The images are built from the wall planes a line at a time: each line of
+ * a plane (the walls with one j) is a few 64-bit words, flipping i reverses
+ * the bits of every line, flipping j reverses the order of the lines, and
+ * swapping i and j transposes the planes in 64x64 blocks and exchanges
+ * them. Nothing looks at single cells, so canonicalizing a 16x16 maze takes
+ * a couple of microseconds, less than loading it from a string.
+ *
+ * Results that depend on the heading of the mouse are not invariant under
+ * swapping i and j: ScorePath() and turnSearch() assume that the mouse
+ * starts facing along j. Pass mirrorSymmetries to compute() for those, so
+ * that only the flips, which keep both axes, are considered. Results that
+ * also depend on which way the explorer breaks ties, like the simulation's,
+ * need noSymmetries: the key then stands for exactly this maze, start and
+ * goal.
+ */
+const unsigned allSymmetries = 0xff;
+const unsigned mirrorSymmetries = 0x55; // The symmetries t without t & 1
+const unsigned noSymmetries = 0x01;     // Only the identity, for results that depend on the orientation
+
+
+// 128-bit hash of a canonical form
+struct MazeKey
+{
+    std::uint64_t hi = 0;
+    std::uint64_t lo = 0;
+
+    bool operator==(const MazeKey& other) const
+    {
+        return hi == other.hi && lo == other.lo;
+    }
+
+    bool operator<(const MazeKey& other) const
+    {
+        return hi < other.hi || (hi == other.hi && lo < other.lo);
+    }
+};
+
+
+// The bits of one wall plane as lines of 64-bit words: bit b of line l is
+// the plane's bit b + l * bits. The bits past the end of a line stay zero.
+template<int lines, int bits>
+struct BitPlane
+{
+    static const int words = (bits + 63) / 64;
+
+    std::uint64_t line[lines][words];
+
+    template<int r, int c>
+    void load(const BitArray2D<r, c>& plane);
+    void save(unsigned char* bytes) const;
+
+    void reverseBits();
+    void reverseLines();
+    void transpose(BitPlane<bits, lines>& out) const;
+
+    // Like memcmp over the words
+    int compare(const BitPlane& other) const;
+};
+
+
+template<int m, int n>
+class CanonicalMaze
+{
+public:
+    // Finds the canonical form among the given symmetries (a mask with bit
+    // t set for symmetry t). Symmetries that swap i and j are skipped unless
+    // m == n.
+    void compute(const Maze<m, n>& maze, Node start, Node goal,
+                 unsigned symmetries = allSymmetries);
+
+    MazeKey key() const { return hashKey; }
+
+    // The symmetry that maps the maze onto its canonical form
+    int symmetry() const { return best; }
+
+    Node start() const { return toCanonical(origStart); }
+    Node goal() const { return toCanonical(origGoal); }
+
+    Node toCanonical(Node v) const { return transform(best, v); }
+    Node fromCanonical(Node v) const { return inverse(best, v); }
+
+    // Writes the canonical image of the maze
+    void copyTo(Maze<m, n>& maze) const;
+
+    static Node transform(int t, Node v);
+    static Node inverse(int t, Node v);
+
+private:
+    typedef BitPlane<n, m - 1> MPlane;
+    typedef BitPlane<n - 1, m> NPlane;
+
+    void consider(int t, const MPlane& mp, const NPlane& np);
+    void considerFlips(int base, const MPlane& mp, const NPlane& np, unsigned symmetries);
+    void considerTransposed(unsigned symmetries, std::true_type);
+    void considerTransposed(unsigned, std::false_type) {}
+
+    Node origStart;
+    Node origGoal;
+
+    // The planes of the maze and of its transpose, one image being tried
+    // and the smallest so far
+    MPlane mPlane;
+    NPlane nPlane;
+    MPlane mSwapped;
+    NPlane nSwapped;
+    MPlane mTrial;
+    NPlane nTrial;
+    MPlane mBest;
+    NPlane nBest;
+
+    int best = -1;
+    Node bestStart;
+    Node bestGoal;
+    MazeKey hashKey;
+};
+
+
+// Reverses the order of the bits of a word
+inline std::uint64_t reverseWord(std::uint64_t x)
+{
+    x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+    x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+    x = ((x >> 4) & 0x0f0f0f0f0f0f0f0full) | ((x & 0x0f0f0f0f0f0f0f0full) << 4);
+    x = ((x >> 8) & 0x00ff00ff00ff00ffull) | ((x & 0x00ff00ff00ff00ffull) << 8);
+    x = ((x >> 16) & 0x0000ffff0000ffffull) | ((x & 0x0000ffff0000ffffull) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+
+// Transposes a 64x64 bit matrix in place: bit c of a[r] becomes bit r of
+// a[c]. Swaps ever smaller blocks, from 32x32 down to single bits.
+inline void transposeBlock(std::uint64_t a[64])
+{
+    std::uint64_t mask = 0x00000000ffffffffull;
+    for (int s = 32; s != 0; s >>= 1, mask ^= mask << s)
+    {
+        for (int k = 0; k < 64; k = ((k | s) + 1) & ~s)
+        {
+            std::uint64_t t = ((a[k] >> s) ^ a[k | s]) & mask;
+            a[k] ^= t << s;
+            a[k | s] ^= t;
+        }
+    }
+}
+
+
+// Mixes one word into each half of a 128-bit hash
+inline void hashWord(MazeKey& key, std::uint64_t w)
+{
+    key.hi = (key.hi ^ w) * 0x9e3779b97f4a7c15ull;
+    key.hi ^= key.hi >> 32;
+    key.lo = (key.lo ^ w) * 0xc2b2ae3d27d4eb4full;
+    key.lo ^= key.lo >> 29;
+}
+
+
+template<int lines, int bits>
+template<int r, int c>
+void BitPlane<lines, bits>::load(const BitArray2D<r, c>& plane)
+{
+    static_assert(r == bits && c == lines, "plane and array differ in shape");
+
+    for (int l = 0; l < lines; ++l)
+        for (int w = 0; w < words; ++w)
+            line[l][w] = plane.getBits(l * bits + 64 * w, bits - 64 * w < 64 ? bits - 64 * w : 64);
+}
+
+
+// Packs the lines back into the bytes of a BitArray2D
+template<int lines, int bits>
+void BitPlane<lines, bits>::save(unsigned char* bytes) const
+{
+    for (int k = 0; k < (lines * bits + 7) / 8; ++k)
+        bytes[k] = 0;
+
+    for (int l = 0; l < lines; ++l)
+    {
+        for (int w = 0; w < words; ++w)
+        {
+            int pos = l * bits + 64 * w;
+            int count = bits - 64 * w < 64 ? bits - 64 * w : 64;
+            std::uint64_t x = line[l][w];
+
+            for (int done = 0; done < count; )
+            {
+                int shift = (pos + done) % 8;
+                bytes[(pos + done) / 8] |= (unsigned char)(x << shift);
+                x >>= 8 - shift;
+                done += 8 - shift;
+            }
+        }
+    }
+}
+
+
+template<int lines, int bits>
+void BitPlane<lines, bits>::reverseBits()
+{
+    // Reversing all the words puts the line at the top of the last one
+    const int shift = words * 64 - bits;
+
+    for (int l = 0; l < lines; ++l)
+    {
+        std::uint64_t t[words];
+        for (int w = 0; w < words; ++w)
+            t[words - 1 - w] = reverseWord(line[l][w]);
+
+        for (int w = 0; w < words; ++w)
+        {
+            std::uint64_t high = shift > 0 && w + 1 < words ? t[w + 1] << (64 - shift) : 0;
+            line[l][w] = (t[w] >> shift) | high;
+        }
+    }
+}
+
+
+template<int lines, int bits>
+void BitPlane<lines, bits>::reverseLines()
+{
+    for (int l = 0; l < lines / 2; ++l)
+        for (int w = 0; w < words; ++w)
+            std::swap(line[l][w], line[lines - 1 - l][w]);
+}
+
+
+template<int lines, int bits>
+void BitPlane<lines, bits>::transpose(BitPlane<bits, lines>& out) const
+{
+    std::uint64_t block[64];
+
+    for (int lw = 0; lw < BitPlane<bits, lines>::words; ++lw)
+    {
+        for (int bw = 0; bw < words; ++bw)
+        {
+            for (int r = 0; r < 64; ++r)
+                block[r] = 64 * lw + r < lines ? line[64 * lw + r][bw] : 0;
+
+            transposeBlock(block);
+
+            for (int c = 0; c < 64 && 64 * bw + c < bits; ++c)
+                out.line[64 * bw + c][lw] = block[c];
+        }
+    }
+}
+
+
+template<int lines, int bits>
+int BitPlane<lines, bits>::compare(const BitPlane& other) const
+{
+    for (int l = 0; l < lines; ++l)
+        for (int w = 0; w < words; ++w)
+            if (line[l][w] != other.line[l][w])
+                return line[l][w] < other.line[l][w] ? -1 : 1;
+    return 0;
+}
+
+
+template<int m, int n>
+void CanonicalMaze<m, n>::compute(const Maze<m, n>& maze, Node start, Node goal,
+                                  unsigned symmetries)
+{
+    origStart = start;
+    origGoal = goal;
+    best = -1;
+
+    mPlane.load(maze.getMWalls());
+    nPlane.load(maze.getNWalls());
+    considerFlips(0, mPlane, nPlane, symmetries);
+    considerTransposed(symmetries, std::integral_constant<bool, m == n>());
+
+    hashKey = MazeKey();
+    hashWord(hashKey, std::uint64_t(m) << 32 | std::uint32_t(n));
+    for (int l = 0; l < n; ++l)
+        for (int w = 0; w < MPlane::words; ++w)
+            hashWord(hashKey, mBest.line[l][w]);
+    for (int l = 0; l < n - 1; ++l)
+        for (int w = 0; w < NPlane::words; ++w)
+            hashWord(hashKey, nBest.line[l][w]);
+    hashWord(hashKey, std::uint64_t(bestStart.i) << 48 | std::uint64_t(bestStart.j) << 32 |
+                      std::uint64_t(bestGoal.i) << 16 | std::uint64_t(bestGoal.j));
+    hashKey.hi ^= hashKey.lo >> 17;
+    hashKey.lo ^= hashKey.hi >> 23;
+}
+
+
+template<int m, int n>
+void CanonicalMaze<m, n>::copyTo(Maze<m, n>& maze) const
+{
+    unsigned char bytes[Maze<m, n>::byteCount];
+    mBest.save(bytes);
+    nBest.save(bytes + ((m - 1) * n + 7) / 8);
+    maze.loadBytes(bytes);
+}
+
+
+template<int m, int n>
+Node CanonicalMaze<m, n>::transform(int t, Node v)
+{
+    Node u = {t & 2 ? m - 1 - v.i : v.i, t & 4 ? n - 1 - v.j : v.j};
+    if (t & 1)
+        return {u.j, u.i};
+    return u;
+}
+
+
+template<int m, int n>
+Node CanonicalMaze<m, n>::inverse(int t, Node v)
+{
+    Node u = t & 1 ? Node{v.j, v.i} : v;
+    return {t & 2 ? m - 1 - u.i : u.i, t & 4 ? n - 1 - u.j : u.j};
+}
+
+
+// Keeps the image under symmetry t if it is smaller than the best so far
+template<int m, int n>
+void CanonicalMaze<m, n>::consider(int t, const MPlane& mp, const NPlane& np)
+{
+    Node s = transform(t, origStart);
+    Node g = transform(t, origGoal);
+
+    if (best >= 0)
+    {
+        int c = mp.compare(mBest);
+        if (c == 0)
+            c = np.compare(nBest);
+        if (c == 0)
+        {
+            if (s.i != bestStart.i || s.j != bestStart.j)
+                c = s.i < bestStart.i || (s.i == bestStart.i && s.j < bestStart.j) ? -1 : 1;
+            else if (g.i != bestGoal.i || g.j != bestGoal.j)
+                c = g.i < bestGoal.i || (g.i == bestGoal.i && g.j < bestGoal.j) ? -1 : 1;
+        }
+        if (c >= 0)
+            return;
+    }
+
+    best = t;
+    mBest = mp;
+    nBest = np;
+    bestStart = s;
+    bestGoal = g;
+}
+
+
+// Tries the four flips of the planes, which are the image under symmetry
+// base (0 or 1). After a swap, reversing the bits of the lines flips j of
+// the maze and reversing the lines flips i.
+template<int m, int n>
+void CanonicalMaze<m, n>::considerFlips(int base, const MPlane& mp, const NPlane& np,
+                                        unsigned symmetries)
+{
+    for (int flip = 0; flip < 4; ++flip)
+    {
+        int flipI = base ? flip & 2 : flip & 1;
+        int flipJ = base ? flip & 1 : flip & 2;
+        int t = base | (flipI ? 2 : 0) | (flipJ ? 4 : 0);
+        if (!(symmetries >> t & 1))
+            continue;
+
+        mTrial = mp;
+        nTrial = np;
+        if (flip & 1)
+        {
+            mTrial.reverseBits();
+            nTrial.reverseBits();
+        }
+        if (flip & 2)
+        {
+            mTrial.reverseLines();
+            nTrial.reverseLines();
+        }
+        consider(t, mTrial, nTrial);
+    }
+}
+
+
+// The walls between (i, j) and (i + 1, j) of the transpose are the walls
+// between (j, i) and (j, i + 1) of the maze, and the other way round. The
+// flips of the transpose are symmetries 1, 3, 5 and 7.
+template<int m, int n>
+void CanonicalMaze<m, n>::considerTransposed(unsigned symmetries, std::true_type)
+{
+    if (!(symmetries & 0xaa))
+        return;
+
+    nPlane.transpose(mSwapped);
+    mPlane.transpose(nSwapped);
+    considerFlips(1, mSwapped, nSwapped, symmetries);
+}
+
+#endif // SYMMETRY_HPP
@@ -0,0 +1,239 @@
+#include "Trace.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+namespace
+{
+
+struct TraceEvent
+{
+    const char* name;
+    std::int64_t start;    // ns since the first event
+    std::int64_t duration; // ns, -1 for counter samples
+    std::int64_t value;    // Counter samples only
+};
+
+
+// Everything one thread recorded. Kept after the thread exits, so a trace
+// can still be written once the workers are gone.
+struct ThreadTrace
+{
+    int id = 0;
+    std::vector<TraceEvent> events;
+    long dropped = 0;
+    std::vector<std::pair<const char*, std::int64_t>> tallies;
+};
+
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadTrace>> registry;
+
+
+ThreadTrace& local()
+{
+    thread_local ThreadTrace* trace = nullptr;
+    if (!trace)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new ThreadTrace);
+        trace = registry.back().get();
+        trace->id = int(registry.size()) - 1;
+    }
+    return *trace;
+}
+
+
+std::int64_t now()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+
+void record(const char* name, std::int64_t start, std::int64_t duration, std::int64_t value)
+{
+    ThreadTrace& trace = local();
+    if (long(trace.events.size()) >= traceEventLimit)
+        ++trace.dropped;
+    else
+        trace.events.push_back(TraceEvent{name, start, duration, value});
+}
+
+
+std::int64_t& tally(const char* name)
+{
+    ThreadTrace& trace = local();
+    for (auto& t : trace.tallies)
+    {
+        if (std::strcmp(t.first, name) == 0)
+            return t.second;
+    }
+    trace.tallies.emplace_back(name, 0);
+    return trace.tallies.back().second;
+}
+
+
+void writeName(std::ostream& out, const char* name)
+{
+    out << '"';
+    for (const char* c = name; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\')
+            out << '\\';
+        out << *c;
+    }
+    out << '"';
+}
+
+
+// Writes a time in ns as microseconds with three decimals
+void writeMicros(std::ostream& out, std::int64_t ns)
+{
+    out << ns / 1000 << '.' << ns / 100 % 10 << ns / 10 % 10 << ns % 10;
+}
+
+} // namespace
+
+
+TraceTimer::TraceTimer(const char* name) : name(name), start(now())
+{
+}
+
+
+TraceTimer::~TraceTimer()
+{
+    record(name, start, now() - start, 0);
+}
+
+
+void traceCounter(const char* name, std::int64_t value)
+{
+    record(name, now(), -1, value);
+}
+
+
+void traceTally(const char* name)
+{
+    ++tally(name);
+}
+
+
+void traceFlush(const char* name, const char* tallyName)
+{
+    std::int64_t& t = tally(tallyName);
+    traceCounter(name, t);
+    t = 0;
+}
+
+
+void clearTrace()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& trace : registry)
+    {
+        trace->events.clear();
+        trace->dropped = 0;
+    }
+}
+
+
+long traceEvents()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    long count = 0;
+    for (auto& trace : registry)
+        count += long(trace->events.size());
+    return count;
+}
+
+
+long traceDropped()
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    long count = 0;
+    for (auto& trace : registry)
+        count += trace->dropped;
+    return count;
+}
+
+
+bool writeChromeTrace(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    bool first = true;
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (auto& trace : registry)
+    {
+        for (const TraceEvent& e : trace->events)
+        {
+            out << (first ? "\n" : ",\n") << "{\"name\":";
+            writeName(out, e.name);
+            out << ",\"ph\":\"" << (e.duration < 0 ? 'C' : 'X') << "\",\"pid\":1,\"tid\":"
+                << trace->id << ",\"ts\":";
+            writeMicros(out, e.start);
+            if (e.duration < 0)
+            {
+                out << ",\"args\":{\"value\":" << e.value << "}}";
+            }
+            else
+            {
+                out << ",\"dur\":";
+                writeMicros(out, e.duration);
+                out << '}';
+            }
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+
+    return bool(out);
+}
+
+
+bool writeTraceCsv(std::ostream& out)
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    out << "name,kind,thread,start_us,duration_us,value\n";
+    for (auto& trace : registry)
+    {
+        for (const TraceEvent& e : trace->events)
+        {
+            out << e.name << ',' << (e.duration < 0 ? "counter" : "scope") << ','
+                << trace->id << ',';
+            writeMicros(out, e.start);
+            out << ',';
+            if (e.duration < 0)
+            {
+                out << ',' << e.value << '\n';
+            }
+            else
+            {
+                writeMicros(out, e.duration);
+                out << ",\n";
+            }
+        }
+    }
+
+    return bool(out);
+}
+
+
+bool writeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    return csv ? writeTraceCsv(file) : writeChromeTrace(file);
+}
@@ -0,0 +1,95 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#ifdef MAZE_EMBEDDED
+#ifdef MAZE_TRACE
+#error "tracing is not available in the embedded profile"
+#endif
+#else
+#include <cstdint>
+#include <ostream>
+#include <string>
+#endif
+
+
+/* Lightweight tracing of the hot paths.
+ *
+ * The macros below record into a buffer per thread when the program is built
+ * with MAZE_TRACE defined (make TRACE=1) and expand to nothing otherwise, so
+ * a normal build pays nothing for them:
+ *
+ *     TRACE_SCOPE(name)          time the enclosing scope
+ *     TRACE_COUNTER(name, value) record a sample of a counter
+ *     TRACE_TALLY(name)          add one to a running tally of this thread
+ *     TRACE_FLUSH(name, tally)   record the tally as a sample of counter
+ *                                name and start it again from zero
+ *     TRACE_ONLY(code)           code that only exists in traced builds
+ *
+ * Names must be string literals, or otherwise live as long as the trace.
+ *
+ * The functions are always available, so the tools and the GUI can offer to
+ * export a trace either way; without MAZE_TRACE the trace is just empty.
+ * Export with writeTrace() while no other thread is recording. Each thread
+ * keeps at most traceEventLimit events; later ones are counted as dropped.
+ *
+ * The embedded profile (MAZE_EMBEDDED) only gets the empty macros.
+ */
+#ifndef MAZE_EMBEDDED
+const long traceEventLimit = 1L << 22;
+
+class TraceTimer
+{
+public:
+    explicit TraceTimer(const char* name);
+    ~TraceTimer();
+
+    TraceTimer(const TraceTimer&) = delete;
+    TraceTimer& operator=(const TraceTimer&) = delete;
+
+private:
+    const char* name;
+    std::int64_t start;
+};
+
+void traceCounter(const char* name, std::int64_t value);
+void traceTally(const char* name);
+void traceFlush(const char* name, const char* tally);
+
+// Forgets all events recorded so far
+void clearTrace();
+
+// Number of events recorded and dropped over all threads
+long traceEvents();
+long traceDropped();
+
+// Chrome trace JSON (chrome://tracing, Perfetto) or CSV with the columns
+//     name,kind,thread,start_us,duration_us,value
+// where kind is "scope" or "counter"
+bool writeChromeTrace(std::ostream& out);
+bool writeTraceCsv(std::ostream& out);
+
+// Writes CSV if the path ends in ".csv" and Chrome trace JSON otherwise
+bool writeTrace(const std::string& path);
+#endif
+
+#ifdef MAZE_TRACE
+const bool traceEnabled = true;
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceTimer TRACE_JOIN(traceTimer, __LINE__)(name)
+#define TRACE_COUNTER(name, value) traceCounter(name, value)
+#define TRACE_TALLY(name) traceTally(name)
+#define TRACE_FLUSH(name, tally) traceFlush(name, tally)
+#define TRACE_ONLY(...) __VA_ARGS__
+#else
+const bool traceEnabled = false;
+
+#define TRACE_SCOPE(name)
+#define TRACE_COUNTER(name, value)
+#define TRACE_TALLY(name)
+#define TRACE_FLUSH(name, tally)
+#define TRACE_ONLY(...)
+#endif
+
+#endif // TRACE_HPP
@@ -0,0 +1,307 @@
+#ifndef TURNSEARCH_HPP
+#define TURNSEARCH_HPP
+
+#ifndef MAZE_EMBEDDED
+#include <memory>
+#endif
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+#include "Trace.hpp"
+
+
+/* Cost of each step of a run, depending on the step before it. The defaults
+ * are the weights ScorePath() uses, so the minimum cost path found by
+ * TurnSearch is the path with the lowest ScorePath() score.
+ */
+struct TurnCosts
+{
+    float straight = 0.5f; // Step in the same direction as the last one
+    float turn = 1.0f;     // Step at 90 degrees to the last one
+    float uTurn = 2.0f;    // Step back the way the last one came
+
+    // Directions the mouse may be facing at the start, one bit per wall
+    // direction (see Maze.hpp). The default faces along the j axis, as
+    // ScorePath() assumes.
+    unsigned startHeadings = (1 << 1) | (1 << 3);
+};
+
+
+/* Minimum cost path search over (cell, heading) states.
+ *
+ * The heading of a state is the direction of the step that entered the cell,
+ * so the cost of the next step is known from the state alone. Dijkstra's
+ * algorithm with an indexed binary heap finds the cheapest path in one call.
+ * All storage is inside the object, which can be reused between calls.
+ */
+template<int m, int n>
+class TurnSearch
+{
+public:
+    // Finds the cheapest path from start to any goal cell, never entering
+    // cells set in avoid (if given). The path is returned in the same order
+    // as bfs() returns it. The maze may be a Maze or a MazeView.
+    template<class MazeT>
+    bool solve(const MazeT& maze,
+               Node start,
+               const BitArray2D<m, n>& goals,
+               NodeStack<m, n>& path,
+               const TurnCosts& costs = TurnCosts(),
+               const BitArray2D<m, n>* avoid = nullptr);
+
+    // Cost of the path found by the last successful solve
+    float cost() const { return best; }
+
+    long expanded() const { return work.expanded; }
+
+private:
+    static const int states = 4 * m * n;
+
+    void push(int s, float c);
+    int pop();
+    void siftUp(int k);
+    void siftDown(int k);
+
+    float costs[states];
+    unsigned char prevHeading[states];
+    int heap[states];
+    int position[states]; // Index in heap, -1 if never queued, -2 if done
+    int heapSize = 0;
+    float best = 0.f;
+    SearchStats work;
+};
+
+
+template<int m, int n>
+bool turnSearch(const Maze<m, n>& maze,
+                Node start,
+                Node goal,
+                NodeStack<m, n>& path,
+                const TurnCosts& costs = TurnCosts());
+
+template<int m, int n>
+bool turnSearch(const Maze<m, n>& maze,
+                Node start,
+                const BitArray2D<m, n>& goals,
+                NodeStack<m, n>& path,
+                const TurnCosts& costs = TurnCosts());
+
+
+template<int m, int n>
+template<class MazeT>
+bool TurnSearch<m, n>::solve(const MazeT& maze,
+                             Node start,
+                             const BitArray2D<m, n>& goals,
+                             NodeStack<m, n>& path,
+                             const TurnCosts& stepCosts,
+                             const BitArray2D<m, n>* avoid)
+{
+    static_assert(MazeT::rows == m && MazeT::cols == n, "maze sizes differ");
+    TRACE_SCOPE("turn_search");
+
+    path.clear();
+
+    if (goals.get(start.i, start.j))
+    {
+        best = 0.f;
+        path.push(start);
+        return true;
+    }
+
+    for (int s = 0; s < states; ++s)
+        position[s] = -1;
+    heapSize = 0;
+
+    for (int h = 0; h < 4; ++h)
+    {
+        if (stepCosts.startHeadings & (1u << h))
+        {
+            int s = 4 * (start.i + start.j * m) + h;
+            prevHeading[s] = h;
+            push(s, 0.f);
+        }
+    }
+
+    while (heapSize > 0)
+    {
+        int s = pop();
+        int heading = s % 4;
+        int c = s / 4;
+        Node v = {c % m, c / m};
+
+        ++work.expanded;
+
+        if (goals.get(v.i, v.j))
+        {
+            best = costs[s];
+
+            // Walk the headings back to the start
+            for (;;)
+            {
+                path.push(v);
+                if (v == start)
+                    break;
+
+                int h = s % 4;
+                int from = prevHeading[s];
+                if (0 == h)
+                    --v.i;
+                else if (1 == h)
+                    --v.j;
+                else if (2 == h)
+                    ++v.i;
+                else
+                    ++v.j;
+                s = 4 * (v.i + v.j * m) + from;
+            }
+
+            return true;
+        }
+
+        auto cw = maze.getCellWalls(v.i, v.j);
+
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            if (cw[wall])
+                continue;
+
+            Node u = v;
+            if (0 == wall)
+                ++u.i;
+            else if (1 == wall)
+                ++u.j;
+            else if (2 == wall)
+                --u.i;
+            else
+                --u.j;
+
+            if (avoid && avoid->get(u.i, u.j) && !goals.get(u.i, u.j))
+                continue;
+
+            float step = stepCosts.turn;
+            if (wall == heading)
+                step = stepCosts.straight;
+            else if (wall == (heading + 2) % 4)
+                step = stepCosts.uTurn;
+
+            int t = 4 * (u.i + u.j * m) + wall;
+            if (position[t] == -2)
+                continue;
+
+            if (position[t] == -1 || costs[s] + step < costs[t])
+            {
+                prevHeading[t] = heading;
+                push(t, costs[s] + step);
+            }
+        }
+    }
+
+    return false;
+}
+
+
+template<int m, int n>
+void TurnSearch<m, n>::push(int s, float c)
+{
+    costs[s] = c;
+
+    if (position[s] < 0)
+    {
+        position[s] = heapSize;
+        heap[heapSize++] = s;
+    }
+
+    siftUp(position[s]);
+}
+
+
+template<int m, int n>
+int TurnSearch<m, n>::pop()
+{
+    int s = heap[0];
+    position[s] = -2;
+
+    if (--heapSize > 0)
+    {
+        heap[0] = heap[heapSize];
+        position[heap[0]] = 0;
+        siftDown(0);
+    }
+
+    return s;
+}
+
+
+template<int m, int n>
+void TurnSearch<m, n>::siftUp(int k)
+{
+    int s = heap[k];
+
+    while (k > 0 && costs[heap[(k - 1) / 2]] > costs[s])
+    {
+        heap[k] = heap[(k - 1) / 2];
+        position[heap[k]] = k;
+        k = (k - 1) / 2;
+    }
+
+    heap[k] = s;
+    position[s] = k;
+}
+
+
+template<int m, int n>
+void TurnSearch<m, n>::siftDown(int k)
+{
+    int s = heap[k];
+
+    for (;;)
+    {
+        int child = 2 * k + 1;
+        if (child >= heapSize)
+            break;
+        if (child + 1 < heapSize && costs[heap[child + 1]] < costs[heap[child]])
+            ++child;
+        if (costs[heap[child]] >= costs[s])
+            break;
+
+        heap[k] = heap[child];
+        position[heap[k]] = k;
+        k = child;
+    }
+
+    heap[k] = s;
+    position[s] = k;
+}
+
+
+template<int m, int n>
+bool turnSearch(const Maze<m, n>& maze,
+                Node start,
+                Node goal,
+                NodeStack<m, n>& path,
+                const TurnCosts& costs)
+{
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+    return turnSearch(maze, start, goals, path, costs);
+}
+
+
+template<int m, int n>
+bool turnSearch(const Maze<m, n>& maze,
+                Node start,
+                const BitArray2D<m, n>& goals,
+                NodeStack<m, n>& path,
+                const TurnCosts& costs)
+{
+#ifdef MAZE_EMBEDDED
+    static TurnSearch<m, n> search;
+    return search.solve(maze, start, goals, path, costs);
+#else
+    // The state arrays are too large for the stack on big mazes
+    std::unique_ptr<TurnSearch<m, n>> search(new TurnSearch<m, n>);
+    return search->solve(maze, start, goals, path, costs);
+#endif
+}
+
+#endif // TURNSEARCH_HPP
@@ -0,0 +1,132 @@
+#ifndef WALLMAP_HPP
+#define WALLMAP_HPP
+
+#include <array>
+#include <cstring>
+#include "Maze.hpp"
+#include "WallStorage.hpp"
+
+
+/* What a mouse knows about the walls of a maze: each wall is known to be
+ * there, known to be open, or unknown.
+ *
+ * The three states are kept as two mazes that differ only in the unknown
+ * walls. The optimistic maze has them open and the pessimistic maze has
+ * them closed, so any search that runs on a Maze can run on either:
+ * distances in the optimistic maze are lower bounds and distances in the
+ * pessimistic maze upper bounds of the true ones. When the two agree
+ * between two cells, no unknown wall can give a shorter path.
+ *
+ * The border walls are always known.
+ *
+ * Storage is the wall layout of the mazes. With CellWalls the map is a
+ * single maze instead, whose known nibbles tell the unknown walls apart: the
+ * maze is the optimistic view, as unknown walls are stored open, and a
+ * ClosedView of it the pessimistic one, so sensing a cell writes one maze
+ * and both views read a cell with one byte load.
+ */
+enum class WallState
+{
+    Unknown,
+    Open,
+    Closed
+};
+
+
+template<int m, int n, class Storage = PlaneWalls<m, n>>
+class WallMap
+{
+public:
+    WallMap() { clear(); }
+
+    // Forgets every wall except the border
+    void clear()
+    {
+        best.clear();
+        worst.fill();
+    }
+
+    // Records the true walls around a cell, which makes all four known
+    void sense(int i, int j, std::array<bool, 4> cw)
+    {
+        best.setCellWalls(i, j, cw);
+        worst.setCellWalls(i, j, cw);
+    }
+
+    WallState get(int i, int j, int wall) const
+    {
+        bool open = !best.getCellWalls(i, j)[wall];
+        bool closed = worst.getCellWalls(i, j)[wall];
+        return open == closed ? WallState::Unknown : (open ? WallState::Open : WallState::Closed);
+    }
+
+    const Maze<m, n, Storage>& optimistic() const { return best; }
+    const Maze<m, n, Storage>& pessimistic() const { return worst; }
+
+private:
+    Maze<m, n, Storage> best;  // Unknown walls open
+    Maze<m, n, Storage> worst; // Unknown walls closed
+};
+
+
+// A CellWalls maze with its unknown walls closed. Searches take it like a
+// Maze or a MazeView.
+template<int m, int n>
+class ClosedView
+{
+public:
+    static const int rows = m;
+    static const int cols = n;
+
+    explicit ClosedView(const Maze<m, n, CellWalls<m, n>>& maze) : map(&maze) {}
+
+    std::array<bool, 4> getCellWalls(int i, int j) const { return map->getClosedWalls(i, j); }
+
+    // The bytes of Maze::saveBytes() for the walls of the view
+    void saveBytes(unsigned char* bytes) const;
+
+private:
+    const Maze<m, n, CellWalls<m, n>>* map;
+};
+
+
+template<int m, int n>
+class WallMap<m, n, CellWalls<m, n>>
+{
+public:
+    WallMap() { clear(); }
+
+    void clear() { map.forgetWalls(); }
+
+    void sense(int i, int j, std::array<bool, 4> cw) { map.setCellWalls(i, j, cw); }
+
+    WallState get(int i, int j, int wall) const
+    {
+        if (!map.getKnownWalls(i, j)[wall])
+            return WallState::Unknown;
+        return map.getCellWalls(i, j)[wall] ? WallState::Closed : WallState::Open;
+    }
+
+    const Maze<m, n, CellWalls<m, n>>& optimistic() const { return map; }
+    ClosedView<m, n> pessimistic() const { return ClosedView<m, n>(map); }
+
+private:
+    Maze<m, n, CellWalls<m, n>> map; // Unknown walls open and not known
+};
+
+
+template<int m, int n>
+void ClosedView<m, n>::saveBytes(unsigned char* bytes) const
+{
+    const int mBytes = ((m - 1) * n + 7) / 8;
+    std::memset(bytes, 0, Maze<m, n>::byteCount);
+
+    for (int b = 0; b < (m - 1) * n; ++b)
+        bytes[b / 8] |= map->getClosedWalls(b % (m - 1), b / (m - 1))[0] << (b % 8);
+
+    bytes += mBytes;
+    for (int b = 0; b < m * (n - 1); ++b)
+        bytes[b / 8] |= map->getClosedWalls(b % m, b / m)[1] << (b % 8);
+}
+
+#endif // WALLMAP_HPP
@@ -0,0 +1,305 @@
+#ifndef WALLSTORAGE_HPP
+#define WALLSTORAGE_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include "BitArray2D.hpp"
+
+
+/* Storage layouts for the walls of a Maze, selected by its third template
+ * parameter.
+ *
+ * PlaneWalls (the default) keeps every wall once, in two bit planes: the
+ * walls between (i, j) and (i + 1, j) and the walls between (i, j) and
+ * (i, j + 1). It is compact, and searches that work a word at a time
+ * (Wavefront, the generators, the canonical form) read the planes directly.
+ * getCellWalls assembles the four walls of a cell from four bits.
+ *
+ * CellWalls keeps one byte per cell: the low nibble holds the four walls of
+ * the cell, border walls included, in the order of getCellWalls, and the
+ * high nibble which of them are known. Each inner wall is stored twice, once
+ * in each of its cells, so getCellWalls is one byte load and a lookup in
+ * the 16-entry table below, and setting a wall writes two bytes. The planes
+ * are rebuilt when asked for, so prefer it for mazes that are mostly read a
+ * cell at a time: the truth maze a simulation senses, or mazes that bfs()
+ * runs on many times.
+ *
+ * Every wall the Maze sets is known. Maze::forgetWalls() opens all inner
+ * walls and makes them unknown, and Maze::getClosedWalls() reads a cell with
+ * its unknown walls closed, from the same byte; only CellWalls has them. A
+ * WallMap kept in one CellWalls maze uses them for both of its views (see
+ * WallMap.hpp).
+ *
+ * Both layouts read and write the bytes of Maze::saveBytes() and give the
+ * same Maze::hash(), so mazes convert between them through those bytes and
+ * save() and load() are unchanged.
+ */
+template<int m, int n>
+class PlaneWalls
+{
+public:
+    typedef const BitArray2D<m - 1, n>& MPlane;
+    typedef const BitArray2D<m, n - 1>& NPlane;
+
+    // The walls around (i, j), which is inside the maze
+    std::array<bool, 4> cell(int i, int j) const
+    {
+        std::array<bool, 4> cw = {
+            (m - 1 == i) || mWalls.get(i, j),
+            (n - 1 == j) || nWalls.get(i, j),
+            (0 == i) || mWalls.get(i - 1, j),
+            (0 == j) || nWalls.get(i, j - 1) };
+
+        return cw;
+    }
+
+    // Sets a wall between two cells of the maze
+    void set(int i, int j, int wall, bool b)
+    {
+        if (0 == wall)
+            mWalls.set(i, j, b);
+        else if (1 == wall)
+            nWalls.set(i, j, b);
+        else if (2 == wall)
+            mWalls.set(i - 1, j, b);
+        else
+            nWalls.set(i, j - 1, b);
+    }
+
+    void setAll(bool b)
+    {
+        mWalls.setAll(b);
+        nWalls.setAll(b);
+    }
+
+    void loadBytes(const unsigned char* bytes);
+    void saveBytes(unsigned char* bytes) const;
+    std::uint64_t hash() const;
+
+    const BitArray2D<m - 1, n>& getMWalls() const { return mWalls; }
+    const BitArray2D<m, n - 1>& getNWalls() const { return nWalls; }
+
+private:
+    BitArray2D<m - 1, n> mWalls;
+    BitArray2D<m, n - 1> nWalls;
+};
+
+
+// The walls of a nibble as in getCellWalls
+const std::array<bool, 4> nibbleWalls[16] = {
+    {{false, false, false, false}}, {{true, false, false, false}},
+    {{false, true, false, false}}, {{true, true, false, false}},
+    {{false, false, true, false}}, {{true, false, true, false}},
+    {{false, true, true, false}}, {{true, true, true, false}},
+    {{false, false, false, true}}, {{true, false, false, true}},
+    {{false, true, false, true}}, {{true, true, false, true}},
+    {{false, false, true, true}}, {{true, false, true, true}},
+    {{false, true, true, true}}, {{true, true, true, true}} };
+
+
+template<int m, int n>
+class CellWalls
+{
+public:
+    typedef BitArray2D<m - 1, n> MPlane;
+    typedef BitArray2D<m, n - 1> NPlane;
+
+    std::array<bool, 4> cell(int i, int j) const { return nibbleWalls[data[i + j * m] & 0xf]; }
+    std::array<bool, 4> known(int i, int j) const { return nibbleWalls[data[i + j * m] >> 4]; }
+
+    // The walls of (i, j) that are there or not known
+    std::array<bool, 4> closed(int i, int j) const
+    {
+        unsigned char b = data[i + j * m];
+        return nibbleWalls[(b | ~b >> 4) & 0xf];
+    }
+
+    // Sets a wall between two cells of the maze in both of them
+    void set(int i, int j, int wall, bool b)
+    {
+        const int step[4] = {1, m, -1, -m};
+        int c = i + j * m;
+        int back = (wall + 2) % 4;
+        unsigned char& here = data[c];
+        unsigned char& there = data[c + step[wall]];
+
+        here = (here & ~(1 << wall)) | b << wall | 0x10 << wall;
+        there = (there & ~(1 << back)) | b << back | 0x10 << back;
+    }
+
+    // Every inner wall set to b and known
+    void setAll(bool b);
+
+    // Every inner wall open and unknown
+    void forget();
+
+    void loadBytes(const unsigned char* bytes);
+    void saveBytes(unsigned char* bytes) const;
+    std::uint64_t hash() const;
+
+    BitArray2D<m - 1, n> getMWalls() const;
+    BitArray2D<m, n - 1> getNWalls() const;
+
+private:
+    static const int mBytes = ((m - 1) * n + 7) / 8;
+    static const int nBytes = (m * (n - 1) + 7) / 8;
+
+    // The border walls of (i, j), which are always there and known
+    static unsigned char border(int i, int j)
+    {
+        unsigned char b = (m - 1 == i) | (n - 1 == j) << 1 | (0 == i) << 2 | (0 == j) << 3;
+        return b | b << 4;
+    }
+
+    // Byte k of each plane as in PlaneWalls, with the unused bits clear
+    unsigned char mByte(int k) const;
+    unsigned char nByte(int k) const;
+
+    unsigned char data[m * n];
+};
+
+
+// The planes are byte arrays in the order of the saved bytes
+template<int m, int n>
+void PlaneWalls<m, n>::loadBytes(const unsigned char* bytes)
+{
+    std::memcpy(&mWalls[0], bytes, mWalls.size());
+    std::memcpy(&nWalls[0], bytes + mWalls.size(), nWalls.size());
+}
+
+
+template<int m, int n>
+void PlaneWalls<m, n>::saveBytes(unsigned char* bytes) const
+{
+    for (int i = 0; i < mWalls.size(); ++i)
+        *bytes++ = mWalls[i];
+    for (int i = 0; i < nWalls.size(); ++i)
+        *bytes++ = nWalls[i];
+}
+
+
+// FNV-1a over both wall planes. The unused bits at the end of each plane are
+// masked off, since fill() and load() can set them.
+template<int m, int n>
+std::uint64_t PlaneWalls<m, n>::hash() const
+{
+    std::uint64_t h = 14695981039346656037ull;
+
+    for (int i = 0; i < mWalls.size(); ++i)
+    {
+        int bits = (m - 1) * n - 8 * i;
+        unsigned char b = bits < 8 ? mWalls[i] & ((1 << bits) - 1) : mWalls[i];
+        h = (h ^ b) * 1099511628211ull;
+    }
+
+    for (int i = 0; i < nWalls.size(); ++i)
+    {
+        int bits = m * (n - 1) - 8 * i;
+        unsigned char b = bits < 8 ? nWalls[i] & ((1 << bits) - 1) : nWalls[i];
+        h = (h ^ b) * 1099511628211ull;
+    }
+
+    return h;
+}
+
+
+template<int m, int n>
+void CellWalls<m, n>::setAll(bool b)
+{
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < m; ++i)
+            data[i + j * m] = b ? 0xff : border(i, j) | 0xf0;
+}
+
+
+template<int m, int n>
+void CellWalls<m, n>::forget()
+{
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < m; ++i)
+            data[i + j * m] = border(i, j);
+}
+
+
+template<int m, int n>
+void CellWalls<m, n>::loadBytes(const unsigned char* bytes)
+{
+    setAll(false);
+
+    for (int b = 0; b < (m - 1) * n; ++b)
+        if (bytes[b / 8] >> (b % 8) & 1)
+            set(b % (m - 1), b / (m - 1), 0, true);
+
+    bytes += mBytes;
+    for (int b = 0; b < m * (n - 1); ++b)
+        if (bytes[b / 8] >> (b % 8) & 1)
+            set(b % m, b / m, 1, true);
+}
+
+
+template<int m, int n>
+void CellWalls<m, n>::saveBytes(unsigned char* bytes) const
+{
+    for (int k = 0; k < mBytes; ++k)
+        *bytes++ = mByte(k);
+    for (int k = 0; k < nBytes; ++k)
+        *bytes++ = nByte(k);
+}
+
+
+// The same FNV-1a as PlaneWalls::hash()
+template<int m, int n>
+std::uint64_t CellWalls<m, n>::hash() const
+{
+    std::uint64_t h = 14695981039346656037ull;
+
+    for (int k = 0; k < mBytes; ++k)
+        h = (h ^ mByte(k)) * 1099511628211ull;
+    for (int k = 0; k < nBytes; ++k)
+        h = (h ^ nByte(k)) * 1099511628211ull;
+
+    return h;
+}
+
+
+template<int m, int n>
+BitArray2D<m - 1, n> CellWalls<m, n>::getMWalls() const
+{
+    BitArray2D<m - 1, n> plane;
+    for (int k = 0; k < mBytes; ++k)
+        plane[k] = mByte(k);
+    return plane;
+}
+
+
+template<int m, int n>
+BitArray2D<m, n - 1> CellWalls<m, n>::getNWalls() const
+{
+    BitArray2D<m, n - 1> plane;
+    for (int k = 0; k < nBytes; ++k)
+        plane[k] = nByte(k);
+    return plane;
+}
+
+
+template<int m, int n>
+unsigned char CellWalls<m, n>::mByte(int k) const
+{
+    unsigned char byte = 0;
+    for (int b = 8 * k; b < 8 * k + 8 && b < (m - 1) * n; ++b)
+        byte |= (data[b % (m - 1) + b / (m - 1) * m] & 1) << (b % 8);
+    return byte;
+}
+
+
+template<int m, int n>
+unsigned char CellWalls<m, n>::nByte(int k) const
+{
+    unsigned char byte = 0;
+    for (int b = 8 * k; b < 8 * k + 8 && b < m * (n - 1); ++b)
+        byte |= (data[b] >> 1 & 1) << (b % 8);
+    return byte;
+}
+
+#endif // WALLSTORAGE_HPP
@@ -0,0 +1,448 @@
+#ifndef WAVEFRONT_HPP
+#define WAVEFRONT_HPP
+
+#include <cstdint>
+#include "Maze.hpp"
+#include "BitArray2D.hpp"
+#include "BFS.hpp"
+
+
+/* Bit-parallel breadth first search.
+ *
+ * The maze is converted once into bitboards with one 64-bit word per column
+ * per 64 rows: bit i of column j is cell (i, j). A whole BFS level is then
+ * advanced with a few shifts, ands and ors per column instead of one
+ * getCellWalls call per cell:
+ *     down  = (F[j] & south[j]) << 1
+ *     up    = (F[j] >> 1) & south[j]
+ *     right = F[j] & east[j]        (into column j + 1)
+ *     left  = F[j] & east[j - 1]    (into column j - 1)
+ * Only columns next to the current frontier are touched, so long narrow
+ * frontiers cost no more than the columns they occupy.
+ *
+ * The distance of every cell reached is recorded level by level, which gives
+ * the distance field and lets a shortest path be read back from any reached
+ * cell. wavefront() has the same interface as bfs().
+ *
+ * When only reachability is needed, reach() does not advance level by level:
+ * it closes each column over its vertical passages with a logarithmic
+ * (Kogge-Stone) fill and only revisits a column when a neighbouring column
+ * adds cells to it.
+ */
+
+
+template<int m, int n>
+class WallBoard
+{
+public:
+    typedef std::uint64_t Word;
+    static const int words = (m + 63) / 64;
+
+    WallBoard() {}
+    explicit WallBoard(const Maze<m, n>& maze) { build(maze); }
+
+    void build(const Maze<m, n>& maze);
+
+    // south[j][w] bit b: cell (64w + b, j) is open towards +i
+    // east[j][w] bit b: cell (64w + b, j) is open towards +j
+    Word south[n][words];
+    Word east[n][words];
+};
+
+
+template<int m, int n>
+class Wavefront
+{
+public:
+    typedef std::uint64_t Word;
+    static const int words = WallBoard<m, n>::words;
+
+    // Expands level by level from start until a level reaches one of the
+    // goals, or until every reachable cell is found if goals is null.
+    // Returns true if a goal was reached.
+    bool solve(const WallBoard<m, n>& board, Node start, const BitArray2D<m, n>* goals);
+
+    // Finds every cell reachable from start without computing distances.
+    // Returns the number of reachable cells; distance() is not valid after.
+    int reach(const WallBoard<m, n>& board, Node start);
+
+    bool reached(int i, int j) const { return (visited[j][i / 64] >> (i % 64)) & 1; }
+    int distance(int i, int j) const { return reached(i, j) ? int(dist[i + j * m]) : -1; }
+    int reachedCount() const;
+    Node goalReached() const { return found; }
+
+    // Reconstructs a shortest path from the start of the last solve to a
+    // reached cell, in the same order as bfs() returns it.
+    bool path(const WallBoard<m, n>& board, Node to, NodeStack<m, n>& path) const;
+
+private:
+    typedef typename PackedType<bitsFor(m * n)>::type Distance;
+
+    void activate(int j);
+    bool fillColumn(const WallBoard<m, n>& board, int j);
+
+    Word visited[n][words];
+    Word frontier[n][words];
+    Word next[n][words];
+    Word goalBoard[n][words];
+    Distance dist[m * n];
+
+    // Columns holding frontier cells, and candidates for the next level
+    int active[n];
+    int activeCount;
+    int candidates[n];
+    int candidateCount;
+    bool isCandidate[n];
+
+    Node found;
+};
+
+
+template<int m, int n>
+bool wavefront(const Maze<m, n>& maze,
+               Node start,
+               Node goal,
+               NodeStack<m, n>& path);
+
+template<int m, int n>
+bool wavefront(const Maze<m, n>& maze,
+               Node start,
+               const BitArray2D<m, n>& goals,
+               NodeStack<m, n>& path);
+
+
+template<int m, int n>
+void WallBoard<m, n>::build(const Maze<m, n>& maze)
+{
+    const BitArray2D<m - 1, n>& mWalls = maze.getMWalls();
+    const BitArray2D<m, n - 1>& nWalls = maze.getNWalls();
+
+    for (int j = 0; j < n; ++j)
+    {
+        for (int w = 0; w < words; ++w)
+        {
+            int first = 64 * w;
+            int rows = m - first < 64 ? m - first : 64;
+            Word all = rows < 64 ? (Word(1) << rows) - 1 : ~Word(0);
+
+            // The last row has the border below it
+            int inner = (m - 1) - first < rows ? (m - 1) - first : rows;
+            Word s = inner > 0 ? mWalls.getBits(first + j * (m - 1), inner) : 0;
+            south[j][w] = ~s & (inner < 64 ? (Word(1) << inner) - 1 : ~Word(0));
+
+            if (j < n - 1)
+                east[j][w] = ~nWalls.getBits(first + j * m, rows) & all;
+            else
+                east[j][w] = 0;
+        }
+    }
+}
+
+
+template<int m, int n>
+void Wavefront<m, n>::activate(int j)
+{
+    if (j < 0 || j >= n || isCandidate[j])
+        return;
+
+    isCandidate[j] = true;
+    candidates[candidateCount++] = j;
+}
+
+
+template<int m, int n>
+bool Wavefront<m, n>::solve(const WallBoard<m, n>& board, Node start, const BitArray2D<m, n>* goals)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        isCandidate[j] = false;
+        for (int w = 0; w < words; ++w)
+        {
+            visited[j][w] = 0;
+            frontier[j][w] = 0;
+            next[j][w] = 0;
+            goalBoard[j][w] = 0;
+            if (goals)
+            {
+                int rows = m - 64 * w < 64 ? m - 64 * w : 64;
+                goalBoard[j][w] = goals->getBits(64 * w + j * m, rows);
+            }
+        }
+    }
+
+    Word startBit = Word(1) << (start.i % 64);
+    visited[start.j][start.i / 64] = startBit;
+    frontier[start.j][start.i / 64] = startBit;
+    dist[start.i + start.j * m] = 0;
+    active[0] = start.j;
+    activeCount = 1;
+
+    if (goalBoard[start.j][start.i / 64] & startBit)
+    {
+        found = start;
+        return true;
+    }
+
+    for (int level = 1; activeCount > 0; ++level)
+    {
+        candidateCount = 0;
+
+        // Spread every frontier column one step in each direction
+        for (int k = 0; k < activeCount; ++k)
+        {
+            int j = active[k];
+            Word carryDown = 0;
+
+            for (int w = 0; w < words; ++w)
+            {
+                Word f = frontier[j][w];
+                Word down = (f & board.south[j][w]) << 1 | carryDown;
+                carryDown = (f & board.south[j][w]) >> 63;
+
+                Word fromBelow = w + 1 < words ? frontier[j][w + 1] << 63 : 0;
+                Word up = (f >> 1 | fromBelow) & board.south[j][w];
+
+                next[j][w] |= down | up;
+
+                if (j + 1 < n)
+                    next[j + 1][w] |= f & board.east[j][w];
+                if (j > 0)
+                    next[j - 1][w] |= f & board.east[j - 1][w];
+            }
+
+            activate(j - 1);
+            activate(j);
+            activate(j + 1);
+        }
+
+        for (int k = 0; k < activeCount; ++k)
+            for (int w = 0; w < words; ++w)
+                frontier[active[k]][w] = 0;
+
+        // Keep the new cells of each candidate column as the next frontier
+        activeCount = 0;
+        bool hit = false;
+
+        for (int k = 0; k < candidateCount; ++k)
+        {
+            int j = candidates[k];
+            bool any = false;
+            isCandidate[j] = false;
+
+            for (int w = 0; w < words; ++w)
+            {
+                Word fresh = next[j][w] & ~visited[j][w];
+                next[j][w] = 0;
+                frontier[j][w] = fresh;
+
+                if (!fresh)
+                    continue;
+
+                any = true;
+                visited[j][w] |= fresh;
+
+                if (!hit && (fresh & goalBoard[j][w]))
+                {
+                    hit = true;
+                    found = {64 * w + __builtin_ctzll(fresh & goalBoard[j][w]), j};
+                }
+
+                for (Word bits = fresh; bits; bits &= bits - 1)
+                    dist[64 * w + __builtin_ctzll(bits) + j * m] = Distance(level);
+            }
+
+            if (any)
+                active[activeCount++] = j;
+        }
+
+        if (hit)
+            return true;
+    }
+
+    return false;
+}
+
+
+// Spreads the visited cells of column j over its vertical passages. Returns
+// true if any cell was added.
+template<int m, int n>
+bool Wavefront<m, n>::fillColumn(const WallBoard<m, n>& board, int j)
+{
+    bool added = false;
+    bool changed = true;
+
+    while (changed)
+    {
+        changed = false;
+
+        for (int w = 0; w < words; ++w)
+        {
+            Word gen = visited[j][w];
+
+            // A cell can be entered from above if the cell above is open
+            // towards +i, and from below if it is open towards +i itself
+            Word pro = board.south[j][w] << 1;
+            gen |= pro & (gen << 1);  pro &= pro << 1;
+            gen |= pro & (gen << 2);  pro &= pro << 2;
+            gen |= pro & (gen << 4);  pro &= pro << 4;
+            gen |= pro & (gen << 8);  pro &= pro << 8;
+            gen |= pro & (gen << 16); pro &= pro << 16;
+            gen |= pro & (gen << 32);
+
+            pro = board.south[j][w];
+            gen |= pro & (gen >> 1);  pro &= pro >> 1;
+            gen |= pro & (gen >> 2);  pro &= pro >> 2;
+            gen |= pro & (gen >> 4);  pro &= pro >> 4;
+            gen |= pro & (gen >> 8);  pro &= pro >> 8;
+            gen |= pro & (gen >> 16); pro &= pro >> 16;
+            gen |= pro & (gen >> 32);
+
+            // Carry across the boundaries with the neighbouring words
+            if (w + 1 < words && (gen & board.south[j][w]) >> 63 && !(visited[j][w + 1] & 1))
+            {
+                visited[j][w + 1] |= 1;
+                changed = true;
+            }
+            if (w > 0 && (gen & 1) && (board.south[j][w - 1] >> 63) && !(visited[j][w - 1] >> 63))
+            {
+                visited[j][w - 1] |= Word(1) << 63;
+                changed = true;
+            }
+
+            if (gen != visited[j][w])
+            {
+                visited[j][w] = gen;
+                added = true;
+            }
+        }
+    }
+
+    return added;
+}
+
+
+template<int m, int n>
+int Wavefront<m, n>::reach(const WallBoard<m, n>& board, Node start)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        isCandidate[j] = false;
+        for (int w = 0; w < words; ++w)
+            visited[j][w] = 0;
+    }
+
+    visited[start.j][start.i / 64] = Word(1) << (start.i % 64);
+    candidateCount = 0;
+    activate(start.j);
+
+    // Columns whose visited cells have not been spread sideways yet
+    while (candidateCount > 0)
+    {
+        int j = candidates[--candidateCount];
+        isCandidate[j] = false;
+
+        fillColumn(board, j);
+
+        for (int w = 0; w < words; ++w)
+        {
+            if (j + 1 < n)
+            {
+                Word add = visited[j][w] & board.east[j][w] & ~visited[j + 1][w];
+                if (add)
+                {
+                    visited[j + 1][w] |= add;
+                    activate(j + 1);
+                }
+            }
+            if (j > 0)
+            {
+                Word add = visited[j][w] & board.east[j - 1][w] & ~visited[j - 1][w];
+                if (add)
+                {
+                    visited[j - 1][w] |= add;
+                    activate(j - 1);
+                }
+            }
+        }
+    }
+
+    return reachedCount();
+}
+
+
+template<int m, int n>
+int Wavefront<m, n>::reachedCount() const
+{
+    int count = 0;
+    for (int j = 0; j < n; ++j)
+        for (int w = 0; w < words; ++w)
+            count += __builtin_popcountll(visited[j][w]);
+    return count;
+}
+
+
+template<int m, int n>
+bool Wavefront<m, n>::path(const WallBoard<m, n>& board, Node to, NodeStack<m, n>& path) const
+{
+    path.clear();
+
+    if (!reached(to.i, to.j))
+        return false;
+
+    // Walk back from the end, always to a neighbour one level closer
+    Node v = to;
+    path.push(v);
+
+    for (int d = distance(v.i, v.j); d > 0; --d)
+    {
+        int w = v.i / 64;
+        Word bit = Word(1) << (v.i % 64);
+
+        if (v.i > 0 && distance(v.i - 1, v.j) == d - 1 &&
+            (board.south[v.j][(v.i - 1) / 64] >> ((v.i - 1) % 64) & 1))
+            --v.i;
+        else if (v.i < m - 1 && distance(v.i + 1, v.j) == d - 1 && (board.south[v.j][w] & bit))
+            ++v.i;
+        else if (v.j > 0 && distance(v.i, v.j - 1) == d - 1 && (board.east[v.j - 1][w] & bit))
+            --v.j;
+        else
+            ++v.j;
+
+        path.push(v);
+    }
+
+    return true;
+}
+
+
+template<int m, int n>
+bool wavefront(const Maze<m, n>& maze,
+               Node start,
+               Node goal,
+               NodeStack<m, n>& path)
+{
+    BitArray2D<m, n> goals;
+    goals.set(goal.i, goal.j, true);
+    return wavefront(maze, start, goals, path);
+}
+
+
+template<int m, int n>
+bool wavefront(const Maze<m, n>& maze,
+               Node start,
+               const BitArray2D<m, n>& goals,
+               NodeStack<m, n>& path)
+{
+    WallBoard<m, n> board(maze);
+    Wavefront<m, n> search;
+
+    if (!search.solve(board, start, &goals))
+    {
+        path.clear();
+        return false;
+    }
+
+    return search.path(board, search.goalReached(), path);
+}
+
+#endif // WAVEFRONT_HPP
@@ -1,12 +1,23 @@
 #include <SFML/Graphics.hpp>
 #include <SFML/System.hpp>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <ctime>
+#include <cstdio>
 #include <cstdlib>
 #include "Maze.hpp"
+#include "MazeDraw.hpp"
 #include "BitArray2D.hpp"
 #include "BFS.hpp"
+#include "Simulator.hpp"
+#include "PathCache.hpp"
+#include "Generator.hpp"
+#include "History.hpp"
+#include "Recording.hpp"
+#include "SpeedRun.hpp"
+#include "Analysis.hpp"
+#include "Trace.hpp"
 
 
 sf::RenderWindow window(sf::VideoMode(256, 256), "Maze");
@@ -14,32 +25,66 @@ sf::RenderWindow window(sf::VideoMode(256, 256), "Maze");
 const int msize = 16;
 const int nsize = 16;
 Maze<msize, nsize> maze;
-Maze<msize, nsize> undoMaze;
-Maze<msize, nsize> discoveredMaze;
-BitArray2D<msize, nsize> unvisitedNodes;
-BitArray2D<msize, nsize> inferredNodes;
-BitArray2D<msize, nsize> OptimumNodes;
+MazeHistory<msize, nsize> history;
+Simulator<msize, nsize> sim;
+RunRecording<msize, nsize> recording;
+PathCache<msize, nsize> pathCache;
+SpeedRunPlanner<msize, nsize> runPlanner;
+MazeAnalyzer<msize, nsize> analyzer;
+MazeMesh<msize, nsize> mazeMesh;
+MazeMesh<msize, nsize> discoveredMesh;
 
 Node cursor;
 Node mark;
-Node Start;
-Node CurrentIdeal;
 bool markSet = false;
 
-NodeStack bfsPath;
-NodeStack bfsFinal;
+NodeStack<msize, nsize> bfsPath;
 bool showBfs = false;
-bool runSim = false;
-bool mapping = false;
-bool optimize = false;
+double simSpeed = 1.0;
 sf::Clock clk;
-
+MazeAlgorithm algorithm = MazeAlgorithm::Micromouse;
+std::uint64_t seed = 0;
+
+// The frame is only redrawn when something on screen may have changed, and
+// the displayed path only looked up again when its inputs changed
+bool dirty = true;
+bool pathValid = false;
+Node pathFrom;
+Node pathTo;
+std::uint64_t pathMaze = 0;
+
+// The fastest speed run from runFrom to the mark, shown while the maze is
+// the one it was planned on
+bool showRun = false;
+Node runFrom;
+std::uint64_t runMaze = 0;
+
+// Time taken by the last update() and draw(), shown as bars along the bottom
+// of the window and in the title when showTimes is set
+bool showTimes = false;
+float updateMs = 0.f;
+float drawMs = 0.f;
+
+// Replay of a recorded run: playing backward (-1), paused (0) or forward
+// (1), two steps per second at 1x like the simulation
+RunRecording<msize, nsize> replay;
+bool replaying = false;
+int replayDirection = 0;
+double replayPending = 0.0;
+
+void handleEvent(const sf::Event& event);
+bool handleReplayKey(sf::Keyboard::Key key);
 void update();
 void draw();
+void drawRun(const Maze<msize, nsize>& truth, const Maze<msize, nsize>& discovered,
+             const BitArray2D<msize, nsize>* unvisited, const BitArray2D<msize, nsize>* inferred);
+void drawTimes();
+void render(const sf::Drawable& drawable);
 void bfs();
+void planRun();
+void printAnalysis();
 bool loadMaze(Maze<16, 16>& maze);
 void saveMaze(Maze<16, 16> maze);
-float ScorePath(NodeStack Path);
 
 int coerce(int a, int l, int u)
 {
@@ -47,21 +92,44 @@ int coerce(int a, int l, int u)
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
-    std::srand(std::time(0));
+    // The seed of the generator; pass one to repeat a session
+    seed = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : std::uint64_t(std::time(0));
+    std::srand(unsigned(seed));
+    std::cout << "Seed " << seed << std::endl;
+    sim.setRecording(&recording);
     
     // Load default maze
     maze.load("16:16:28802a48080a1a16645d54fd502a165999055c2e355b156fad1acd82a054:04ff96576e952e4bfc0ac88f804964aaac55848b4c06062a2a554cad4e9a");
+    history.reset(maze);
 
     cursor.i = msize - 1;
     
     while (window.isOpen())
     {
+        // Sleep until something happens unless a simulation or replay is
+        // running
+        if (!sim.running() && replayDirection == 0 && !dirty)
+        {
+            sf::Event event;
+            if (window.waitEvent(event))
+                handleEvent(event);
+        }
+
+        sf::Clock frame;
         update();
-        draw();
+        updateMs = frame.restart().asMicroseconds() / 1000.f;
+
+        if (dirty)
+        {
+            draw();
+            drawMs = frame.restart().asMicroseconds() / 1000.f;
+            dirty = false;
+        }
 
-        sf::sleep(sf::milliseconds(10));
+        if (sim.running() || replayDirection != 0)
+            sf::sleep(sf::milliseconds(10));
     }
 
     return 0;
@@ -70,385 +138,576 @@ int main()
 
 void update()
 {
+    TRACE_SCOPE("update");
     sf::Event event;
 
     // Handle window events
     while (window.pollEvent(event))
-    {
-        switch (event.type)
-        {
-        case sf::Event::Closed:
-            // Needed for close window button to work
-            window.close();
-            break;
-            
-        case sf::Event::KeyPressed:
-            // Handle controls
-            switch (event.key.code)
-            {
-                
-            // Cursor movement
-            case sf::Keyboard::Key::Down:
-                ++cursor.i;
-                cursor.i = coerce(cursor.i, 0, msize - 1);
-                break;
-            case sf::Keyboard::Key::Up:
-                --cursor.i;
-                cursor.i = coerce(cursor.i, 0, msize - 1);
-                break;
-            case sf::Keyboard::Key::Right:
-                ++cursor.j;
-                cursor.j= coerce(cursor.j, 0, nsize - 1);
-                break;
-            case sf::Keyboard::Key::Left:
-                --cursor.j;
-                cursor.j= coerce(cursor.j, 0, nsize - 1);
-                break;
-
-            // Set/unset walls around cursor
-            case sf::Keyboard::Key::S: // Bottom
-                {
-                    auto cw = maze.getCellWalls(cursor.i, cursor.j);
-                    cw[0] = !cw[0];
-                    maze.setCellWalls(cursor.i, cursor.j, cw);
-                }
-                break;
-            case sf::Keyboard::Key::D: // Right
-                {
-                    auto cw = maze.getCellWalls(cursor.i, cursor.j);
-                    cw[1] = !cw[1];
-                    maze.setCellWalls(cursor.i, cursor.j, cw);
-                }
-                break;
-            case sf::Keyboard::Key::W: // Top
-                {
-                    auto cw = maze.getCellWalls(cursor.i, cursor.j);
-                    cw[2] = !cw[2];
-                    maze.setCellWalls(cursor.i, cursor.j, cw);
-                }
-                break;
-            case sf::Keyboard::Key::A: // Left
-                {
-                    auto cw = maze.getCellWalls(cursor.i, cursor.j);
-                    cw[3] = !cw[3];
-                    maze.setCellWalls(cursor.i, cursor.j, cw);
-                }
-                break;
-
-            // Modify maze globally
-            case sf::Keyboard::Key::C:
-                undoMaze = maze;
-                maze.clear();
-                break;
-            case sf::Keyboard::Key::F:
-                undoMaze = maze;
-                maze.fill();
-                break;
-            case sf::Keyboard::Key::R:
-                undoMaze = maze;
-                maze.randomize();
-                break;
-
-            // Undo
-            case sf::Keyboard::Key::U:
-                {
-                    Maze<msize, nsize> tmp = maze;
-                    maze = undoMaze;
-                    undoMaze = tmp;
-                }
-                break;
-
-            // Load/save maze
-            case sf::Keyboard::Key::L:
-                {
-                    Maze<msize, nsize> tmp;
-                    if (loadMaze(tmp))
-                    {
-                        undoMaze = maze;
-                        maze = tmp;
-                    }
-                }
-                break;
-            case sf::Keyboard::Key::V:
-                saveMaze(maze);
-                break;
-
-            // Place mark
-            case sf::Keyboard::Key::Space:
-                if (cursor == mark && markSet)
-                {
-                    markSet = false;
-                }
-                else
-                {
-                    mark = cursor;
-                    markSet = true;
-                }
-                break;
+        handleEvent(event);
 
-            // Show BFS path
-            case sf::Keyboard::Key::B:
-                showBfs = !showBfs;
-                break;
+    if (showBfs && markSet && sim.run() == Simulator<msize, nsize>::Run::None &&
+        !(pathValid && cursor == pathFrom && mark == pathTo && maze.hash() == pathMaze))
+    {
+        // Look up the path for display using the entire maze; the table is
+        // only rebuilt when the maze changes
+        pathCache.path(maze, cursor, mark, bfsPath);
+        pathValid = true;
+        pathFrom = cursor;
+        pathTo = mark;
+        pathMaze = maze.hash();
+        dirty = true;
+    }
 
-            // Run simulation
-            case sf::Keyboard::Key::X:
-                {
-                    runSim = !runSim;
-                    mapping = false;
-                    clk.restart();
-                    discoveredMaze.clear();
-                    auto cw = maze.getCellWalls(cursor.i, cursor.j);
-                    discoveredMaze.setCellWalls(cursor.i, cursor.j, cw);
-                    bfs(discoveredMaze, cursor, mark, bfsPath);
-                }
-                break;
+    if (replaying && replayDirection != 0)
+    {
+        replayPending += clk.restart().asSeconds() * 2.0 * simSpeed;
+        int steps = int(replayPending);
+        replayPending -= steps;
 
-            // Map the maze
-            case sf::Keyboard::Key::M:
-                {
-                    mapping = !mapping;
-                    runSim = false;
-                    Start = cursor;
-                    CurrentIdeal = cursor;
-                    clk.restart();
-                    discoveredMaze.clear();
-                    auto cw = maze.getCellWalls(cursor.i, cursor.j);
-                    discoveredMaze.setCellWalls(cursor.i, cursor.j, cw);
-                    unvisitedNodes.setAll(true);
-                    unvisitedNodes.set(cursor.i, cursor.j, false);
-                    inferredNodes.setAll(false);
-
-                    bfs(discoveredMaze, cursor, unvisitedNodes, bfsPath);
-                }
-                break;
-                
-            default:
-                break;
+        if (steps > 0)
+        {
+            if (!replay.seek(replay.step() + replayDirection * steps))
+            {
+                replay.seek(replayDirection > 0 ? replay.steps() : 0);
+                replayDirection = 0;
             }
-            break;
-        default:
-            break;
+            cursor = replay.position();
+            dirty = true;
         }
     }
-
-    if (showBfs && markSet && !runSim && !mapping)
+    else if (sim.run() != Simulator<msize, nsize>::Run::None)
     {
-        // Run BFS for display using the entire maze
-        bfs(maze, cursor, mark, bfsPath);
+        // Move, sense the walls of the new cell and replan using only the
+        // discovered parts of the maze, as often as the speed allows
+        if (sim.advance(clk.restart().asSeconds()) > 0)
+        {
+            cursor = sim.position();
+            dirty = true;
+        }
+
+        // A finished search goes back to the normal view; the result of a
+        // mapping run stays on screen
+        if (sim.run() == Simulator<msize, nsize>::Run::Search && !sim.running())
+        {
+            sim.stop();
+            dirty = true;
+        }
     }
+}
+
+
+void handleEvent(const sf::Event& event)
+{
+    // Any key may change what is shown, and the window contents may need
+    // to be redrawn after it was covered or resized
+    dirty = true;
 
-    if ((runSim && markSet) || mapping)
+    switch (event.type)
     {
-        // Cursor steps along the BFS path every so often
-        if (clk.getElapsedTime().asSeconds() >= 0.5f)
+    case sf::Event::Closed:
+        // Needed for close window button to work
+        window.close();
+        break;
+        
+    case sf::Event::KeyPressed:
+        if (replaying && handleReplayKey(event.key.code))
+            break;
+
+        // Handle controls
+        switch (event.key.code)
         {
-            clk.restart();
+            
+        // Cursor movement
+        case sf::Keyboard::Key::Down:
+            ++cursor.i;
+            cursor.i = coerce(cursor.i, 0, msize - 1);
+            break;
+        case sf::Keyboard::Key::Up:
+            --cursor.i;
+            cursor.i = coerce(cursor.i, 0, msize - 1);
+            break;
+        case sf::Keyboard::Key::Right:
+            ++cursor.j;
+            cursor.j= coerce(cursor.j, 0, nsize - 1);
+            break;
+        case sf::Keyboard::Key::Left:
+            --cursor.j;
+            cursor.j= coerce(cursor.j, 0, nsize - 1);
+            break;
 
-            if (bfsPath.size() > 0)
-            {
-                bfsPath.pop(); // First node is the current node; remove it
-                cursor = bfsPath.pop(); // Set cursor position to next node
-            }
-                
-            // Sense walls in current cell
-            auto cw = maze.getCellWalls(cursor.i, cursor.j);
-            discoveredMaze.setCellWalls(cursor.i, cursor.j, cw);
+        // Set/unset walls around cursor
+        case sf::Keyboard::Key::S: // Bottom
+            history.setWall(maze, cursor.i, cursor.j, 0,
+                            !maze.getCellWalls(cursor.i, cursor.j)[0]);
+            break;
+        case sf::Keyboard::Key::D: // Right
+            history.setWall(maze, cursor.i, cursor.j, 1,
+                            !maze.getCellWalls(cursor.i, cursor.j)[1]);
+            break;
+        case sf::Keyboard::Key::W: // Top
+            history.setWall(maze, cursor.i, cursor.j, 2,
+                            !maze.getCellWalls(cursor.i, cursor.j)[2]);
+            break;
+        case sf::Keyboard::Key::A: // Left
+            history.setWall(maze, cursor.i, cursor.j, 3,
+                            !maze.getCellWalls(cursor.i, cursor.j)[3]);
+            break;
 
-            // Run BFS using only the discovered parts of the maze
-            if (mapping)
-            {
-                unvisitedNodes.set(cursor.i, cursor.j, false);
+        // Modify maze globally
+        case sf::Keyboard::Key::C:
+            maze.clear();
+            history.commit(maze);
+            break;
+        case sf::Keyboard::Key::F:
+            maze.fill();
+            history.commit(maze);
+            break;
+        case sf::Keyboard::Key::R:
+            generateMaze(maze, algorithm, ++seed);
+            history.commit(maze);
+            std::cout << algorithmName(algorithm) << " maze, seed " << seed << std::endl;
+            break;
+        case sf::Keyboard::Key::G:
+            algorithm = MazeAlgorithm((int(algorithm) + 1) % 4);
+            std::cout << "Generator: " << algorithmName(algorithm) << std::endl;
+            break;
+
+        // Undo/redo, and jump to the start or end of the history
+        case sf::Keyboard::Key::U:
+            history.undo(maze);
+            break;
+        case sf::Keyboard::Key::Y:
+            history.redo(maze);
+            break;
+        case sf::Keyboard::Key::Home:
+            history.jump(maze, 0);
+            break;
+        case sf::Keyboard::Key::End:
+            history.jump(maze, history.size());
+            break;
+        case sf::Keyboard::Key::H:
+            std::cout << "History (" << history.position() << " of "
+                      << history.size() << " edits applied):" << std::endl;
+            history.exportTo(std::cout);
+            break;
 
-                // Infer the contents of a node if all surrounding nodes have been visited
-                for (int i = 0; i < msize; ++i)
+        // Load/save maze
+        case sf::Keyboard::Key::L:
+            {
+                Maze<msize, nsize> tmp;
+                if (loadMaze(tmp))
                 {
-                    for (int j = 0; j < nsize; ++j)
-                    {
-                        if (!unvisitedNodes.get(i, j))
-                            continue;
-
-                        if ((i + 1 >= msize || !unvisitedNodes.get(i + 1, j)) &&
-                            (j + 1 >= nsize || !unvisitedNodes.get(i, j + 1)) &&
-                            (i - 1 < 0 || !unvisitedNodes.get(i - 1, j)) &&
-                            (j - 1 < 0 || !unvisitedNodes.get(i, j - 1)))
-                        {
-                            unvisitedNodes.set(i, j, false);
-                            inferredNodes.set(i, j, true);
-                        }
-                    }
+                    maze = tmp;
+                    history.commit(maze);
                 }
+            }
+            break;
+        case sf::Keyboard::Key::V:
+            saveMaze(maze);
+            break;
 
-                bfs(discoveredMaze, cursor, CurrentIdeal, bfsPath);
-                bfs(discoveredMaze, Start, mark, bfsFinal);
-
-                    OptimumNodes.setAll(false);
-                    Node StackTop;
-                    while (bfsFinal.size() > 0)
-                    {
-                        StackTop = bfsFinal.pop();
-                        if (true == unvisitedNodes.get(StackTop.i,StackTop.j))
-                        {
-                        OptimumNodes.set(StackTop.i, StackTop.j, true);
-                        }
-                    }
-
-                    bfs(discoveredMaze, cursor, OptimumNodes, bfsPath);
-                    CurrentIdeal = bfsPath[bfsPath.size()-1];
-
-                bfs(discoveredMaze, Start, mark, bfsFinal);
+        // Place mark
+        case sf::Keyboard::Key::Space:
+            if (cursor == mark && markSet)
+            {
+                markSet = false;
             }
             else
             {
-                bfs(discoveredMaze, cursor, mark, bfsPath);
+                mark = cursor;
+                markSet = true;
             }
+            break;
 
-            if(bfsPath.size() == 0)
-            {
-                //initilize todo:
-                //Needs to compare fastest path after further exploration with fastest path previously,
-                //and if the length of the new path is longerm undo changes, and if it is shorter, forget about the imaginary wall, and do process again.
+        // Show BFS path
+        case sf::Keyboard::Key::B:
+            showBfs = !showBfs;
+            break;
 
-                //Needs to do something after it has completed the check, to ensure it doesen't do itself again and again.
-                //Fortunately this currently does nothing! DO NOT IMPLEMENT (This is the 'find faster paths' bit)
-                NodeStack bfsCheck;
-                NodeStack bfsStore = bfsFinal; NodeStack bfsImprov;
-                Node A = bfsStore.pop(); Node B;
-                int fakewall = 0;
+        // Plan the fastest speed run from cursor to mark
+        case sf::Keyboard::Key::P:
+            showRun = !showRun && markSet;
+            if (showRun)
+                planRun();
+            break;
 
-                InitScore = ScorePath(bfsFinal);
+        // Print the structure of the maze
+        case sf::Keyboard::Key::I:
+            printAnalysis();
+            break;
 
-                while(bfsStore.size() != 0)
-                {
-                    Node B = bfsStore.pop();
-
-                    if(A.i < B.i)
-                    {fakewall = 0;}
-                    if(A.i > B.i)
-                    {fakewall = 2;}
-                    if(A.j < B.j)
-                    {fakewall = 1;}
-                    if(A.j > B.j)
-                    {fakewall = 3;}
-
-                    Walls = maze.getCellWalls(A.i,A.j);
-                    Walls[fakewall] = true;
-                    maze.setCellWalls(A.i,A.j,Walls);
-
-                    bfs(discoveredMaze, Start, mark, bfsImprov);
-
-                    if(InitScore > ScorePath(bfs(Improv)))
-                    {bfsFinal = bfsImprov;}
-                    else
-                    {
-                        Walls = maze.getCellWalls(A.i,A.j);
-                        Walls[fakewall] = false;
-                        maze.setCellWalls(A.i,A.j,Walls);
-                    }
-                }
+        // Run simulation
+        case sf::Keyboard::Key::X:
+            recording.setSeed(seed);
+            if (sim.run() == Simulator<msize, nsize>::Run::Search)
+                sim.stop();
+            else if (markSet)
+                sim.startSearch(maze, cursor, mark);
+            clk.restart();
+            break;
 
+        // Map the maze
+        case sf::Keyboard::Key::M:
+            recording.setSeed(seed);
+            if (sim.run() == Simulator<msize, nsize>::Run::Mapping)
+                sim.stop();
+            else
+                sim.startMapping(maze, cursor, mark);
+            clk.restart();
+            break;
 
+        // Save the recording of the last run, or replay a saved one
+        case sf::Keyboard::Key::K:
+            {
+                std::ofstream file("maze-run.mzr", std::ios::binary);
+                if (recording.save(file))
+                    std::cout << "Run of " << recording.steps() << " steps written to maze-run.mzr" << std::endl;
+                else
+                    std::cout << "Failed to write maze-run.mzr" << std::endl;
             }
-
-            // Stop when the goal is reached or unreachable
-            if ((runSim && cursor == mark) || bfsPath.size() == 0)
+            break;
+        case sf::Keyboard::Key::O:
             {
-                runSim = false;
-                //mapping = false;
+                std::ifstream file("maze-run.mzr", std::ios::binary);
+                if (replay.load(file))
+                {
+                    sim.stop();
+                    replaying = true;
+                    replayDirection = 0;
+                    cursor = replay.position();
+                    std::cout << "Replaying a " << (replay.mapping() ? "mapping" : "search")
+                              << " run of " << replay.steps() << " steps, seed " << replay.seed()
+                              << ", stream " << replay.stream() << std::endl;
+                }
+                else
+                {
+                    std::cout << "Failed to load maze-run.mzr" << std::endl;
+                }
             }
+            break;
+
+        // Simulation speed
+        case sf::Keyboard::Key::Equal:
+        case sf::Keyboard::Key::Add:
+            simSpeed *= 2.0;
+            sim.setMode(simSpeed == 1.0 ? RunMode::RealTime : RunMode::Scaled, simSpeed);
+            std::cout << "Simulation speed " << simSpeed << "x" << std::endl;
+            break;
+        case sf::Keyboard::Key::Dash:
+        case sf::Keyboard::Key::Subtract:
+            simSpeed /= 2.0;
+            sim.setMode(simSpeed == 1.0 ? RunMode::RealTime : RunMode::Scaled, simSpeed);
+            std::cout << "Simulation speed " << simSpeed << "x" << std::endl;
+            break;
+        case sf::Keyboard::Key::Return:
+            if (sim.finish() > 0)
+                cursor = sim.position();
+            break;
+
+        // Frame times and traces
+        case sf::Keyboard::Key::T:
+            showTimes = !showTimes;
+            if (!showTimes)
+                window.setTitle("Maze");
+            break;
+        case sf::Keyboard::Key::E:
+            if (!traceEnabled)
+                std::cout << "Built without MAZE_TRACE; build with make TRACE=1 to record traces" << std::endl;
+            else if (writeTrace("maze-trace.json") && writeTrace("maze-trace.csv"))
+                std::cout << "Trace of " << traceEvents() << " events written to maze-trace.json and maze-trace.csv" << std::endl;
+            else
+                std::cout << "Failed to write the trace" << std::endl;
+            break;
+            
+        default:
+            break;
         }
+        break;
+    default:
+        break;
+    }
+}
+
+
+// Keys that mean something else while replaying. Returns false for the
+// keys that keep their usual meaning.
+bool handleReplayKey(sf::Keyboard::Key key)
+{
+    switch (key)
+    {
+    case sf::Keyboard::Key::Comma:
+        replayDirection = 0;
+        replay.seek(replay.step() - 1);
+        break;
+    case sf::Keyboard::Key::Period:
+        replayDirection = 0;
+        replay.seek(replay.step() + 1);
+        break;
+    case sf::Keyboard::Key::LBracket:
+        replayDirection = replayDirection < 0 ? 0 : -1;
+        break;
+    case sf::Keyboard::Key::RBracket:
+        replayDirection = replayDirection > 0 ? 0 : 1;
+        break;
+    case sf::Keyboard::Key::Home:
+        replay.seek(0);
+        break;
+    case sf::Keyboard::Key::End:
+        replay.seek(replay.steps());
+        break;
+    case sf::Keyboard::Key::O:
+    case sf::Keyboard::Key::Escape:
+        replaying = false;
+        replayDirection = 0;
+        window.setTitle("Maze");
+        return true;
+    case sf::Keyboard::Key::X:
+    case sf::Keyboard::Key::M:
+        // Starting a simulation ends the replay
+        replaying = false;
+        replayDirection = 0;
+        window.setTitle("Maze");
+        return false;
+    default:
+        return false;
+    }
+
+    cursor = replay.position();
+    replayPending = 0.0;
+    clk.restart();
+    if (!showTimes)
+    {
+        char title[64];
+        std::snprintf(title, sizeof(title), "Maze - replay step %d of %d", replay.step(), replay.steps());
+        window.setTitle(title);
     }
+    return true;
 }
 
 
 void draw()
 {
+    TRACE_SCOPE("draw");
     window.clear();
     
-    if (runSim)
+    const Explorer<msize, nsize>& explorer = sim.state();
+
+    if (replaying)
     {
-        // Undiscovered parts of the maze are show in gray
-        maze.draw(window, 16.f, 2.f, sf::Color(255, 255, 255, 127));
-        discoveredMaze.draw(window);
+        drawRun(replay.maze(), replay.discovered(),
+                replay.mapping() ? &replay.unvisited() : nullptr,
+                replay.mapping() ? &replay.inferred() : nullptr);
+
+        // Mark the target the mouse was heading for
+        sf::CircleShape targetshape(3.f);
+        targetshape.setPosition(replay.target().j * 16.f + 5.f, replay.target().i * 16.f + 5.f);
+        targetshape.setFillColor(sf::Color::Yellow);
+        render(targetshape);
     }
-    else if (mapping)
+    else if (sim.run() == Simulator<msize, nsize>::Run::Search)
     {
-        // Undiscovered parts of the maze are show in gray
-        maze.draw(window, 16.f, 2.f, sf::Color(255, 255, 255, 127));
-        discoveredMaze.draw(window);
-
-        // Mark visited cells
-        sf::CircleShape visitedshape(2.f);
-        sf::CircleShape inferredshape(2.f);
-        visitedshape.setFillColor(sf::Color::Cyan);
-        inferredshape.setFillColor(sf::Color::Magenta);
-        for (int i = 0; i < msize; ++i)
-        {
-            for (int j = 0; j < nsize; ++j)
-            {
-                if (!unvisitedNodes.get(i, j))
-                {
-                    visitedshape.setPosition(j * 16.f + 6.f, i * 16.f + 6.f);
-                    window.draw(visitedshape);
-                }
-
-                if (inferredNodes.get(i, j))
-                {
-                    inferredshape.setPosition(j * 16.f + 6.f, i * 16.f + 6.f);
-                    window.draw(inferredshape);
-                }
-            }
-        }
-        
+        drawRun(maze, explorer.discovered(), nullptr, nullptr);
+    }
+    else if (sim.run() == Simulator<msize, nsize>::Run::Mapping)
+    {
+        drawRun(maze, explorer.discovered(), &explorer.unvisited(), &explorer.inferred());
     }
     else
     {
         // Draw maze normally
-        maze.draw(window);
+        mazeMesh.draw(maze, window);
     }
     
-    if (showBfs)
+    if (showBfs && !replaying)
     {
         // Draw BFS path
-        sf::VertexArray path(sf::LinesStrip, bfsPath.size());
-        for (int i = 0; i < bfsPath.size(); ++i)
+        bool idle = sim.run() == Simulator<msize, nsize>::Run::None;
+        const NodeStack<msize, nsize>& shown = idle ? bfsPath : explorer.path();
+        sf::VertexArray path(sf::LinesStrip, shown.size());
+        for (int i = 0; i < shown.size(); ++i)
         {
-            auto n = bfsPath[i];
+            auto n = shown[i];
             path[i].position = {n.j * 16.f + 8.f, n.i * 16.f + 8.f};
             path[i].color = sf::Color::Green;
         }
-        window.draw(path);
+        render(path);
 
         // Draw BFS path
-        sf::VertexArray path2(sf::LinesStrip, bfsFinal.size());
-        for (int i = 0; i < bfsFinal.size(); ++i)
+        const NodeStack<msize, nsize>& finalPath = explorer.finalPath();
+        sf::VertexArray path2(sf::LinesStrip, idle ? 0 : finalPath.size());
+        for (int i = 0; i < int(path2.getVertexCount()); ++i)
         {
-            auto n = bfsFinal[i];
+            auto n = finalPath[i];
             path2[i].position = {n.j * 16.f + 8.f, n.i * 16.f + 8.f};
             path2[i].color = sf::Color::Red;
         }
-        window.draw(path2);
+        render(path2);
     }
 
-    if (markSet)
+    if (showRun && maze.hash() == runMaze && !runPlanner.segments().empty())
+    {
+        // Draw the speed run through the ends of its segments
+        const std::vector<RunSegment>& plan = runPlanner.segments();
+        sf::VertexArray run(sf::LinesStrip, plan.size() + 1);
+        run[0].position = {runFrom.j * 16.f + 8.f, runFrom.i * 16.f + 8.f};
+        run[0].color = sf::Color::Yellow;
+        for (std::size_t k = 0; k < plan.size(); ++k)
+        {
+            run[k + 1].position = {plan[k].y * 8.f, plan[k].x * 8.f};
+            run[k + 1].color = sf::Color::Yellow;
+        }
+        render(run);
+    }
+
+    if (markSet || replaying)
     {
-        // Draw mark
+        // Draw mark, or the goal of the replayed run
+        Node shownMark = replaying ? replay.goal() : mark;
         sf::CircleShape markshape(4.f);
-        markshape.setPosition(mark.j * 16.f + 4.f, mark.i * 16.f + 4.f);
+        markshape.setPosition(shownMark.j * 16.f + 4.f, shownMark.i * 16.f + 4.f);
         markshape.setFillColor(sf::Color::Blue);
-        window.draw(markshape);
+        render(markshape);
     }
 
     // Draw cursor
     sf::CircleShape cursorshape(4.f);
     cursorshape.setPosition(cursor.j * 16.f + 4.f, cursor.i * 16.f + 4.f);
     cursorshape.setFillColor(sf::Color::Red);
-    window.draw(cursorshape);
-    
+    render(cursorshape);
+
+    if (showTimes)
+        drawTimes();
+
+    TRACE_FLUSH("draw_calls_per_frame", "draw_calls");
     window.display();
 }
 
 
+// A run in progress: the true maze in gray under the discovered one, and
+// for mapping runs the visited and inferred cells
+void drawRun(const Maze<msize, nsize>& truth, const Maze<msize, nsize>& discovered,
+             const BitArray2D<msize, nsize>* unvisited, const BitArray2D<msize, nsize>* inferred)
+{
+    // Undiscovered parts of the maze are show in gray
+    mazeMesh.draw(truth, window, 16.f, 2.f, sf::Color(255, 255, 255, 127));
+    discoveredMesh.draw(discovered, window);
+
+    if (!unvisited || !inferred)
+        return;
+
+    // Mark visited cells
+    sf::CircleShape visitedshape(2.f);
+    sf::CircleShape inferredshape(2.f);
+    visitedshape.setFillColor(sf::Color::Cyan);
+    inferredshape.setFillColor(sf::Color::Magenta);
+    for (int i = 0; i < msize; ++i)
+    {
+        for (int j = 0; j < nsize; ++j)
+        {
+            if (!unvisited->get(i, j))
+            {
+                visitedshape.setPosition(j * 16.f + 6.f, i * 16.f + 6.f);
+                render(visitedshape);
+            }
+
+            if (inferred->get(i, j))
+            {
+                inferredshape.setPosition(j * 16.f + 6.f, i * 16.f + 6.f);
+                render(inferredshape);
+            }
+        }
+    }
+}
+
+
+// SFML has no built-in font, so the times are bars: update on top and draw
+// below, 16 pixels per millisecond with a tick every millisecond
+void drawTimes()
+{
+    float width = window.getSize().x;
+    float bottom = window.getSize().y;
+
+    sf::RectangleShape bar;
+    bar.setFillColor(sf::Color::Yellow);
+    bar.setSize({updateMs * 16.f < width ? updateMs * 16.f : width, 3.f});
+    bar.setPosition(0.f, bottom - 8.f);
+    render(bar);
+
+    bar.setFillColor(sf::Color(255, 127, 0));
+    bar.setSize({drawMs * 16.f < width ? drawMs * 16.f : width, 3.f});
+    bar.setPosition(0.f, bottom - 4.f);
+    render(bar);
+
+    sf::RectangleShape tick({1.f, 8.f});
+    tick.setFillColor(sf::Color(255, 255, 255, 127));
+    for (float x = 16.f; x < width; x += 16.f)
+    {
+        tick.setPosition(x, bottom - 8.f);
+        render(tick);
+    }
+
+    char title[64];
+    std::snprintf(title, sizeof(title), "Maze - update %.2f ms, draw %.2f ms", updateMs, drawMs);
+    window.setTitle(title);
+}
+
+
+void render(const sf::Drawable& drawable)
+{
+    TRACE_TALLY("draw_calls");
+    window.draw(drawable);
+}
+
+
+void planRun()
+{
+    BitArray2D<msize, nsize> goals;
+    goals.set(mark.i, mark.j, true);
+    runFrom = cursor;
+    runMaze = maze.hash();
+
+    if (!runPlanner.solve(maze, cursor, goals))
+    {
+        std::cout << "No speed run to the mark" << std::endl;
+        return;
+    }
+
+    static const char* names[] = {"straight", "diagonal", "turn 45 in", "turn 45 out",
+                                  "turn 90", "turn 180", "finish"};
+    std::cout << "Speed run of " << runPlanner.time() << " s:" << std::endl;
+    for (const RunSegment& s : runPlanner.segments())
+    {
+        std::cout << "  " << names[int(s.move)] << ' ' << s.length << " m, "
+                  << s.entrySpeed << " -> " << s.peakSpeed << " -> " << s.exitSpeed
+                  << " m/s, " << s.time << " s" << std::endl;
+    }
+}
+
+
+// The structure of the maze seen from the cursor, with the mark as the goal
+// if one is placed
+void printAnalysis()
+{
+    BitArray2D<msize, nsize> goals;
+    if (markSet)
+        goals.set(mark.i, mark.j, true);
+
+    MazeStats stats;
+    analyzer.analyze(maze, cursor, goals, stats);
+
+    std::cout << "Reachable cells " << stats.reachable << ", dead ends " << stats.deadEnds
+              << ", components " << stats.components << ", loops " << stats.loops
+              << ", farthest cell " << stats.longestShortest << " steps" << std::endl;
+    if (stats.shortestLength >= 0)
+        std::cout << stats.shortestPaths << " shortest paths of " << stats.shortestLength
+                  << " steps to the mark" << std::endl;
+    std::cout << "Corridors of 1, 2, 3-4, 5-8, 9-16, 17+ cells:";
+    for (int b = 0; b < corridorBins; ++b)
+        std::cout << ' ' << stats.corridors[b];
+    std::cout << std::endl;
+}
+
+
 bool loadMaze(Maze<16, 16>& maze)
 {
     std::cout << "Enter maze string:" << std::endl;
@@ -473,39 +732,3 @@ void saveMaze(Maze<16, 16> maze)
     std::cout << "Maze saved:" << std::endl;
     std::cout << maze.save() << std::endl;
 }
-
-float ScorePath(NodeStack Path)
-{
-    bool orient = 0;
-    bool turn = 0;
-
-    float Score = 0;
-
-    if(Path.size() == 0)
-    {
-        Score = 129;
-        return Score;
-    }
-
-    current = Path.pop();
-
-    while(Path.size() != 0)
-    {
-        next = Path.pop();
-
-        if(current.i == next.i)
-            {turn = 0;}
-        if(current.j == next.j)
-            {turn = 1;}
-
-        if(orient != turn)
-            {Score = Score+1;}
-        if(orient == turn)
-            {Score = Score+0.5;}
-
-        orient = turn;
-        current = next;
-    }
-
-    return Score;
-}
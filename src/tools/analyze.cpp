@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Maze.hpp"
+#include "Corpus.hpp"
+#include "Analysis.hpp"
+#include "Parallel.hpp"
+
+
+/* Maze structure analyzer: characterizes every maze of a corpus, on all
+ * cores, without simulating anything.
+ *
+ *     maze-analyze [-j threads] [-o out.csv] [-s si sj] [-g gi gj] corpus.mzc
+ *
+ * The start is the corner (m - 1, 0) unless -s gives another cell, and the
+ * goal region is the center 2x2 room unless -g gives a single goal cell.
+ * Square mazes of size 8, 16, 32, 64, 128 and 256 are supported.
+ *
+ * Writes one CSV row per maze, in corpus order:
+ *     index,reachable,dead_ends,components,loops,shortest_length,shortest_paths,longest_shortest,
+ *     corridors_1,corridors_2,corridors_3_4,corridors_5_8,corridors_9_16,corridors_17_plus
+ * See MazeStats for the meaning of each column. The corpus is analyzed in
+ * blocks, each written out before the next is started, so memory does not
+ * grow with the size of the corpus. A summary with the means and the
+ * throughput is printed on stderr.
+ */
+
+
+struct Options
+{
+    std::string corpus;
+    Node start = {-1, -1};
+    Node goal = {-1, -1};
+    int threads = 0;
+    std::string out;
+};
+
+
+template<int m, int n>
+bool analyze(const Options& options, const Corpus& corpus, std::ostream& out);
+
+
+int main(int argc, char** argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    Options options;
+    bool usage = false;
+    int arg = 1;
+
+    for (; arg < argc - 1 && !usage; ++arg)
+    {
+        std::string opt = argv[arg];
+        if (arg + 2 >= argc)
+            usage = true;
+        else if (opt == "-j")
+            options.threads = std::atoi(argv[++arg]);
+        else if (opt == "-o")
+            options.out = argv[++arg];
+        else if ((opt == "-s" || opt == "-g") && arg + 3 < argc)
+        {
+            Node& cell = opt == "-s" ? options.start : options.goal;
+            cell = {std::atoi(argv[arg + 1]), std::atoi(argv[arg + 2])};
+            arg += 2;
+        }
+        else
+            usage = true;
+    }
+
+    if (usage || arg != argc - 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [-j threads] [-o out.csv] [-s si sj] [-g gi gj] corpus.mzc" << std::endl;
+        return 2;
+    }
+    options.corpus = argv[arg];
+
+    if (options.threads <= 0)
+        options.threads = defaultThreads();
+
+    Corpus corpus;
+    if (!corpus.open(options.corpus))
+    {
+        std::cerr << argv[0] << ": " << corpus.error() << std::endl;
+        return 2;
+    }
+
+    std::ofstream file;
+    if (!options.out.empty())
+    {
+        file.open(options.out);
+        if (!file)
+        {
+            std::cerr << argv[0] << ": cannot write " << options.out << std::endl;
+            return 2;
+        }
+    }
+    std::ostream& out = options.out.empty() ? std::cout : file;
+
+    int size = corpus.rows() == corpus.cols() ? corpus.rows() : 0;
+    bool ok;
+    switch (size)
+    {
+    case 8:   ok = analyze<8, 8>(options, corpus, out); break;
+    case 16:  ok = analyze<16, 16>(options, corpus, out); break;
+    case 32:  ok = analyze<32, 32>(options, corpus, out); break;
+    case 64:  ok = analyze<64, 64>(options, corpus, out); break;
+    case 128: ok = analyze<128, 128>(options, corpus, out); break;
+    case 256: ok = analyze<256, 256>(options, corpus, out); break;
+    default:
+        std::cerr << argv[0] << ": unsupported maze size " << corpus.rows() << 'x' << corpus.cols() << std::endl;
+        return 2;
+    }
+
+    return ok ? 0 : 1;
+}
+
+
+// Mazes are analyzed in blocks: all threads fill one block of results, then
+// the block is written out in order
+template<int m, int n>
+bool analyze(const Options& options, const Corpus& corpus, std::ostream& out)
+{
+    const long blockSize = 16384;
+
+    Node start = options.start.i < 0 ? Node{m - 1, 0} : options.start;
+    Node goal = options.goal;
+    if (start.i < 0 || start.i >= m || start.j < 0 || start.j >= n ||
+        goal.i >= m || goal.j >= n || (goal.i >= 0 && goal.j < 0))
+    {
+        std::cerr << "start or goal outside the maze" << std::endl;
+        return false;
+    }
+
+    BitArray2D<m, n> goals;
+    if (goal.i >= 0)
+        goals.set(goal.i, goal.j, true);
+    else
+    {
+        for (int i = (m - 1) / 2; i <= m / 2; ++i)
+            for (int j = (n - 1) / 2; j <= n / 2; ++j)
+                goals.set(i, j, true);
+    }
+
+    struct Worker
+    {
+        MazeAnalyzer<m, n> analyzer;
+        Maze<m, n> maze;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int t = 0; t < options.threads; ++t)
+        workers.emplace_back(new Worker);
+
+    long count = corpus.size();
+    std::vector<MazeStats> block(std::min(blockSize, count));
+
+    double reachable = 0;
+    double deadEnds = 0;
+    double loops = 0;
+    double shortest = 0;
+    long solvable = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    out << "index,reachable,dead_ends,components,loops,shortest_length,shortest_paths,longest_shortest,"
+        << "corridors_1,corridors_2,corridors_3_4,corridors_5_8,corridors_9_16,corridors_17_plus\n";
+
+    for (long first = 0; first < count; first += blockSize)
+    {
+        long size = std::min(blockSize, count - first);
+
+        parallelFor(size, options.threads, [&](int t, long k) {
+            Worker& w = *workers[t];
+            corpus.view<m, n>(first + k).copyTo(w.maze);
+            w.analyzer.analyze(w.maze, start, goals, block[k]);
+        }, 64);
+
+        for (long k = 0; k < size; ++k)
+        {
+            const MazeStats& s = block[k];
+            out << first + k << ',' << s.reachable << ',' << s.deadEnds << ',' << s.components << ','
+                << s.loops << ',' << s.shortestLength << ',' << s.shortestPaths << ',' << s.longestShortest;
+            for (int b = 0; b < corridorBins; ++b)
+                out << ',' << s.corridors[b];
+            out << '\n';
+
+            reachable += s.reachable;
+            deadEnds += s.deadEnds;
+            loops += s.loops;
+            if (s.shortestLength >= 0)
+            {
+                shortest += s.shortestLength;
+                ++solvable;
+            }
+        }
+    }
+    out.flush();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    if (count > 0)
+    {
+        std::cerr << count << " mazes in " << seconds << " s ("
+                  << count / seconds << " mazes/s, " << options.threads << " threads)" << std::endl
+                  << "goal reachable: " << solvable << '/' << count
+                  << ", mean reachable: " << reachable / count
+                  << ", mean dead ends: " << deadEnds / count
+                  << ", mean loops: " << loops / count
+                  << ", mean shortest length: " << (solvable > 0 ? shortest / solvable : 0) << std::endl;
+    }
+
+    return bool(out);
+}
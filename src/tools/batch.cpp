@@ -0,0 +1,499 @@
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Maze.hpp"
+#include "BFS.hpp"
+#include "AStar.hpp"
+#include "Bidirectional.hpp"
+#include "Wavefront.hpp"
+#include "TurnSearch.hpp"
+#include "PathCache.hpp"
+#include "PathScore.hpp"
+#include "Corpus.hpp"
+#include "Symmetry.hpp"
+#include "ResultCache.hpp"
+#include "Trace.hpp"
+
+
+/* Headless batch solver.
+ *
+ * Reads one query per line from the given file, or from stdin if no file (or
+ * "-") is given:
+ *     <maze string> <start i> <start j> <goal i> <goal j>
+ * where the maze string is in the format produced by Maze::save(). Square
+ * mazes of size 8, 16, 32, 64, 128 and 256 are supported and may be mixed in
+ * one stream. Empty lines and lines starting with '#' are skipped.
+ *
+ * Writes one result per query to stdout:
+ *     <line> <length> <score> <path>
+ * where length is the number of steps in the path (-1 if the goal is
+ * unreachable), score is ScorePath() of the path and path is the list of
+ * cells from start to goal as "i,j;i,j;..." ("-" if unreachable). Malformed
+ * lines are reported on stderr and make the program exit with a nonzero
+ * status.
+ *
+ * Options:
+ *     -e bfs|astar|bidir|wavefront|turn|table
+ *         search engine to use (default bfs). astar and bidir find paths
+ *         as short as bfs but expand fewer cells on large mazes; the path
+ *         may differ when there are several of the same length. turn
+ *         returns the path with the lowest score instead of the fewest
+ *         steps. table answers from a PathCache, which pays off when
+ *         consecutive queries share a maze.
+ *     -c corpus.mzc si sj gi gj
+ *         instead of reading queries, solve the same query on every maze of
+ *         a binary corpus (see maze-corpus). The line number in the output
+ *         is the index of the maze in the corpus. bfs, astar and bidir
+ *         search the mapped records in place; the other engines copy each
+ *         one into a Maze.
+ *     -k cache
+ *         keep results in a persistent cache file (see ResultCache.hpp),
+ *         keyed by the maze, start and goal up to rotations and mirrors
+ *         (see Symmetry.hpp), and answer queries found there without
+ *         searching. Each query is solved in the canonical orientation and
+ *         the path is mapped back, so the answer is the same whether it
+ *         comes from the cache or not, but may differ from a run without
+ *         -k when there are several best paths. The turn engine only
+ *         treats mirror images as the same maze, since its score depends
+ *         on the heading of the mouse at the start.
+ *     -t trace.json|trace.csv
+ *         write the trace recorded by the searches when done, as Chrome
+ *         trace JSON or as CSV (see Trace.hpp). Needs a build with
+ *         make TRACE=1; otherwise the trace is empty.
+ */
+
+
+enum class Engine
+{
+    BFS,
+    AStar,
+    Bidirectional,
+    Wavefront,
+    Turn,
+    Table
+};
+
+Engine engine = Engine::BFS;
+std::string engineName = "bfs";
+ResultCache* cache = nullptr;
+
+
+bool parseEngine(const std::string& name);
+int finish(bool ok, const std::string& trace, const char* program);
+bool solveStream(std::istream& in, std::ostream& out);
+bool solveLine(const std::string& line, int lineNo, std::ostream& out);
+
+template<int m, int n>
+bool solveQuery(const std::string& mazestr, Node start, Node goal,
+                int lineNo, std::ostream& out);
+
+bool solveCorpus(const Corpus& corpus, Node start, Node goal, std::ostream& out);
+
+template<int m, int n>
+bool solveCorpus(const Corpus& corpus, Node start, Node goal, std::ostream& out);
+
+template<int m, int n>
+void solve(const Maze<m, n>& maze, Node start, Node goal, NodeStack<m, n>& path);
+
+template<int m, int n>
+void solveCached(const Maze<m, n>& maze, Node start, Node goal, NodeStack<m, n>& path);
+
+template<int m, int n>
+bool readPath(const std::string& text, NodeStack<m, n>& path);
+
+template<int m, int n>
+void writePath(const NodeStack<m, n>& path, std::ostream& out);
+
+template<int m, int n>
+void writeResult(int lineNo, const NodeStack<m, n>& path, std::ostream& out);
+
+
+int main(int argc, char** argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    bool usage = false;
+    std::string trace;
+    std::string cacheFile;
+    std::string corpusFile;
+    std::string queryFile;
+    Node start = {0, 0};
+    Node goal = {0, 0};
+
+    for (int arg = 1; arg < argc && !usage; ++arg)
+    {
+        std::string opt = argv[arg];
+        if (opt == "-" || opt[0] != '-')
+        {
+            usage = !queryFile.empty();
+            queryFile = opt;
+        }
+        else if (opt == "-c")
+        {
+            if (arg + 5 >= argc)
+                usage = true;
+            else
+            {
+                corpusFile = argv[++arg];
+                start.i = std::atoi(argv[++arg]);
+                start.j = std::atoi(argv[++arg]);
+                goal.i = std::atoi(argv[++arg]);
+                goal.j = std::atoi(argv[++arg]);
+            }
+        }
+        else if (arg + 1 >= argc)
+            usage = true;
+        else if (opt == "-t")
+            trace = argv[++arg];
+        else if (opt == "-k")
+            cacheFile = argv[++arg];
+        else if (opt == "-e")
+            usage = !parseEngine(argv[++arg]);
+        else
+            usage = true;
+    }
+
+    if (usage || (!corpusFile.empty() && !queryFile.empty()))
+    {
+        std::cerr << "usage: " << argv[0] << " [-t trace] [-e bfs|astar|bidir|wavefront|turn|table] [-k cache] [file]" << std::endl
+                  << "       " << argv[0] << " [-t trace] [-e bfs|astar|bidir|wavefront|turn|table] [-k cache]"
+                  << " -c corpus.mzc si sj gi gj" << std::endl;
+        return 2;
+    }
+
+    ResultCache results;
+    if (!cacheFile.empty())
+    {
+        if (!results.open(cacheFile))
+        {
+            std::cerr << argv[0] << ": " << results.error() << std::endl;
+            return 2;
+        }
+        cache = &results;
+    }
+
+    if (!corpusFile.empty())
+    {
+        Corpus corpus;
+        if (!corpus.open(corpusFile))
+        {
+            std::cerr << argv[0] << ": " << corpus.error() << std::endl;
+            return 2;
+        }
+        return finish(solveCorpus(corpus, start, goal, std::cout), trace, argv[0]);
+    }
+
+    if (queryFile.empty() || queryFile == "-")
+        return finish(solveStream(std::cin, std::cout), trace, argv[0]);
+
+    std::ifstream file(queryFile);
+    if (!file)
+    {
+        std::cerr << argv[0] << ": cannot open " << queryFile << std::endl;
+        return 2;
+    }
+
+    return finish(solveStream(file, std::cout), trace, argv[0]);
+}
+
+
+// Sets the engine from its name. Returns false for an unknown name.
+bool parseEngine(const std::string& name)
+{
+    if (name == "bfs")
+        engine = Engine::BFS;
+    else if (name == "astar")
+        engine = Engine::AStar;
+    else if (name == "bidir")
+        engine = Engine::Bidirectional;
+    else if (name == "wavefront")
+        engine = Engine::Wavefront;
+    else if (name == "turn")
+        engine = Engine::Turn;
+    else if (name == "table")
+        engine = Engine::Table;
+    else
+        return false;
+    engineName = name;
+    return true;
+}
+
+
+// Writes the trace if one was asked for and returns the exit status
+int finish(bool ok, const std::string& trace, const char* program)
+{
+    if (!trace.empty())
+    {
+        if (!traceEnabled)
+            std::cerr << program << ": built without MAZE_TRACE, the trace is empty" << std::endl;
+        if (!writeTrace(trace))
+        {
+            std::cerr << program << ": cannot write " << trace << std::endl;
+            return 2;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+
+bool solveStream(std::istream& in, std::ostream& out)
+{
+    std::string line;
+    int lineNo = 0;
+    bool ok = true;
+
+    while (std::getline(in, line))
+    {
+        ++lineNo;
+
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (!solveLine(line, lineNo, out))
+        {
+            std::cerr << "line " << lineNo << ": malformed query" << std::endl;
+            ok = false;
+        }
+    }
+
+    out.flush();
+    return ok;
+}
+
+
+bool solveLine(const std::string& line, int lineNo, std::ostream& out)
+{
+    std::istringstream ss(line);
+    std::string mazestr;
+    Node start;
+    Node goal;
+
+    if (!(ss >> mazestr >> start.i >> start.j >> goal.i >> goal.j))
+        return false;
+
+    // Dispatch on the "m:n:" prefix to the matching instantiation
+    int m = 0;
+    int n = 0;
+    char sep1 = 0;
+    char sep2 = 0;
+    std::istringstream dims(mazestr);
+    if (!(dims >> m >> sep1 >> n >> sep2) || sep1 != ':' || sep2 != ':' || m != n)
+        return false;
+
+    switch (m)
+    {
+    case 8:   return solveQuery<8, 8>(mazestr, start, goal, lineNo, out);
+    case 16:  return solveQuery<16, 16>(mazestr, start, goal, lineNo, out);
+    case 32:  return solveQuery<32, 32>(mazestr, start, goal, lineNo, out);
+    case 64:  return solveQuery<64, 64>(mazestr, start, goal, lineNo, out);
+    case 128: return solveQuery<128, 128>(mazestr, start, goal, lineNo, out);
+    case 256: return solveQuery<256, 256>(mazestr, start, goal, lineNo, out);
+    default:  return false;
+    }
+}
+
+
+template<int m, int n>
+bool solveQuery(const std::string& mazestr, Node start, Node goal,
+                int lineNo, std::ostream& out)
+{
+    if (start.i < 0 || start.i >= m || start.j < 0 || start.j >= n ||
+        goal.i < 0 || goal.i >= m || goal.j < 0 || goal.j >= n)
+        return false;
+
+    // Large mazes would overflow the stack
+    static Maze<m, n> maze;
+    static NodeStack<m, n> path;
+
+    if (!maze.load(mazestr))
+        return false;
+
+    if (cache)
+        solveCached(maze, start, goal, path);
+    else
+        solve(maze, start, goal, path);
+
+    writeResult(lineNo, path, out);
+    return true;
+}
+
+
+template<int m, int n>
+void solve(const Maze<m, n>& maze, Node start, Node goal, NodeStack<m, n>& path)
+{
+    static PathCache<m, n> table;
+
+    if (engine == Engine::AStar)
+        astar(maze, start, goal, path);
+    else if (engine == Engine::Bidirectional)
+        bidirectionalBfs(maze, start, goal, path);
+    else if (engine == Engine::Wavefront)
+        wavefront(maze, start, goal, path);
+    else if (engine == Engine::Turn)
+        turnSearch(maze, start, goal, path);
+    else if (engine == Engine::Table)
+        table.path(maze, start, goal, path);
+    else
+        bfs(maze, start, goal, path);
+}
+
+
+// Looks the query up in the cache, or solves it in the canonical
+// orientation and adds it, and maps the path back onto the maze
+template<int m, int n>
+void solveCached(const Maze<m, n>& maze, Node start, Node goal, NodeStack<m, n>& path)
+{
+    static CanonicalMaze<m, n> canonical;
+    static Maze<m, n> image;
+
+    canonical.compute(maze, start, goal,
+                      engine == Engine::Turn ? mirrorSymmetries : allSymmetries);
+
+    const std::string* value = cache->find(canonical.key(), engineName);
+    if (!value || !readPath(*value, path))
+    {
+        canonical.copyTo(image);
+        solve(image, canonical.start(), canonical.goal(), path);
+
+        std::ostringstream ss;
+        writePath(path, ss);
+        if (!cache->insert(canonical.key(), engineName, ss.str()))
+            std::cerr << "cannot write to the cache" << std::endl;
+    }
+
+    for (int k = 0; k < path.size(); ++k)
+        path.set(k, canonical.fromCanonical(path[k]));
+}
+
+
+bool solveCorpus(const Corpus& corpus, Node start, Node goal, std::ostream& out)
+{
+    if (corpus.rows() != corpus.cols())
+        return false;
+
+    switch (corpus.rows())
+    {
+    case 8:   return solveCorpus<8, 8>(corpus, start, goal, out);
+    case 16:  return solveCorpus<16, 16>(corpus, start, goal, out);
+    case 32:  return solveCorpus<32, 32>(corpus, start, goal, out);
+    case 64:  return solveCorpus<64, 64>(corpus, start, goal, out);
+    case 128: return solveCorpus<128, 128>(corpus, start, goal, out);
+    case 256: return solveCorpus<256, 256>(corpus, start, goal, out);
+    default:
+        std::cerr << "unsupported maze size " << corpus.rows() << 'x' << corpus.cols() << std::endl;
+        return false;
+    }
+}
+
+
+template<int m, int n>
+bool solveCorpus(const Corpus& corpus, Node start, Node goal, std::ostream& out)
+{
+    if (start.i < 0 || start.i >= m || start.j < 0 || start.j >= n ||
+        goal.i < 0 || goal.i >= m || goal.j < 0 || goal.j >= n)
+    {
+        std::cerr << "start or goal outside the maze" << std::endl;
+        return false;
+    }
+
+    static Maze<m, n> maze;
+    static NodeStack<m, n> path;
+    static PathCache<m, n> table;
+
+    for (std::size_t k = 0; k < corpus.size(); ++k)
+    {
+        MazeView<m, n> view = corpus.view<m, n>(k);
+
+        if (cache)
+        {
+            view.copyTo(maze);
+            solveCached(maze, start, goal, path);
+        }
+        else if (engine == Engine::BFS)
+        {
+            bfs<m, n>(view, start, goal, path);
+        }
+        else if (engine == Engine::AStar)
+        {
+            astar<m, n>(view, start, goal, path);
+        }
+        else if (engine == Engine::Bidirectional)
+        {
+            bidirectionalBfs<m, n>(view, start, goal, path);
+        }
+        else
+        {
+            view.copyTo(maze);
+            if (engine == Engine::Wavefront)
+                wavefront(maze, start, goal, path);
+            else if (engine == Engine::Turn)
+                turnSearch(maze, start, goal, path);
+            else
+                table.path(maze, start, goal, path);
+        }
+
+        writeResult(k, path, out);
+    }
+
+    out.flush();
+    return true;
+}
+
+
+// Reads a path written by writePath(). Returns false if it is malformed or
+// leaves the maze.
+template<int m, int n>
+bool readPath(const std::string& text, NodeStack<m, n>& path)
+{
+    path.clear();
+    if (text == "-")
+        return true;
+
+    std::vector<Node> cells;
+    std::istringstream ss(text);
+    Node v;
+    char comma = 0;
+    char semicolon = ';';
+    while (semicolon == ';' && ss >> v.i >> comma >> v.j && comma == ',')
+    {
+        if (v.i < 0 || v.i >= m || v.j < 0 || v.j >= n || int(cells.size()) >= m * n)
+            return false;
+        cells.push_back(v);
+        if (!(ss >> semicolon))
+            semicolon = 0;
+    }
+    if (cells.empty() || semicolon != 0)
+        return false;
+
+    for (auto it = cells.rbegin(); it != cells.rend(); ++it)
+        path.push(*it);
+    return true;
+}
+
+
+// The cells from start to goal as "i,j;i,j;...", or "-" if there are none
+template<int m, int n>
+void writePath(const NodeStack<m, n>& path, std::ostream& out)
+{
+    if (path.empty())
+        out << '-';
+    for (int k = 0; k < path.size(); ++k)
+    {
+        if (k > 0)
+            out << ';';
+        out << path[k].i << ',' << path[k].j;
+    }
+}
+
+
+template<int m, int n>
+void writeResult(int lineNo, const NodeStack<m, n>& path, std::ostream& out)
+{
+    out << lineNo << ' ' << path.size() - 1 << ' ' << ScorePath(path) << ' ';
+    writePath(path, out);
+    out << '\n';
+}
@@ -0,0 +1,462 @@
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "Maze.hpp"
+#include "BFS.hpp"
+#include "AStar.hpp"
+#include "Bidirectional.hpp"
+#include "Explorer.hpp"
+#include "SpeedRun.hpp"
+#include "Wavefront.hpp"
+#include "PathCache.hpp"
+#include "Symmetry.hpp"
+#include "Analysis.hpp"
+#include "Corpus.hpp"
+#include "Generator.hpp"
+
+
+/* Benchmarks for the solver, the speed run planner, the mapping loop and the
+ * maze codec, canonical form and structure analyzer.
+ *
+ * Every benchmark runs on a corpus of Micromouse-style mazes made from a
+ * fixed seed, so runs are comparable before and after a change. Results are
+ * written to stdout as CSV with one row per benchmark:
+ *     name,size,iterations,ns_per_op,cells_per_sec,allocs_per_op,cells_per_op
+ * cells_per_sec is the number of cells expanded by the searches per second
+ * and cells_per_op the number expanded by one search, which is what A* and
+ * the bidirectional search save on (both 0 for benchmarks that do not
+ * search). For speedrun they count the states the planner expanded.
+ *
+ * Options:
+ *     -t seconds   minimum measuring time per benchmark (default 0.5)
+ *     -f text      only run benchmarks whose name contains text
+ */
+
+
+// Every allocation made by the program goes through here so each benchmark
+// can report how many it made
+static long allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+
+const int corpusSize = 64;
+const std::uint64_t corpusSeed = 12345;
+
+double minTime = 0.5;
+std::string filter;
+volatile long sink = 0;
+
+
+// Runs op(iterations) with a growing number of iterations until it takes at
+// least minTime, then prints the result of the last run. op returns the
+// number of cells expanded.
+template<class Op>
+void run(const std::string& name, int size, Op op)
+{
+    if (name.find(filter) == std::string::npos)
+        return;
+
+    op(1); // Warm up
+
+    for (long iterations = 1; ; iterations *= 2)
+    {
+        long allocsBefore = allocations;
+        auto t0 = std::chrono::steady_clock::now();
+        long cells = op(iterations);
+        auto t1 = std::chrono::steady_clock::now();
+        long allocs = allocations - allocsBefore;
+
+        double seconds = std::chrono::duration<double>(t1 - t0).count();
+        if (seconds < minTime)
+            continue;
+
+        std::cout << name << ',' << size << ',' << iterations << ','
+                  << seconds * 1e9 / iterations << ','
+                  << cells / seconds << ','
+                  << double(allocs) / iterations << ','
+                  << double(cells) / iterations << std::endl;
+        return;
+    }
+}
+
+
+// The same mazes in either wall layout
+template<int m, int n, class Storage = PlaneWalls<m, n>>
+std::vector<Maze<m, n, Storage>> makeCorpus()
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::vector<unsigned char> bytes(Maze<m, n>::byteCount);
+    std::vector<Maze<m, n, Storage>> corpus(corpusSize);
+    for (int k = 0; k < corpusSize; ++k)
+    {
+        generator->generate(*maze, MazeAlgorithm::Micromouse, corpusSeed, k);
+        maze->saveBytes(bytes.data());
+        corpus[k].loadBytes(bytes.data());
+    }
+    return corpus;
+}
+
+
+template<int m, int n>
+void benchSolvers()
+{
+    static const std::vector<Maze<m, n>> corpus = makeCorpus<m, n>();
+    static NodeStack<m, n> path;
+    static WallBoard<m, n> board;
+    static Wavefront<m, n> wave;
+
+    Node start = {m - 1, 0};
+    Node goal = {m / 2, n / 2};
+    BitArray2D<m, n> goals;
+    goals.set(m / 2 - 1, n / 2 - 1, true);
+    goals.set(m / 2 - 1, n / 2, true);
+    goals.set(m / 2, n / 2 - 1, true);
+    goals.set(m / 2, n / 2, true);
+
+    run("bfs_single", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += bfs(corpus[k % corpusSize], start, goal, path, &stats);
+        return stats.expanded;
+    });
+
+    // The same search reading the walls from corpus records in place
+    std::vector<unsigned char> records(corpusSize * Maze<m, n>::byteCount);
+    for (int k = 0; k < corpusSize; ++k)
+        corpus[k].saveBytes(&records[k * Maze<m, n>::byteCount]);
+
+    run("bfs_view", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+        {
+            MazeView<m, n> view(&records[k % corpusSize * Maze<m, n>::byteCount]);
+            sink += bfs<m, n>(view, start, goal, path, &stats);
+        }
+        return stats.expanded;
+    });
+
+    run("bfs_multi", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += bfs(corpus[k % corpusSize], start, goals, path, &stats);
+        return stats.expanded;
+    });
+
+    // The same searches on mazes with a byte of walls per cell
+    static const std::vector<Maze<m, n, CellWalls<m, n>>> cells = makeCorpus<m, n, CellWalls<m, n>>();
+
+    run("bfs_single_cells", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += bfs<m, n>(cells[k % corpusSize], start, goal, path, &stats);
+        return stats.expanded;
+    });
+
+    run("bfs_multi_cells", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += bfs<m, n>(cells[k % corpusSize], start, goals, path, &stats);
+        return stats.expanded;
+    });
+
+    run("astar_single", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += astar(corpus[k % corpusSize], start, goal, path, &stats);
+        return stats.expanded;
+    });
+
+    run("astar_multi", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += astar(corpus[k % corpusSize], start, goals, path, &stats);
+        return stats.expanded;
+    });
+
+    run("bidir_single", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += bidirectionalBfs(corpus[k % corpusSize], start, goal, path, &stats);
+        return stats.expanded;
+    });
+
+    run("bidir_multi", m, [&](long iterations) {
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += bidirectionalBfs(corpus[k % corpusSize], start, goals, path, &stats);
+        return stats.expanded;
+    });
+
+    // Full distance field from the start on a kept workspace
+    run("bfs_flood", m, [&](long iterations) {
+        static SearchWorkspace<m, n> work;
+        SearchStats stats;
+        for (long k = 0; k < iterations; ++k)
+            sink += work.flood(corpus[k % corpusSize], start, &stats);
+        return stats.expanded;
+    });
+
+    // Many queries on one maze, answered from the table after the first
+    run("table_query", m, [&](long iterations) {
+        PathCache<m, n> table;
+        const Maze<m, n>& maze = corpus[0];
+        for (long k = 0; k < iterations; ++k)
+            sink += table.path(maze, {int(k % m), int(k / m % n)}, goal, path);
+        return 0L;
+    });
+
+    run("wavefront_single", m, [&](long iterations) {
+        long cells = 0;
+        for (long k = 0; k < iterations; ++k)
+        {
+            board.build(corpus[k % corpusSize]);
+            sink += wave.solve(board, start, &goals);
+            cells += wave.reachedCount();
+        }
+        return cells;
+    });
+
+    run("wavefront_reach", m, [&](long iterations) {
+        long cells = 0;
+        board.build(corpus[0]);
+        for (long k = 0; k < iterations; ++k)
+            cells += wave.reach(board, start);
+        return cells;
+    });
+}
+
+
+template<int m, int n>
+void benchCodec()
+{
+    static const std::vector<Maze<m, n>> corpus = makeCorpus<m, n>();
+    std::vector<std::string> strings;
+    for (auto& maze : corpus)
+        strings.push_back(maze.save());
+
+    run("load", m, [&](long iterations) {
+        Maze<m, n> maze;
+        for (long k = 0; k < iterations; ++k)
+            sink += maze.load(strings[k % corpusSize]);
+        return 0L;
+    });
+
+    std::vector<unsigned char> records(corpusSize * Maze<m, n>::byteCount);
+    for (int k = 0; k < corpusSize; ++k)
+        corpus[k].saveBytes(&records[k * Maze<m, n>::byteCount]);
+
+    run("load_bytes", m, [&](long iterations) {
+        Maze<m, n> maze;
+        for (long k = 0; k < iterations; ++k)
+        {
+            maze.loadBytes(&records[k % corpusSize * Maze<m, n>::byteCount]);
+            sink += maze.getCellWalls(0, 0)[0];
+        }
+        return 0L;
+    });
+
+    run("save", m, [&](long iterations) {
+        for (long k = 0; k < iterations; ++k)
+            sink += corpus[k % corpusSize].save().size();
+        return 0L;
+    });
+
+    std::unique_ptr<MazeAnalyzer<m, n>> analyzer(new MazeAnalyzer<m, n>);
+    run("analyze", m, [&](long iterations) {
+        Node start = {m - 1, 0};
+        BitArray2D<m, n> goals;
+        goals.set(m / 2, n / 2, true);
+        MazeStats stats;
+        for (long k = 0; k < iterations; ++k)
+        {
+            analyzer->analyze(corpus[k % corpusSize], start, goals, stats);
+            sink += stats.loops;
+        }
+        return 0L;
+    });
+
+    std::unique_ptr<CanonicalMaze<m, n>> canonical(new CanonicalMaze<m, n>);
+    run("canonical", m, [&](long iterations) {
+        Node start = {m - 1, 0};
+        Node goal = {m / 2, n / 2};
+        for (long k = 0; k < iterations; ++k)
+        {
+            canonical->compute(corpus[k % corpusSize], start, goal);
+            sink += canonical->key().lo;
+        }
+        return 0L;
+    });
+
+    run("get_cell_walls", m, [&](long iterations) {
+        const Maze<m, n>& maze = corpus[0];
+        for (long k = 0; k < iterations; ++k)
+            sink += maze.getCellWalls(k % m, k / m % n)[k % 4];
+        return 0L;
+    });
+
+    std::unique_ptr<Maze<m, n, CellWalls<m, n>>> cells(new Maze<m, n, CellWalls<m, n>>);
+    cells->loadBytes(&records[0]);
+    run("get_cell_walls_cells", m, [&](long iterations) {
+        for (long k = 0; k < iterations; ++k)
+            sink += cells->getCellWalls(k % m, k / m % n)[k % 4];
+        return 0L;
+    });
+
+    run("set_cell_walls", m, [&](long iterations) {
+        Maze<m, n> maze = corpus[0];
+        std::array<bool, 4> cw = {true, false, true, false};
+        for (long k = 0; k < iterations; ++k)
+        {
+            cw[k % 4] = !cw[k % 4];
+            sink += maze.setCellWalls(k % m, k / m % n, cw);
+        }
+        return 0L;
+    });
+}
+
+
+// One maze per operation from each generator
+template<int m, int n>
+void benchGenerators()
+{
+    static MazeGenerator<m, n> generator;
+    static Maze<m, n> maze;
+
+    const MazeAlgorithm algorithms[] = {
+        MazeAlgorithm::Backtracker,
+        MazeAlgorithm::Kruskal,
+        MazeAlgorithm::Wilson,
+        MazeAlgorithm::Micromouse };
+
+    for (MazeAlgorithm algorithm : algorithms)
+    {
+        run(std::string("gen_") + algorithmName(algorithm), m, [&](long iterations) {
+            for (long k = 0; k < iterations; ++k)
+            {
+                generator.generate(maze, algorithm, corpusSeed, k);
+                sink += maze.getCellWalls(0, 0)[0];
+            }
+            return 0L;
+        });
+    }
+}
+
+
+// A whole mapping run from the start corner to the center with the given
+// exploration policy, cut off after as many steps as the Simulator allows.
+// Storage is the layout of both the true maze the mouse senses and the
+// map of the walls it has discovered.
+template<int m, int n, class Policy, class Storage = PlaneWalls<m, n>>
+void benchMapping(const std::string& name)
+{
+    static const std::vector<Maze<m, n, Storage>> corpus = makeCorpus<m, n, Storage>();
+    static Explorer<m, n, Policy, Storage> explorer;
+
+    Node start = {m - 1, 0};
+    Node goal = {m / 2, n / 2};
+
+    run(name, m, [&](long iterations) {
+        long before = explorer.expanded();
+        for (long k = 0; k < iterations; ++k)
+        {
+            explorer.beginMapping(corpus[k % corpusSize], start, goal);
+            for (int steps = 0; steps < 16 * m * n && explorer.step(corpus[k % corpusSize]); ++steps)
+                ++sink;
+        }
+        return explorer.expanded() - before;
+    });
+}
+
+
+template<int m, int n>
+void benchMapping()
+{
+    benchMapping<m, n, CandidateFirst<m, n>>("mapping");
+    benchMapping<m, n, NearestUnvisited<m, n>>("mapping_nearest");
+    benchMapping<m, n, FloodFillToCenter<m, n>>("mapping_floodfill");
+    benchMapping<m, n, CandidateFirst<m, n>, CellWalls<m, n>>("mapping_cells");
+}
+
+
+// Planning the fastest run from the start corner into the center, which a
+// mouse would do again after every explored cell
+template<int m, int n>
+void benchSpeedRun()
+{
+    static const std::vector<Maze<m, n>> corpus = makeCorpus<m, n>();
+    std::unique_ptr<SpeedRunPlanner<m, n>> planner(new SpeedRunPlanner<m, n>);
+
+    Node start = {m - 1, 0};
+    BitArray2D<m, n> goals;
+    goals.set(m / 2 - 1, n / 2 - 1, true);
+    goals.set(m / 2 - 1, n / 2, true);
+    goals.set(m / 2, n / 2 - 1, true);
+    goals.set(m / 2, n / 2, true);
+
+    run("speedrun", m, [&](long iterations) {
+        long before = planner->expanded();
+        for (long k = 0; k < iterations; ++k)
+            sink += planner->solve(corpus[k % corpusSize], start, goals);
+        return planner->expanded() - before;
+    });
+}
+
+
+int main(int argc, char** argv)
+{
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        std::string opt = argv[arg];
+        if (opt == "-t" && arg + 1 < argc)
+            minTime = std::atof(argv[++arg]);
+        else if (opt == "-f" && arg + 1 < argc)
+            filter = argv[++arg];
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [-t seconds] [-f filter]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::cout << "name,size,iterations,ns_per_op,cells_per_sec,allocs_per_op,cells_per_op" << std::endl;
+
+    benchSolvers<16, 16>();
+    benchSolvers<32, 32>();
+    benchSolvers<128, 128>();
+
+    benchCodec<16, 16>();
+    benchCodec<128, 128>();
+
+    benchGenerators<16, 16>();
+    benchGenerators<128, 128>();
+
+    benchSpeedRun<16, 16>();
+    benchSpeedRun<32, 32>();
+
+    benchMapping<16, 16>();
+    benchMapping<32, 32>();
+
+    return 0;
+}
@@ -0,0 +1,1470 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "Maze.hpp"
+#include "BFS.hpp"
+#include "AStar.hpp"
+#include "Bidirectional.hpp"
+#include "Wavefront.hpp"
+#include "FloodFill.hpp"
+#include "History.hpp"
+#include "Explorer.hpp"
+#include "PathCache.hpp"
+#include "PathScore.hpp"
+#include "TurnSearch.hpp"
+#include "Recording.hpp"
+#include "Simulator.hpp"
+#include "SpeedRun.hpp"
+#include "Symmetry.hpp"
+#include "ResultCache.hpp"
+#include "Analysis.hpp"
+#include "Corpus.hpp"
+#include "Generator.hpp"
+#include "Random.hpp"
+
+
+/* Consistency checks of the solvers, the flood fill, the edit history, the
+ * wall layouts, run recordings, the speed-run planner, the canonical form
+ * with the result cache and the analyzer against plain bfs(), the default
+ * layout, the live explorer and simple reference versions.
+ *
+ * Every check runs on mazes from each generator and on random wall noise,
+ * which has closed off regions and unreachable goals, at a few sizes,
+ * including odd and non-square ones. Each check prints one line with the
+ * number of cases it ran and how many failed, and describes the first
+ * failures on stderr. The exit status is 1 if any case failed.
+ *
+ *     make check
+ *
+ * Options:
+ *     -n count     mazes per check and size (default 100)
+ *     -f text      only run checks whose name contains text
+ */
+
+
+int mazeCount = 100;
+std::string filter;
+long totalFailed = 0;
+
+
+// Cases and failures of one check
+struct Check
+{
+    std::string name;
+    long cases = 0;
+    long failed = 0;
+
+    explicit Check(const std::string& checkName) : name(checkName) {}
+
+    bool enabled() const { return name.find(filter) != std::string::npos; }
+
+    // Counts one case, and describes it if it failed
+    void expect(bool ok, const std::string& what)
+    {
+        ++cases;
+        if (ok)
+            return;
+        if (++failed <= 5)
+            std::cerr << name << ": " << what << std::endl;
+    }
+
+    void report()
+    {
+        std::cout << name << ": " << cases << " cases, " << failed << " failed" << std::endl;
+        totalFailed += failed;
+    }
+};
+
+
+// Maze k of a check: the four generators in turn, then noise
+template<int m, int n>
+void makeMaze(int k, MazeGenerator<m, n>& generator, Maze<m, n>& maze)
+{
+    const MazeAlgorithm algorithms[4] = {MazeAlgorithm::Backtracker, MazeAlgorithm::Kruskal,
+                                         MazeAlgorithm::Wilson, MazeAlgorithm::Micromouse};
+    if (k % 5 < 4)
+        generator.generate(maze, algorithms[k % 5], 1, k);
+    else
+    {
+        std::srand(k);
+        maze.randomize();
+    }
+}
+
+
+template<int m, int n>
+std::string describe(int k, Node start, Node goal)
+{
+    std::ostringstream ss;
+    ss << m << 'x' << n << " maze " << k << " from " << start.i << ',' << start.j
+       << " to " << goal.i << ',' << goal.j;
+    return ss.str();
+}
+
+
+// Steps of a path, -1 for none
+template<int m, int n>
+int length(bool found, const NodeStack<m, n>& path)
+{
+    return found ? path.size() - 1 : -1;
+}
+
+
+// The wall of cell a that b lies behind, -1 if they are not neighbours
+inline int wallBetween(Node a, Node b)
+{
+    return b.i == a.i + 1 && b.j == a.j ? 0 :
+           b.i == a.i && b.j == a.j + 1 ? 1 :
+           b.i == a.i - 1 && b.j == a.j ? 2 :
+           b.i == a.i && b.j == a.j - 1 ? 3 : -1;
+}
+
+
+// True if the path runs from start to a goal cell through open walls
+template<int m, int n, class MazeT>
+bool validPath(const MazeT& maze, Node start, const BitArray2D<m, n>& goals,
+               const NodeStack<m, n>& path)
+{
+    if (path.size() == 0 || !(path[0] == start))
+        return false;
+
+    for (int k = 0; k + 1 < path.size(); ++k)
+    {
+        Node a = path[k];
+        int wall = wallBetween(a, path[k + 1]);
+        if (wall < 0 || maze.getCellWalls(a.i, a.j)[wall])
+            return false;
+    }
+
+    Node end = path[path.size() - 1];
+    return goals.get(end.i, end.j);
+}
+
+
+// A*, the bidirectional search, the wavefront and bfs() on other wall
+// layouts against bfs(): the same length, or none, and a valid path
+template<int m, int n>
+void checkEngines(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Maze<m, n, CellWalls<m, n>>> cells(new Maze<m, n, CellWalls<m, n>>);
+    unsigned char bytes[Maze<m, n>::byteCount];
+    NodeStack<m, n> path;
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        maze->saveBytes(bytes);
+        cells->loadBytes(bytes);
+        MazeView<m, n> view(bytes);
+
+        for (int q = 0; q < 4; ++q)
+        {
+            // One goal cell, or a few
+            Node start = {int(rng.below(m)), int(rng.below(n))};
+            Node goal = {int(rng.below(m)), int(rng.below(n))};
+            BitArray2D<m, n> goals;
+            goals.set(goal.i, goal.j, true);
+            for (int g = q % 2 ? 3 : 0; g > 0; --g)
+                goals.set(rng.below(m), rng.below(n), true);
+            std::string what = describe<m, n>(k, start, goal);
+
+            int expected = length(bfs<m, n>(*maze, start, goals, path), path);
+            check.expect(expected < 0 || validPath(*maze, start, goals, path), what + ": bfs path");
+
+            bool found = astar<m, n>(*maze, start, goals, path);
+            check.expect(length(found, path) == expected && (!found || validPath(*maze, start, goals, path)),
+                         what + ": astar");
+
+            found = bidirectionalBfs<m, n>(*maze, start, goals, path);
+            check.expect(length(found, path) == expected && (!found || validPath(*maze, start, goals, path)),
+                         what + ": bidir");
+
+            found = wavefront(*maze, start, goals, path);
+            check.expect(length(found, path) == expected && (!found || validPath(*maze, start, goals, path)),
+                         what + ": wavefront");
+
+            found = bfs<m, n>(view, start, goals, path);
+            check.expect(length(found, path) == expected, what + ": bfs on a corpus view");
+
+            found = bfs<m, n>(*cells, start, goals, path);
+            check.expect(length(found, path) == expected, what + ": bfs on CellWalls");
+        }
+    }
+}
+
+
+// PathCache paths and distances against bfs(), with the default tables and
+// with a few rows built lazily, so rows are evicted. The cache is kept from
+// maze to maze and a wall is toggled between queries, so every query after
+// a change must see the new walls.
+template<int m, int n>
+void checkPathCache(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<PathCache<m, n>> full(new PathCache<m, n>);
+    std::unique_ptr<PathCache<m, n>> lazy(new PathCache<m, n>(3, false));
+    NodeStack<m, n> path;
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+
+        for (int q = 0; q < 8; ++q)
+        {
+            Node start = {int(rng.below(m)), int(rng.below(n))};
+            Node goal = {int(rng.below(m)), int(rng.below(n))};
+            BitArray2D<m, n> goals;
+            goals.set(goal.i, goal.j, true);
+            std::string what = describe<m, n>(k, start, goal);
+
+            int expected = length(bfs<m, n>(*maze, start, goals, path), path);
+
+            PathCache<m, n>* caches[2] = {full.get(), lazy.get()};
+            for (PathCache<m, n>* cache : caches)
+            {
+                const char* name = cache == full.get() ? ": full cache" : ": lazy cache";
+                check.expect(cache->distance(*maze, start, goal) == expected, what + name + " distance");
+
+                bool found = cache->path(*maze, start, goal, path);
+                check.expect(length(found, path) == expected && (!found || validPath(*maze, start, goals, path)),
+                             what + name + " path");
+            }
+
+            if (q % 2)
+                maze->setWall(int(rng.below(m)), int(rng.below(n)), int(rng.below(4)), rng.below(2) == 1);
+        }
+    }
+}
+
+
+// TurnSearch against bfs(): a route exactly when bfs() finds one, through
+// open walls, costing what ScorePath() gives it and no more than the score
+// of the bfs() path. The default costs are ScorePath()'s.
+template<int m, int n>
+void checkTurnSearch(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<TurnSearch<m, n>> search(new TurnSearch<m, n>);
+    NodeStack<m, n> path;
+    NodeStack<m, n> turns;
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+
+        for (int q = 0; q < 4; ++q)
+        {
+            // One goal cell, or a few
+            Node start = {int(rng.below(m)), int(rng.below(n))};
+            Node goal = {int(rng.below(m)), int(rng.below(n))};
+            BitArray2D<m, n> goals;
+            goals.set(goal.i, goal.j, true);
+            for (int g = q % 2 ? 3 : 0; g > 0; --g)
+                goals.set(rng.below(m), rng.below(n), true);
+            std::string what = describe<m, n>(k, start, goal);
+
+            bool expected = bfs<m, n>(*maze, start, goals, path);
+            bool found = search->solve(*maze, start, goals, turns);
+            check.expect(found == expected && (!found || validPath(*maze, start, goals, turns)),
+                         what + ": route");
+
+            // Every cost is a multiple of 0.5, so the sums are exact
+            check.expect(!found || (search->cost() == ScorePath(turns) && search->cost() <= ScorePath(path)),
+                         what + ": cost");
+        }
+    }
+}
+
+
+// Open inner walls, each counted once
+template<int m, int n>
+int openWalls(const Maze<m, n>& maze)
+{
+    int open = 0;
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < m; ++i)
+        {
+            std::array<bool, 4> cw = maze.getCellWalls(i, j);
+            open += (i < m - 1 && !cw[0]) + (j < n - 1 && !cw[1]);
+        }
+    return open;
+}
+
+
+// The generators: Backtracker, Kruskal and Wilson mazes are perfect, with
+// every cell reachable and a cycle rank of 0 (m * n - 1 open walls).
+// Micromouse mazes have every cell reachable, an open goal room in the
+// center with one entrance, a start cell open only to +j and a wall at every
+// post outside the goal room. The same seed and stream give the same maze.
+template<int m, int n>
+void checkGenerators(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Maze<m, n>> again(new Maze<m, n>);
+    std::unique_ptr<SearchWorkspace<m, n>> work(new SearchWorkspace<m, n>);
+    const MazeAlgorithm algorithms[4] = {MazeAlgorithm::Backtracker, MazeAlgorithm::Kruskal,
+                                         MazeAlgorithm::Wilson, MazeAlgorithm::Micromouse};
+
+    // The goal room, as Generator.hpp describes it
+    int gi = (m - 1) / 2;
+    int gj = (n - 1) / 2;
+    int gm = (m % 2 == 0 && m >= 4) ? 2 : 1;
+    int gn = (n % 2 == 0 && n >= 4) ? 2 : 1;
+    BitArray2D<m, n> room;
+    for (int i = gi; i < gi + gm; ++i)
+        for (int j = gj; j < gj + gn; ++j)
+            room.set(i, j, true);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        for (MazeAlgorithm algorithm : algorithms)
+        {
+            std::ostringstream ss;
+            ss << m << 'x' << n << ' ' << algorithmName(algorithm) << " maze " << k;
+            std::string what = ss.str();
+
+            generator->generate(*maze, algorithm, 1, k);
+            generator->generate(*again, algorithm, 1, k);
+            check.expect(maze->hash() == again->hash(), what + ": reproducible");
+
+            bool reachable = work->flood(*maze, Node{0, 0}) == m * n;
+            if (algorithm != MazeAlgorithm::Micromouse)
+            {
+                check.expect(reachable && openWalls(*maze) == m * n - 1, what + ": perfect");
+                continue;
+            }
+
+            // Walls inside the room and the walls out of it
+            bool inside = true;
+            int entrances = 0;
+            for (int j = 0; j < n; ++j)
+                for (int i = 0; i < m; ++i)
+                {
+                    std::array<bool, 4> cw = maze->getCellWalls(i, j);
+                    if (i < m - 1 && !cw[0] && room.get(i, j) != room.get(i + 1, j))
+                        ++entrances;
+                    if (j < n - 1 && !cw[1] && room.get(i, j) != room.get(i, j + 1))
+                        ++entrances;
+                    if (i < m - 1 && cw[0] && room.get(i, j) && room.get(i + 1, j))
+                        inside = false;
+                    if (j < n - 1 && cw[1] && room.get(i, j) && room.get(i, j + 1))
+                        inside = false;
+                }
+
+            std::array<bool, 4> start = maze->getCellWalls(m - 1, 0);
+
+            // Inner posts, by the cell below and to the right of them
+            bool posts = true;
+            for (int pj = 1; pj < n; ++pj)
+                for (int pi = 1; pi < m; ++pi)
+                {
+                    bool center = room.get(pi - 1, pj - 1) && room.get(pi, pj - 1) &&
+                                  room.get(pi - 1, pj) && room.get(pi, pj);
+                    std::array<bool, 4> a = maze->getCellWalls(pi - 1, pj - 1);
+                    std::array<bool, 4> b = maze->getCellWalls(pi, pj);
+                    posts = posts && (center || a[0] || a[1] || b[2] || b[3]);
+                }
+
+            check.expect(reachable, what + ": reachable");
+            check.expect(inside && entrances == 1, what + ": goal room");
+            check.expect(start[0] && !start[1] && start[2] && start[3], what + ": start cell");
+            check.expect(posts, what + ": posts");
+        }
+    }
+}
+
+
+// The cells a full flood reaches and their distances against those of the
+// wavefront
+template<int m, int n>
+void checkFloods(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<SearchWorkspace<m, n>> work(new SearchWorkspace<m, n>);
+    std::unique_ptr<Wavefront<m, n>> wave(new Wavefront<m, n>);
+    std::unique_ptr<WallBoard<m, n>> board(new WallBoard<m, n>(*maze));
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        board->build(*maze);
+        Node start = {int(rng.below(m)), int(rng.below(n))};
+
+        int reached = work->flood(*maze, start);
+        check.expect(wave->reach(*board, start) == reached, describe<m, n>(k, start, start) + ": cells reached");
+
+        wave->solve(*board, start, nullptr);
+        bool same = true;
+        for (int j = 0; j < n; ++j)
+            for (int i = 0; i < m; ++i)
+                same = same && wave->distance(i, j) == work->distance(Node{i, j});
+        check.expect(same, describe<m, n>(k, start, start) + ": wavefront distances");
+    }
+}
+
+
+// FloodFill::update() after random changes to the walls of one cell against
+// a fresh flood from the goal
+template<int m, int n>
+void checkRepairs(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<SearchWorkspace<m, n>> work(new SearchWorkspace<m, n>);
+    std::unique_ptr<FloodFill<m, n>> field(new FloodFill<m, n>);
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        Node goal = {int(rng.below(m)), int(rng.below(n))};
+        field->reset(*maze, goal);
+
+        for (int change = 0; change < 20; ++change)
+        {
+            // Close or open each inner wall of the cell with even odds
+            Node cell = {int(rng.below(m)), int(rng.below(n))};
+            std::array<bool, 4> oldWalls = maze->getCellWalls(cell.i, cell.j);
+            std::array<bool, 4> cw;
+            for (int wall = 0; wall < 4; ++wall)
+                cw[wall] = rng.below(2) == 1;
+            cw[0] = cw[0] || cell.i == m - 1;
+            cw[1] = cw[1] || cell.j == n - 1;
+            cw[2] = cw[2] || cell.i == 0;
+            cw[3] = cw[3] || cell.j == 0;
+            maze->setCellWalls(cell.i, cell.j, cw);
+            field->update(*maze, cell, oldWalls);
+
+            work->flood(*maze, goal);
+            bool same = true;
+            for (int j = 0; j < n; ++j)
+                for (int i = 0; i < m; ++i)
+                {
+                    int d = work->distance(Node{i, j});
+                    same = same && field->distance(i, j) == (d < 0 ? FloodFill<m, n>::unreachable : d);
+                }
+
+            std::ostringstream ss;
+            ss << describe<m, n>(k, cell, goal) << ": distances after change " << change;
+            check.expect(same, ss.str());
+        }
+    }
+}
+
+
+// True if both mazes have the same walls around every cell
+template<int m, int n, class MazeA, class MazeB>
+bool sameWalls(const MazeA& a, const MazeB& b)
+{
+    for (int j = 0; j < n; ++j)
+        for (int i = 0; i < m; ++i)
+            if (a.getCellWalls(i, j) != b.getCellWalls(i, j))
+                return false;
+    return true;
+}
+
+
+// MazeHistory through random wall edits, direct edits to the maze, undos,
+// redos and jumps against a copy of the maze at every position. Every other
+// maze takes snapshots every few deltas, so jumps also load snapshots.
+template<int m, int n>
+void checkHistory(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::vector<Maze<m, n>> states; // The maze at each position
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        std::unique_ptr<MazeHistory<m, n>> history(
+            new MazeHistory<m, n>(k % 2 ? 3 : MazeHistory<m, n>::defaultSnapshotDeltas()));
+        history->reset(*maze);
+        states.assign(1, *maze);
+        int position = 0;
+
+        for (int op = 0; op < 60; ++op)
+        {
+            int action = int(rng.below(6));
+            Node cell = {int(rng.below(m)), int(rng.below(n))};
+            int wall = int(rng.below(4));
+            bool b = rng.below(2) == 1;
+            bool border = (0 == wall && cell.i == m - 1) || (1 == wall && cell.j == n - 1) ||
+                          (2 == wall && cell.i == 0) || (3 == wall && cell.j == 0);
+
+            // Everything but a direct edit first commits the direct edits
+            // made since the last one, which drops the edits after it
+            bool pending = !sameWalls<m, n>(*maze, states[position]);
+            if (action != 1 && pending)
+            {
+                states.resize(position + 1);
+                states.push_back(*maze);
+                ++position;
+            }
+
+            std::ostringstream ss;
+            ss << describe<m, n>(k, cell, cell) << ": op " << op;
+            bool ok = true;
+            if (0 == action)
+            {
+                ss << " setWall";
+                bool changed = !border && maze->getCellWalls(cell.i, cell.j)[wall] != b;
+                ok = history->setWall(*maze, cell.i, cell.j, wall, b) == !border;
+                if (changed)
+                {
+                    states.resize(position + 1);
+                    states.push_back(*maze);
+                    ++position;
+                }
+            }
+            else if (1 == action)
+            {
+                ss << " direct edit";
+                maze->setWall(cell.i, cell.j, wall, b);
+            }
+            else if (2 == action)
+            {
+                ss << " commit";
+                ok = (history->commit(*maze) > 0) == pending;
+            }
+            else if (3 == action)
+            {
+                ss << " undo";
+                ok = history->undo(*maze) == (position > 0);
+                position -= position > 0 ? 1 : 0;
+            }
+            else if (4 == action)
+            {
+                ss << " redo";
+                bool possible = position + 1 < int(states.size());
+                ok = history->redo(*maze) == possible;
+                position += possible ? 1 : 0;
+            }
+            else
+            {
+                // Sometimes just outside the history
+                int to = int(rng.below(states.size() + 2)) - 1;
+                ss << " jump to " << to;
+                bool possible = to >= 0 && to < int(states.size());
+                ok = history->jump(*maze, to) == possible;
+                position = possible ? to : position;
+            }
+
+            // A direct edit stays uncommitted until the next operation
+            const Maze<m, n>& expected = 1 == action ? *maze : states[position];
+            check.expect(ok && sameWalls<m, n>(*maze, expected) && history->position() == position &&
+                         history->size() == int(states.size()) - 1, ss.str());
+        }
+    }
+}
+
+
+// True if two buffers of Maze::saveBytes() hold the same walls. The unused
+// bits at the end of each plane may differ, as in Maze::hash().
+template<int m, int n>
+bool sameBytes(const unsigned char* a, const unsigned char* b)
+{
+    const int mBytes = ((m - 1) * n + 7) / 8;
+    for (int k = 0; k < (m - 1) * n; ++k)
+        if ((a[k / 8] ^ b[k / 8]) >> (k % 8) & 1)
+            return false;
+    for (int k = 0; k < m * (n - 1); ++k)
+        if ((a[mBytes + k / 8] ^ b[mBytes + k / 8]) >> (k % 8) & 1)
+            return false;
+    return true;
+}
+
+
+template<int r, int c>
+bool samePlane(const BitArray2D<r, c>& a, const BitArray2D<r, c>& b)
+{
+    for (int j = 0; j < c; ++j)
+        for (int i = 0; i < r; ++i)
+            if (a.get(i, j) != b.get(i, j))
+                return false;
+    return true;
+}
+
+
+// CellWalls against PlaneWalls: the same walls in the saved bytes, strings
+// and planes, and the same hash after loading, after setting single walls, and after a round trip
+// through the other layout, and known walls that follow setWall(),
+// forgetWalls() and fill()
+template<int m, int n>
+void checkLayouts(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> planes(new Maze<m, n>);
+    std::unique_ptr<Maze<m, n, CellWalls<m, n>>> cells(new Maze<m, n, CellWalls<m, n>>);
+    std::unique_ptr<Maze<m, n>> back(new Maze<m, n>);
+    unsigned char bytes[Maze<m, n>::byteCount];
+    unsigned char cellBytes[Maze<m, n>::byteCount];
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        std::ostringstream ss;
+        ss << m << 'x' << n << " maze " << k;
+        std::string what = ss.str();
+
+        makeMaze(k, *generator, *planes);
+        planes->saveBytes(bytes);
+        cells->loadBytes(bytes);
+        cells->saveBytes(cellBytes);
+        check.expect(sameBytes<m, n>(bytes, cellBytes) && sameWalls<m, n>(*planes, *cells) && cells->hash() == planes->hash() &&
+                     samePlane(cells->getMWalls(), planes->getMWalls()) &&
+                     samePlane(cells->getNWalls(), planes->getNWalls()), what + ": loaded bytes");
+
+        check.expect(back->load(cells->save()) &&
+                     back->hash() == planes->hash() && sameWalls<m, n>(*back, *planes), what + ": saved string");
+
+        // Every inner wall is known until forgotten
+        bool known = true;
+        for (int j = 0; j < n; ++j)
+            for (int i = 0; i < m; ++i)
+                known = known && cells->getKnownWalls(i, j) == std::array<bool, 4>{{true, true, true, true}};
+        check.expect(known, what + ": known walls after loading");
+
+        for (int change = 0; change < 20; ++change)
+        {
+            int i = rng.below(m);
+            int j = rng.below(n);
+            int wall = rng.below(4);
+            bool b = rng.below(2) == 1;
+            check.expect(cells->setWall(i, j, wall, b) == planes->setWall(i, j, wall, b), what + ": setWall");
+        }
+        check.expect(sameWalls<m, n>(*planes, *cells) && cells->hash() == planes->hash(), what + ": set walls");
+
+        // After forgetting, the cells only know their border walls and the
+        // walls set since; the pessimistic view closes the rest
+        cells->forgetWalls();
+        Node v = {int(rng.below(m)), int(rng.below(n))};
+        std::array<bool, 4> cw = planes->getCellWalls(v.i, v.j);
+        cells->setCellWalls(v.i, v.j, cw);
+
+        bool forgotten = true;
+        for (int j = 0; j < n; ++j)
+        {
+            for (int i = 0; i < m; ++i)
+            {
+                auto kw = cells->getKnownWalls(i, j);
+                auto open = cells->getCellWalls(i, j);
+                auto closed = cells->getClosedWalls(i, j);
+                for (int wall = 0; wall < 4; ++wall)
+                {
+                    Node u = {i + (wall == 0) - (wall == 2), j + (wall == 1) - (wall == 3)};
+                    bool border = u.i < 0 || u.j < 0 || u.i >= m || u.j >= n;
+                    bool sensed = (i == v.i && j == v.j) || (u.i == v.i && u.j == v.j);
+                    bool there = planes->getCellWalls(i, j)[wall];
+                    forgotten = forgotten && kw[wall] == (border || sensed) &&
+                                open[wall] == (border || (sensed && there)) &&
+                                closed[wall] == (border || !sensed || there);
+                }
+            }
+        }
+        check.expect(forgotten, what + ": known walls after forgetWalls");
+
+        cells->fill();
+        planes->fill();
+        check.expect(cells->getKnownWalls(v.i, v.j) == std::array<bool, 4>{{true, true, true, true}} &&
+                     cells->hash() == planes->hash(), what + ": fill");
+    }
+}
+
+
+// Mapping runs with the WallMap in CellWalls, one maze with known walls,
+// against the default two PlaneWalls mazes: the same steps, the same
+// wall states and views, and the same final path
+template<int m, int n>
+void checkWallMaps(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Explorer<m, n>> planes(new Explorer<m, n>);
+    std::unique_ptr<Explorer<m, n, CandidateFirst<m, n>, CellWalls<m, n>>> cells(
+        new Explorer<m, n, CandidateFirst<m, n>, CellWalls<m, n>>);
+    unsigned char bytes[Maze<m, n>::byteCount];
+    unsigned char cellBytes[Maze<m, n>::byteCount];
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        Node start = {int(rng.below(m)), int(rng.below(n))};
+        Node goal = {int(rng.below(m)), int(rng.below(n))};
+        std::string what = describe<m, n>(k, start, goal);
+
+        planes->beginMapping(*maze, start, goal);
+        cells->beginMapping(*maze, start, goal);
+        bool same = true;
+        bool running = true;
+        for (int step = 0; running && step < 16 * m * n; ++step)
+        {
+            running = planes->step(*maze);
+            same = same && cells->step(*maze) == running && cells->position() == planes->position();
+
+            Node v = planes->position();
+            for (int wall = 0; wall < 4; ++wall)
+                same = same && cells->walls().get(v.i, v.j, wall) == planes->walls().get(v.i, v.j, wall);
+        }
+        check.expect(same, what + ": steps");
+
+        bool states = true;
+        for (int j = 0; j < n; ++j)
+            for (int i = 0; i < m; ++i)
+                for (int wall = 0; wall < 4; ++wall)
+                    states = states && cells->walls().get(i, j, wall) == planes->walls().get(i, j, wall);
+        check.expect(states, what + ": wall states");
+
+        planes->walls().pessimistic().saveBytes(bytes);
+        cells->walls().pessimistic().saveBytes(cellBytes);
+        bool views = sameBytes<m, n>(bytes, cellBytes) &&
+                     sameWalls<m, n>(planes->walls().pessimistic(), cells->walls().pessimistic());
+        planes->walls().optimistic().saveBytes(bytes);
+        cells->walls().optimistic().saveBytes(cellBytes);
+        views = views && sameBytes<m, n>(bytes, cellBytes);
+        check.expect(views, what + ": optimistic and pessimistic views");
+
+        const NodeStack<m, n>& a = planes->finalPath();
+        const NodeStack<m, n>& b = cells->finalPath();
+        bool path = a.size() == b.size();
+        for (int p = 0; path && p < a.size(); ++p)
+            path = a[p] == b[p];
+        check.expect(path, what + ": final path");
+    }
+}
+
+
+// A mapping run recorded with RunRecording, replayed by seeking to random
+// steps before and after saving and loading it, against the state of the
+// explorer after each step. Loading a truncated file fails and leaves an
+// empty recording.
+template<int m, int n>
+void checkRecordings(Check& check)
+{
+    struct Live
+    {
+        Maze<m, n> optimistic;
+        Maze<m, n> pessimistic;
+        BitArray2D<m, n> unvisited;
+        BitArray2D<m, n> inferred;
+        Node position;
+    };
+
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Explorer<m, n>> explorer(new Explorer<m, n>);
+    std::vector<Live> live;
+    unsigned char bytes[Maze<m, n>::byteCount];
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        Node start = {int(rng.below(m)), int(rng.below(n))};
+        Node goal = {int(rng.below(m)), int(rng.below(n))};
+        std::string what = describe<m, n>(k, start, goal);
+
+        // Short keyframe intervals, so seeks cross many keyframes
+        std::unique_ptr<RunRecording<m, n>> recording(new RunRecording<m, n>(k % 2 ? 5 : 16));
+        recording->setSeed(k, m * 1000 + n);
+        explorer->beginMapping(*maze, start, goal);
+        recording->begin(*maze, start, goal, true, *explorer);
+
+        live.clear();
+        for (int step = 0; ; ++step)
+        {
+            live.push_back(Live());
+            Live& state = live.back();
+            explorer->walls().optimistic().saveBytes(bytes);
+            state.optimistic.loadBytes(bytes);
+            explorer->walls().pessimistic().saveBytes(bytes);
+            state.pessimistic.loadBytes(bytes);
+            state.unvisited = explorer->unvisited();
+            state.inferred = explorer->inferred();
+            state.position = explorer->position();
+
+            if (!explorer->running() || step >= 16 * m * n)
+                break;
+            explorer->step(*maze);
+            recording->record(*explorer);
+        }
+        check.expect(recording->steps() + 1 == int(live.size()), what + ": steps recorded");
+
+        std::stringstream file;
+        check.expect(recording->save(file), what + ": save");
+        std::unique_ptr<RunRecording<m, n>> loaded(new RunRecording<m, n>);
+        check.expect(loaded->load(file) && loaded->step() == 0 && loaded->steps() == recording->steps() &&
+                     loaded->mapping() && loaded->start() == start && loaded->goal() == goal &&
+                     loaded->seed() == std::uint64_t(k) && loaded->stream() == std::uint64_t(m * 1000 + n) &&
+                     sameWalls<m, n>(loaded->maze(), *maze), what + ": load");
+
+        RunRecording<m, n>* replays[2] = {recording.get(), loaded.get()};
+        for (RunRecording<m, n>* replay : replays)
+        {
+            for (int seek = 0; seek < 30; ++seek)
+            {
+                // Sometimes just outside the run
+                int to = int(rng.below(live.size() + 2)) - 1;
+                int before = replay->step();
+                bool possible = to >= 0 && to < int(live.size());
+                bool ok = replay->seek(to) == possible && replay->step() == (possible ? to : before);
+
+                const Live& state = live[replay->step()];
+                ok = ok && sameWalls<m, n>(replay->discovered(), state.optimistic) &&
+                     sameWalls<m, n>(replay->pessimistic(), state.pessimistic) &&
+                     samePlane(replay->unvisited(), state.unvisited) &&
+                     samePlane(replay->inferred(), state.inferred) && replay->position() == state.position;
+
+                std::ostringstream ss;
+                ss << what << ": " << (replay == loaded.get() ? "loaded " : "") << "seek to " << to;
+                check.expect(ok, ss.str());
+            }
+        }
+
+        std::string text = file.str();
+        std::istringstream truncated(text.substr(0, text.size() - 1));
+        check.expect(!loaded->load(truncated) && loaded->steps() == 0 && loaded->step() == 0 &&
+                     !loaded->seek(1), what + ": truncated load");
+    }
+}
+
+
+// Simulated search runs: the mouse ends on the goal exactly when bfs()
+// finds a path, after at least as many steps. Search and mapping runs that
+// start on the goal are over before the first step and leave the mouse
+// where it is.
+template<int m, int n>
+void checkSearches(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Simulator<m, n>> sim(new Simulator<m, n>);
+    NodeStack<m, n> path;
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        Node start = {int(rng.below(m)), int(rng.below(n))};
+        Node goal = {int(rng.below(m)), int(rng.below(n))};
+        std::string what = describe<m, n>(k, start, goal);
+
+        int expected = length(bfs<m, n>(*maze, start, goal, path), path);
+        sim->startSearch(*maze, start, goal);
+        sim->finish();
+        check.expect((sim->position() == goal) == (expected >= 0) &&
+                     (expected < 0 || sim->stepsTaken() >= expected), what + ": search run");
+
+        what = describe<m, n>(k, goal, goal);
+        sim->startSearch(*maze, goal, goal);
+        bool over = !sim->running() && !sim->step() && sim->stepsTaken() == 0;
+        check.expect(over && sim->position() == goal, what + ": search from the goal");
+
+        sim->startMapping(*maze, goal, goal);
+        over = !sim->running() && !sim->step() && sim->stepsTaken() == 0;
+        const NodeStack<m, n>& route = sim->state().finalPath();
+        check.expect(over && sim->position() == goal && sim->state().proven() &&
+                     route.size() == 1 && route[0] == goal, what + ": mapping from the goal");
+    }
+}
+
+
+// True if the segments of a speed run start at rest, join at the same
+// speed, take every turn at or below its turn speed and top speed, change
+// speed on straights no faster than the robot can, and add up to the time
+template<int m, int n>
+bool validRun(const SpeedRunPlanner<m, n>& planner, const RobotParams& robot)
+{
+    const float slack = 1e-3f;
+    float speed = 0.f;
+    float total = 0.f;
+
+    for (const RunSegment& seg : planner.segments())
+    {
+        if (std::fabs(seg.entrySpeed - speed) > slack || seg.peakSpeed > robot.maxSpeed + slack ||
+            seg.time < 0.f)
+            return false;
+
+        float limit = seg.move == RunMove::Turn90 ? robot.turn90Speed :
+                      seg.move == RunMove::Turn180 ? robot.turn180Speed :
+                      seg.move == RunMove::Turn45In || seg.move == RunMove::Turn45Out ? robot.turn45Speed :
+                      robot.maxSpeed;
+        float change = std::fabs(seg.exitSpeed * seg.exitSpeed - seg.entrySpeed * seg.entrySpeed);
+        if (seg.exitSpeed > std::fmin(limit, robot.maxSpeed) + slack ||
+            change > 2.f * robot.acceleration * seg.length * (1.f + slack) + slack)
+            return false;
+
+        speed = seg.exitSpeed;
+        total += seg.time;
+    }
+
+    return std::fabs(total - planner.time()) <= slack * (1.f + total);
+}
+
+
+// Speed runs for the default robot and a slow one: a run exactly when bfs()
+// finds a path, through open walls and no shorter than it, with a feasible
+// profile
+template<int m, int n>
+void checkSpeedRuns(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<SpeedRunPlanner<m, n>> planner(new SpeedRunPlanner<m, n>);
+    NodeStack<m, n> path;
+    Rng rng(m * 1000 + n);
+
+    RobotParams robots[2];
+    robots[1].maxSpeed = 1.0f;
+    robots[1].acceleration = 0.5f;
+    robots[1].turn90Speed = 1.5f;
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        Node start = {int(rng.below(m)), int(rng.below(n))};
+        Node goal = {int(rng.below(m)), int(rng.below(n))};
+        BitArray2D<m, n> goals;
+        goals.set(goal.i, goal.j, true);
+        if (k % 2)
+            goals.set(rng.below(m), rng.below(n), true);
+
+        int expected = length(bfs<m, n>(*maze, start, goals, path), path);
+
+        for (const RobotParams& robot : robots)
+        {
+            std::string what = describe<m, n>(k, start, goal) +
+                               (&robot == robots ? "" : " for the slow robot");
+
+            bool found = planner->solve(*maze, start, goals, robot);
+            check.expect(found == (expected >= 0), what + ": run found");
+            if (!found)
+                continue;
+
+            planner->cells(path);
+            check.expect(validPath(*maze, start, goals, path) && path.size() - 1 >= expected,
+                         what + ": run cells");
+            check.expect(validRun(*planner, robot), what + ": run profile");
+        }
+    }
+}
+
+
+// Mazes written with CorpusWriter and read back through Corpus: the same
+// walls and sizes, and appending a maze of another size fails and writes
+// nothing
+template<int m, int n>
+void checkCorpus(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Maze<m + 1, n>> taller(new Maze<m + 1, n>);
+    std::unique_ptr<Maze<m, n - 1>> narrower(new Maze<m, n - 1>);
+
+    char name[] = "/tmp/maze-check-XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+    {
+        check.expect(false, "cannot create a corpus file");
+        return;
+    }
+    close(fd);
+
+    std::ostringstream ss;
+    ss << m << 'x' << n << " corpus";
+    std::string what = ss.str();
+
+    CorpusWriter writer;
+    check.expect(writer.open(name, m, n), what + ": open for writing");
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        check.expect(writer.append(*maze), what + ": append");
+        check.expect(!writer.append(*taller) && !writer.append(*narrower), what + ": append another size");
+    }
+    check.expect(writer.close(), what + ": close");
+
+    Corpus corpus;
+    bool opened = corpus.open(name);
+    check.expect(opened && corpus.rows() == m && corpus.cols() == n &&
+                 corpus.size() == std::size_t(mazeCount), what + ": header");
+    for (int k = 0; opened && k < mazeCount && k < int(corpus.size()); ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        check.expect(sameWalls<m, n>(*maze, corpus.view<m, n>(k)), what + ": record " + std::to_string(k));
+    }
+
+    corpus.close();
+    std::remove(name);
+}
+
+
+// The image of the maze under symmetry t of CanonicalMaze, built a wall at a
+// time
+template<int m, int n>
+void makeImage(const Maze<m, n>& maze, int t, Maze<m, n>& image)
+{
+    image.clear();
+    for (int j = 0; j < n; ++j)
+    {
+        for (int i = 0; i < m; ++i)
+        {
+            auto cw = maze.getCellWalls(i, j);
+            Node a = CanonicalMaze<m, n>::transform(t, Node{i, j});
+            for (int wall = 0; wall < 2; ++wall)
+            {
+                Node b = wall == 0 ? Node{i + 1, j} : Node{i, j + 1};
+                if (cw[wall] && b.i < m && b.j < n)
+                    image.setWall(a.i, a.j, wallBetween(a, CanonicalMaze<m, n>::transform(t, b)), true);
+            }
+        }
+    }
+}
+
+
+// Cells of a path as "i,j;i,j", from the top
+template<int m, int n>
+std::string pathText(const NodeStack<m, n>& path)
+{
+    std::ostringstream ss;
+    for (int k = 0; k < path.size(); ++k)
+        ss << (k > 0 ? ";" : "") << path[k].i << ',' << path[k].j;
+    return ss.str();
+}
+
+
+template<int m, int n>
+bool readPathText(const std::string& text, NodeStack<m, n>& path)
+{
+    std::vector<Node> cells;
+    std::istringstream ss(text);
+    Node v;
+    char comma = 0;
+    while (ss >> v.i >> comma >> v.j && comma == ',' && int(cells.size()) < m * n)
+    {
+        cells.push_back(v);
+        ss.ignore(1);
+    }
+
+    path.resize(int(cells.size()));
+    for (int k = 0; k < int(cells.size()); ++k)
+        path.set(k, cells[k]);
+    return !cells.empty();
+}
+
+
+// Every rotation and mirror of a maze with its start and goal against the
+// maze: the same key, toCanonical() and fromCanonical() inverse to each
+// other, and a bfs() path solved once in the canonical orientation, kept in
+// a ResultCache file and mapped back with fromCanonical(), as long as the
+// path bfs() finds on the image itself. The second pass reopens the file
+// and must find every entry there.
+template<int m, int n>
+void checkSymmetries(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<Maze<m, n>> image(new Maze<m, n>);
+    std::unique_ptr<Maze<m, n>> solved(new Maze<m, n>);
+    std::unique_ptr<CanonicalMaze<m, n>> original(new CanonicalMaze<m, n>);
+    std::unique_ptr<CanonicalMaze<m, n>> canonical(new CanonicalMaze<m, n>);
+    NodeStack<m, n> path;
+    NodeStack<m, n> mapped;
+
+    char name[] = "/tmp/maze-check-XXXXXX";
+    int fd = mkstemp(name);
+    if (fd < 0)
+    {
+        check.expect(false, "cannot create a cache file");
+        return;
+    }
+    close(fd);
+
+    ResultCache cache;
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (!cache.open(name))
+        {
+            check.expect(false, cache.error());
+            break;
+        }
+
+        Rng rng(m * 1000 + n);
+        for (int k = 0; k < mazeCount; ++k)
+        {
+            makeMaze(k, *generator, *maze);
+            Node start = {int(rng.below(m)), int(rng.below(n))};
+            Node goal = {int(rng.below(m)), int(rng.below(n))};
+            original->compute(*maze, start, goal);
+
+            for (int t = 0; t < 8; ++t)
+            {
+                if (t & 1 && m != n)
+                    continue;
+
+                std::ostringstream ss;
+                ss << describe<m, n>(k, start, goal) << " under symmetry " << t;
+                std::string what = ss.str();
+
+                makeImage(*maze, t, *image);
+                Node s = CanonicalMaze<m, n>::transform(t, start);
+                Node g = CanonicalMaze<m, n>::transform(t, goal);
+                canonical->compute(*image, s, g);
+                check.expect(canonical->key() == original->key() &&
+                             canonical->start() == original->start() &&
+                             canonical->goal() == original->goal(), what + ": key");
+
+                bool inverse = true;
+                for (int j = 0; j < n; ++j)
+                    for (int i = 0; i < m; ++i)
+                    {
+                        Node v = {i, j};
+                        inverse = inverse && canonical->fromCanonical(canonical->toCanonical(v)) == v;
+                    }
+                check.expect(inverse, what + ": fromCanonical(toCanonical())");
+
+                const std::string* value = cache.find(canonical->key(), "check");
+                check.expect(pass == 0 || value, what + ": reopened cache entry");
+                if (!value)
+                {
+                    canonical->copyTo(*solved);
+                    bool solvable = bfs<m, n>(*solved, canonical->start(), canonical->goal(), path);
+                    std::string text = solvable ? pathText(path) : "-";
+                    check.expect(cache.insert(canonical->key(), "check", text), what + ": cache insert");
+                    value = cache.find(canonical->key(), "check");
+                }
+
+                BitArray2D<m, n> goals;
+                goals.set(g.i, g.j, true);
+                bool found = value && readPathText(*value, mapped);
+                for (int p = 0; found && p < mapped.size(); ++p)
+                    mapped.set(p, canonical->fromCanonical(mapped[p]));
+
+                int expected = length(bfs<m, n>(*image, s, goals, path), path);
+                check.expect(length(found, mapped) == expected && (!found || validPath(*image, s, goals, mapped)),
+                             what + ": cached path");
+            }
+        }
+    }
+
+    cache.close();
+    std::remove(name);
+}
+
+
+// MazeStats worked out a cell at a time: one breadth-first search from the
+// start for the distances and the path counts, a flood from every cell not
+// yet seen for the components, and another through the cells with two open
+// sides for the corridors
+template<int m, int n>
+void referenceStats(const Maze<m, n>& maze, Node start, const BitArray2D<m, n>& goals,
+                    MazeStats& stats)
+{
+    const int cells = m * n;
+    const int di[4] = {1, 0, -1, 0};
+    const int dj[4] = {0, 1, 0, -1};
+    std::vector<int> sides(cells, 0);
+    std::vector<int> dist(cells, -1);
+    std::vector<std::uint64_t> paths(cells, 0);
+    std::vector<int> group(cells, -1);
+    std::vector<int> order;
+    std::vector<int> stack;
+    int openWalls = 0;
+
+    stats = MazeStats();
+    for (int c = 0; c < cells; ++c)
+    {
+        auto cw = maze.getCellWalls(c % m, c / m);
+        for (int wall = 0; wall < 4; ++wall)
+            sides[c] += !cw[wall];
+        openWalls += sides[c];
+        stats.deadEnds += sides[c] == 1;
+    }
+    openWalls /= 2;
+
+    // Paths into a cell come from its neighbours one step closer, which are
+    // all counted before it leaves the queue
+    dist[start.i + start.j * m] = 0;
+    paths[start.i + start.j * m] = 1;
+    order.push_back(start.i + start.j * m);
+    for (std::size_t head = 0; head < order.size(); ++head)
+    {
+        int c = order[head];
+        auto cw = maze.getCellWalls(c % m, c / m);
+        for (int wall = 0; wall < 4; ++wall)
+        {
+            int x = c + di[wall] + dj[wall] * m;
+            if (cw[wall])
+                continue;
+            if (dist[x] < 0)
+            {
+                dist[x] = dist[c] + 1;
+                order.push_back(x);
+            }
+            if (dist[x] == dist[c] + 1)
+                paths[x] = paths[x] + paths[c] < paths[x] ? UINT64_MAX : paths[x] + paths[c];
+        }
+    }
+    stats.reachable = int(order.size());
+    stats.longestShortest = dist[order.back()];
+
+    for (int c = 0; c < cells; ++c)
+    {
+        if (!goals.get(c % m, c / m) || dist[c] < 0)
+            continue;
+        if (stats.shortestLength < 0 || dist[c] < stats.shortestLength)
+        {
+            stats.shortestLength = dist[c];
+            stats.shortestPaths = 0;
+        }
+        if (dist[c] == stats.shortestLength)
+        {
+            std::uint64_t sum = stats.shortestPaths + paths[c];
+            stats.shortestPaths = sum < paths[c] ? UINT64_MAX : sum;
+        }
+    }
+
+    // Components, then corridors, each found with a depth-first flood that
+    // only enters the cells it may
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::fill(group.begin(), group.end(), -1);
+        for (int c = 0; c < cells; ++c)
+        {
+            if (group[c] >= 0 || (pass == 1 && sides[c] != 2))
+                continue;
+
+            int size = 0;
+            group[c] = c;
+            stack.push_back(c);
+            while (!stack.empty())
+            {
+                int v = stack.back();
+                stack.pop_back();
+                ++size;
+                auto cw = maze.getCellWalls(v % m, v / m);
+                for (int wall = 0; wall < 4; ++wall)
+                {
+                    int x = v + di[wall] + dj[wall] * m;
+                    if (!cw[wall] && group[x] < 0 && (pass == 0 || sides[x] == 2))
+                    {
+                        group[x] = c;
+                        stack.push_back(x);
+                    }
+                }
+            }
+
+            if (pass == 0)
+                ++stats.components;
+            else
+            {
+                int bin = 0;
+                while (bin < corridorBins - 1 && (1 << bin) < size)
+                    ++bin;
+                ++stats.corridors[bin];
+            }
+        }
+    }
+    stats.loops = openWalls - cells + stats.components;
+}
+
+
+// MazeAnalyzer against referenceStats() on every field, on the mazes of the
+// other checks and on open mazes, where the path counts saturate
+template<int m, int n>
+void checkAnalyzer(Check& check)
+{
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    std::unique_ptr<MazeAnalyzer<m, n>> analyzer(new MazeAnalyzer<m, n>);
+    Rng rng(m * 1000 + n);
+
+    for (int k = 0; k < mazeCount; ++k)
+    {
+        makeMaze(k, *generator, *maze);
+        if (k % 10 == 9)
+            maze->clear();
+
+        Node start = {int(rng.below(m)), int(rng.below(n))};
+        Node goal = {int(rng.below(m)), int(rng.below(n))};
+        BitArray2D<m, n> goals;
+        goals.set(goal.i, goal.j, true);
+        for (int g = k % 3; g > 0; --g)
+            goals.set(rng.below(m), rng.below(n), true);
+
+        MazeStats stats;
+        MazeStats expected;
+        analyzer->analyze(*maze, start, goals, stats);
+        referenceStats(*maze, start, goals, expected);
+
+        std::string what = describe<m, n>(k, start, goal);
+        check.expect(stats.reachable == expected.reachable &&
+                     stats.longestShortest == expected.longestShortest, what + ": reachable cells");
+        check.expect(stats.shortestLength == expected.shortestLength &&
+                     stats.shortestPaths == expected.shortestPaths, what + ": shortest paths");
+        check.expect(stats.deadEnds == expected.deadEnds, what + ": dead ends");
+        check.expect(stats.components == expected.components && stats.loops == expected.loops,
+                     what + ": components and loops");
+        check.expect(std::equal(stats.corridors, stats.corridors + corridorBins, expected.corridors),
+                     what + ": corridors");
+    }
+}
+
+
+template<int m, int n>
+void checkSize()
+{
+    Check engines("engines");
+    if (engines.enabled())
+    {
+        checkEngines<m, n>(engines);
+        engines.report();
+    }
+
+    Check pathCache("path cache");
+    if (pathCache.enabled())
+    {
+        checkPathCache<m, n>(pathCache);
+        pathCache.report();
+    }
+
+    Check turns("turn search");
+    if (turns.enabled())
+    {
+        checkTurnSearch<m, n>(turns);
+        turns.report();
+    }
+
+    Check generators("generators");
+    if (generators.enabled())
+    {
+        checkGenerators<m, n>(generators);
+        generators.report();
+    }
+
+    Check floods("floods");
+    if (floods.enabled())
+    {
+        checkFloods<m, n>(floods);
+        floods.report();
+    }
+
+    Check repairs("repairs");
+    if (repairs.enabled())
+    {
+        checkRepairs<m, n>(repairs);
+        repairs.report();
+    }
+
+    Check histories("histories");
+    if (histories.enabled())
+    {
+        checkHistory<m, n>(histories);
+        histories.report();
+    }
+
+    Check searches("searches");
+    if (searches.enabled())
+    {
+        checkSearches<m, n>(searches);
+        searches.report();
+    }
+
+    Check layouts("layouts");
+    if (layouts.enabled())
+    {
+        checkLayouts<m, n>(layouts);
+        layouts.report();
+    }
+
+    Check wallMaps("wall maps");
+    if (wallMaps.enabled())
+    {
+        checkWallMaps<m, n>(wallMaps);
+        wallMaps.report();
+    }
+
+    Check recordings("recordings");
+    if (recordings.enabled())
+    {
+        checkRecordings<m, n>(recordings);
+        recordings.report();
+    }
+
+    Check runs("speed runs");
+    if (runs.enabled())
+    {
+        checkSpeedRuns<m, n>(runs);
+        runs.report();
+    }
+
+    Check corpus("corpus");
+    if (corpus.enabled())
+    {
+        checkCorpus<m, n>(corpus);
+        corpus.report();
+    }
+
+    Check symmetries("symmetries");
+    if (symmetries.enabled())
+    {
+        checkSymmetries<m, n>(symmetries);
+        symmetries.report();
+    }
+
+    Check analyzer("analyzer");
+    if (analyzer.enabled())
+    {
+        checkAnalyzer<m, n>(analyzer);
+        analyzer.report();
+    }
+}
+
+
+int main(int argc, char** argv)
+{
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        std::string opt = argv[arg];
+        if (opt == "-n" && arg + 1 < argc)
+            mazeCount = std::atoi(argv[++arg]);
+        else if (opt == "-f" && arg + 1 < argc)
+            filter = argv[++arg];
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [-n count] [-f filter]" << std::endl;
+            return 2;
+        }
+    }
+
+    std::cout << "16x16" << std::endl;
+    checkSize<16, 16>();
+    std::cout << "32x32" << std::endl;
+    checkSize<32, 32>();
+    std::cout << "7x12" << std::endl;
+    checkSize<7, 12>();
+    std::cout << "70x33" << std::endl;
+    checkSize<70, 33>();
+
+    return totalFailed > 0 ? 1 : 0;
+}
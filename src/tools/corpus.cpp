@@ -0,0 +1,214 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "Corpus.hpp"
+
+
+/* Converts between the text maze format and binary corpus files.
+ *
+ *     maze-corpus pack [in.txt] out.mzc
+ *         reads one maze per line (the first word of each line, in the format
+ *         produced by Maze::save(); stdin if no input file is given) and
+ *         writes them to a corpus. All mazes must have the same size.
+ *     maze-corpus unpack in.mzc
+ *         writes every maze of a corpus to stdout, one per line
+ *     maze-corpus info in.mzc
+ *         prints the size and number of mazes in a corpus
+ *
+ * Sizes up to 256x256 are supported. Empty lines and lines starting with '#'
+ * are skipped.
+ */
+
+
+int usage(const char* name)
+{
+    std::cerr << "usage: " << name << " pack [in.txt] out.mzc" << std::endl
+              << "       " << name << " unpack in.mzc" << std::endl
+              << "       " << name << " info in.mzc" << std::endl;
+    return 2;
+}
+
+
+// Converts the hex digits of a maze string to record bytes. The text format
+// is the same byte sequence, two digits per byte.
+bool parseMaze(const std::string& mazestr, int& m, int& n, std::string& bytes)
+{
+    char sep1 = 0;
+    char sep2 = 0;
+    std::istringstream dims(mazestr);
+    if (!(dims >> m >> sep1 >> n >> sep2) || sep1 != ':' || sep2 != ':' ||
+        m < 2 || n < 2 || m > 256 || n > 256)
+        return false;
+
+    std::string hex;
+    std::string rest;
+    std::getline(dims, rest);
+    for (char c : rest)
+    {
+        if (c != ':')
+            hex += c;
+    }
+
+    if (hex.size() != 2 * corpusRecordSize(m, n))
+        return false;
+
+    bytes.resize(hex.size() / 2);
+    for (std::size_t k = 0; k < bytes.size(); ++k)
+    {
+        int value = 0;
+        for (int d = 0; d < 2; ++d)
+        {
+            char c = hex[2 * k + d];
+            value *= 16;
+            if (c >= '0' && c <= '9')
+                value += c - '0';
+            else if (c >= 'a' && c <= 'f')
+                value += c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                value += c - 'A' + 10;
+            else
+                return false;
+        }
+        bytes[k] = char(value);
+    }
+
+    return true;
+}
+
+
+int pack(std::istream& in, const std::string& outPath)
+{
+    CorpusWriter writer;
+    int rows = 0;
+    int cols = 0;
+    std::string line;
+    std::string bytes;
+    int lineNo = 0;
+
+    while (std::getline(in, line))
+    {
+        ++lineNo;
+
+        std::istringstream ss(line);
+        std::string mazestr;
+        if (!(ss >> mazestr) || mazestr[0] == '#')
+            continue;
+
+        int m = 0;
+        int n = 0;
+        if (!parseMaze(mazestr, m, n, bytes))
+        {
+            std::cerr << "line " << lineNo << ": malformed maze" << std::endl;
+            return 1;
+        }
+
+        if (rows == 0)
+        {
+            rows = m;
+            cols = n;
+            if (!writer.open(outPath, rows, cols))
+            {
+                std::cerr << "cannot write " << outPath << std::endl;
+                return 2;
+            }
+        }
+        else if (m != rows || n != cols)
+        {
+            std::cerr << "line " << lineNo << ": maze is " << m << 'x' << n
+                      << ", expected " << rows << 'x' << cols << std::endl;
+            return 1;
+        }
+
+        if (!writer.append(reinterpret_cast<const unsigned char*>(bytes.data())))
+        {
+            std::cerr << "cannot write " << outPath << std::endl;
+            return 2;
+        }
+    }
+
+    if (rows == 0)
+    {
+        std::cerr << "no mazes in input" << std::endl;
+        return 1;
+    }
+
+    if (!writer.close())
+    {
+        std::cerr << "cannot write " << outPath << std::endl;
+        return 2;
+    }
+
+    return 0;
+}
+
+
+int unpack(const Corpus& corpus)
+{
+    static const char digits[] = "0123456789abcdef";
+    int mBytes = ((corpus.rows() - 1) * corpus.cols() + 7) / 8;
+    int size = corpusRecordSize(corpus.rows(), corpus.cols());
+    std::string line;
+
+    for (std::size_t k = 0; k < corpus.size(); ++k)
+    {
+        const unsigned char* record = corpus.record(k);
+
+        line = std::to_string(corpus.rows()) + ':' + std::to_string(corpus.cols()) + ':';
+        for (int b = 0; b < size; ++b)
+        {
+            if (b == mBytes)
+                line += ':';
+            line += digits[record[b] >> 4];
+            line += digits[record[b] & 0xf];
+        }
+        line += '\n';
+        std::cout << line;
+    }
+
+    return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    if (argc < 3)
+        return usage(argv[0]);
+
+    std::string command = argv[1];
+
+    if (command == "pack")
+    {
+        if (argc == 3)
+            return pack(std::cin, argv[2]);
+        if (argc != 4)
+            return usage(argv[0]);
+
+        std::ifstream file(argv[2]);
+        if (!file)
+        {
+            std::cerr << argv[0] << ": cannot open " << argv[2] << std::endl;
+            return 2;
+        }
+        return pack(file, argv[3]);
+    }
+
+    if ((command != "unpack" && command != "info") || argc != 3)
+        return usage(argv[0]);
+
+    Corpus corpus;
+    if (!corpus.open(argv[2]))
+    {
+        std::cerr << argv[0] << ": " << corpus.error() << std::endl;
+        return 2;
+    }
+
+    if (command == "unpack")
+        return unpack(corpus);
+
+    std::cout << corpus.rows() << 'x' << corpus.cols() << ' '
+              << corpus.size() << " mazes" << std::endl;
+    return 0;
+}
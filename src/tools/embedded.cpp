@@ -0,0 +1,178 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "Embedded.hpp"
+#include "Corpus.hpp"
+
+
+/* Runs the embedded profile of the solver (see Embedded.hpp) over a corpus,
+ * the way the mouse would run it, and reports what it costs per step.
+ *
+ *     maze-embedded corpus.mzc [count]
+ *
+ * Built with MAZE_EMBEDDED, -fno-exceptions and -fno-rtti and without the
+ * core library. Every allocation aborts, so a run that completes used no
+ * heap. 16x16 and 32x32 corpora are supported. As in maze-farm, the mouse
+ * starts in the corner (m - 1, 0) and the goal is the cell (m / 2, n / 2);
+ * each maze gets a search run and a mapping run.
+ *
+ * Prints the RAM used by the explorer and, per run, the number of steps,
+ * the mean and maximum time of one step and the mean and maximum number of
+ * cells the planners expanded in one step.
+ */
+
+
+void* operator new(std::size_t)
+{
+    std::fputs("maze-embedded: heap allocation in the embedded profile\n", stderr);
+    std::abort();
+}
+
+
+void* operator new[](std::size_t)
+{
+    std::fputs("maze-embedded: heap allocation in the embedded profile\n", stderr);
+    std::abort();
+}
+
+
+void operator delete(void*) noexcept {}
+void operator delete[](void*) noexcept {}
+
+
+struct StepCost
+{
+    long steps = 0;
+    std::int64_t totalNs = 0;
+    std::int64_t maxNs = 0;
+    long totalCells = 0;
+    long maxCells = 0;
+
+    void add(std::int64_t ns, long cells)
+    {
+        ++steps;
+        totalNs += ns;
+        totalCells += cells;
+        if (ns > maxNs)
+            maxNs = ns;
+        if (cells > maxCells)
+            maxCells = cells;
+    }
+
+    void print(const char* run) const
+    {
+        long k = steps > 0 ? steps : 1;
+        std::printf("%-8s %9ld steps %9.0f ns/step mean %9lld ns/step max %8.1f cells/step mean %6ld cells/step max\n",
+                    run, steps, double(totalNs) / k, (long long)maxNs, double(totalCells) / k, maxCells);
+    }
+};
+
+
+// Runs one step and adds its time and expansions to cost
+template<int m, int n>
+bool timedStep(Explorer<m, n>& explorer, const Maze<m, n>& maze, StepCost& cost)
+{
+    long before = explorer.expanded();
+    auto t0 = std::chrono::steady_clock::now();
+    bool more = explorer.step(maze);
+    auto t1 = std::chrono::steady_clock::now();
+    cost.add(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count(),
+             explorer.expanded() - before);
+    return more;
+}
+
+
+template<int m, int n>
+int run(std::FILE* file, const CorpusHeader& header, std::uint64_t count)
+{
+    // Static, as on the mouse
+    static Explorer<m, n> explorer;
+    static Maze<m, n> maze;
+    static unsigned char record[Maze<m, n>::byteCount];
+
+    const Node start = {m - 1, 0};
+    const Node goal = {m / 2, n / 2};
+    const int stepLimit = 16 * m * n;
+
+    if (header.recordSize != sizeof(record))
+    {
+        std::fprintf(stderr, "maze-embedded: unexpected record size %u\n", unsigned(header.recordSize));
+        return 1;
+    }
+
+    StepCost search;
+    StepCost mapping;
+    long unsolved = 0;
+
+    for (std::uint64_t k = 0; k < count; ++k)
+    {
+        if (std::fread(record, 1, sizeof(record), file) != sizeof(record))
+        {
+            std::fprintf(stderr, "maze-embedded: corpus ends after %llu mazes\n", (unsigned long long)k);
+            return 1;
+        }
+        maze.loadBytes(record);
+
+        explorer.beginSearch(maze, start, goal);
+        for (int s = 0; s < stepLimit && timedStep(explorer, maze, search); ++s)
+            ;
+        if (!(explorer.position() == goal))
+            ++unsolved;
+
+        explorer.beginMapping(maze, start, goal);
+        for (int s = 0; s < stepLimit && timedStep(explorer, maze, mapping); ++s)
+            ;
+    }
+
+    std::printf("%dx%d, %llu mazes, explorer %u bytes (budget %u)\n", m, n,
+                (unsigned long long)count, unsigned(sizeof(explorer)),
+                unsigned(m <= 16 ? embeddedBudget16 : embeddedBudget32));
+    search.print("search");
+    mapping.print("mapping");
+    if (unsolved > 0)
+        std::printf("%ld mazes not solved within %d steps\n", unsolved, stepLimit);
+
+    return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::fputs("usage: maze-embedded corpus.mzc [count]\n", stderr);
+        return 1;
+    }
+
+    // The header is decoded as Corpus does, whatever the host's byte order
+    std::FILE* file = std::fopen(argv[1], "rb");
+    unsigned char bytes[sizeof(CorpusHeader)];
+    CorpusHeader header = {};
+    if (file && std::fread(bytes, sizeof(bytes), 1, file) == 1)
+        decodeCorpusHeader(bytes, header);
+    if (!file || std::memcmp(header.magic, corpusMagic, sizeof(corpusMagic)) != 0)
+    {
+        std::fprintf(stderr, "maze-embedded: %s is not a maze corpus\n", argv[1]);
+        if (file)
+            std::fclose(file);
+        return 1;
+    }
+
+    std::uint64_t count = header.count;
+    if (argc == 3 && std::strtoull(argv[2], nullptr, 10) < count)
+        count = std::strtoull(argv[2], nullptr, 10);
+
+    int status = 1;
+    if (header.rows == 16 && header.cols == 16)
+        status = run<16, 16>(file, header, count);
+    else if (header.rows == 32 && header.cols == 32)
+        status = run<32, 32>(file, header, count);
+    else
+        std::fprintf(stderr, "maze-embedded: %ux%u mazes are not supported\n", unsigned(header.rows), unsigned(header.cols));
+
+    std::fclose(file);
+    return status;
+}
@@ -0,0 +1,491 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Maze.hpp"
+#include "Corpus.hpp"
+#include "Generator.hpp"
+#include "Farm.hpp"
+#include "Parallel.hpp"
+#include "Symmetry.hpp"
+#include "ResultCache.hpp"
+#include "Trace.hpp"
+
+
+/* Simulation farm: runs the exploration on every maze of a corpus, or of a
+ * generated batch, on all cores.
+ *
+ *     maze-farm [-j threads] [-o out.csv] [-p policy] [-t trace] [-r dir] [-k cache] [-v] -c corpus.mzc
+ *     maze-farm [-j threads] [-o out.csv] [-p policy] [-t trace] [-r dir] [-k cache] [-v] [-a algorithm] [-s seed] [-n count] [-m size]
+ *
+ * The generator options are the same as for maze-gen, so maze k here is
+ * maze k of the same maze-gen batch. Square mazes of size 8, 16, 32, 64, 128
+ * and 256 are supported. The mouse starts in the corner (m - 1, 0) and the
+ * goal is the cell (m / 2, n / 2).
+ *
+ * -p selects the exploration policy of the mapping run (see Policy.hpp):
+ * candidate (the default), nearest or floodfill. Each policy is compiled
+ * into its own instantiation of the farm.
+ *
+ * -t trace.json (or trace.csv) writes the trace of the run, as Chrome trace
+ * JSON or CSV, from a build made with make TRACE=1 (see Trace.hpp).
+ *
+ * -r dir runs every maze that failed again, recording both runs, and writes
+ * the recordings to dir/k-search.mzr and dir/k-mapping.mzr for maze k (see
+ * Recording.hpp), to be replayed in the GUI. A maze fails if the search does
+ * not reach the goal, mapping is cut off or the final path scores worse than
+ * the best path. The directory must exist.
+ *
+ * -k cache keeps the results in a persistent cache file (see
+ * ResultCache.hpp), so that a maze that was simulated before, in this run
+ * or an earlier one, is not simulated again. Entries are keyed by the maze,
+ * start and goal exactly (noSymmetries in Symmetry.hpp): the explorer breaks
+ * ties by direction, so a rotated or mirrored maze may give other results.
+ * The cache therefore saves work on repeated corpora and mazes imported more
+ * than once, and the output is the same as without -k. Entries are stamped
+ * with farmResultVersion (see Farm.hpp), so results of older code are
+ * ignored.
+ *
+ * Writes one CSV row per maze, in corpus order:
+ *     index,visited,inferred,search_steps,goal_steps,mapping_steps,score,best_score
+ * -v also plans the fastest speed run after mapping and in the true maze
+ * (see SpeedRun.hpp) and adds the columns run_time,best_run_time in
+ * seconds; each thread then holds a planner, 160 MB at 256x256. See
+ * FarmResult for the meaning of each column. A summary with the means and
+ * the throughput is printed on stderr.
+ */
+
+
+enum class PolicyKind
+{
+    Candidate,
+    Nearest,
+    FloodFill
+};
+
+
+struct Options
+{
+    PolicyKind policy = PolicyKind::Candidate;
+    std::string corpus;
+    MazeAlgorithm algorithm = MazeAlgorithm::Micromouse;
+    std::uint64_t seed = 1;
+    long count = 1000;
+    int size = 16;
+    int threads = 0;
+    std::string out;
+    std::string trace;
+    std::string recordings;
+    std::string cache;
+    bool speedRuns = false;
+};
+
+
+bool parsePolicy(const std::string& name, PolicyKind& policy);
+
+template<template<int, int> class Policy>
+bool farm(const Options& options, const Corpus* corpus, std::ostream& out);
+
+template<int m, int n, class Policy>
+bool farm(const Options& options, const Corpus* corpus, std::ostream& out);
+
+template<int m, int n, class Policy>
+long recordFailures(const Options& options, const Corpus* corpus,
+                    const std::vector<FarmResult>& results);
+
+template<int m, int n>
+void loadMaze(const Options& options, const Corpus* corpus, long k,
+              MazeGenerator<m, n>& generator, Maze<m, n>& maze);
+
+std::string cacheTag(const Options& options);
+std::string formatResult(const FarmResult& r);
+bool parseResult(const std::string& text, FarmResult& r);
+
+ResultCache* cache = nullptr;
+
+
+int main(int argc, char** argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    Options options;
+    bool usage = false;
+
+    for (int arg = 1; arg < argc && !usage; ++arg)
+    {
+        std::string opt = argv[arg];
+        if (opt == "-v")
+            options.speedRuns = true;
+        else if (arg + 1 >= argc)
+            usage = true;
+        else if (opt == "-c")
+            options.corpus = argv[++arg];
+        else if (opt == "-p")
+            usage = !parsePolicy(argv[++arg], options.policy);
+        else if (opt == "-a")
+            usage = !parseAlgorithm(argv[++arg], options.algorithm);
+        else if (opt == "-s")
+            options.seed = std::strtoull(argv[++arg], nullptr, 10);
+        else if (opt == "-n")
+            options.count = std::atol(argv[++arg]);
+        else if (opt == "-m")
+            options.size = std::atoi(argv[++arg]);
+        else if (opt == "-j")
+            options.threads = std::atoi(argv[++arg]);
+        else if (opt == "-o")
+            options.out = argv[++arg];
+        else if (opt == "-t")
+            options.trace = argv[++arg];
+        else if (opt == "-r")
+            options.recordings = argv[++arg];
+        else if (opt == "-k")
+            options.cache = argv[++arg];
+        else
+            usage = true;
+    }
+
+    if (usage || options.count < 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [-j threads] [-o out.csv] [-p candidate|nearest|floodfill]"
+                  << " [-t trace] [-r dir] [-k cache] [-v] -c corpus.mzc" << std::endl
+                  << "       " << argv[0] << " [-j threads] [-o out.csv] [-p candidate|nearest|floodfill]"
+                  << " [-t trace] [-r dir] [-k cache] [-v] [-a backtracker|kruskal|wilson|micromouse] [-s seed] [-n count] [-m size]" << std::endl;
+        return 2;
+    }
+
+    if (options.threads <= 0)
+        options.threads = defaultThreads();
+
+    Corpus corpus;
+    if (!options.corpus.empty())
+    {
+        if (!corpus.open(options.corpus))
+        {
+            std::cerr << argv[0] << ": " << corpus.error() << std::endl;
+            return 2;
+        }
+        if (corpus.rows() != corpus.cols())
+        {
+            std::cerr << argv[0] << ": only square mazes are supported" << std::endl;
+            return 2;
+        }
+        options.size = corpus.rows();
+        options.count = corpus.size();
+    }
+
+    std::ofstream file;
+    if (!options.out.empty())
+    {
+        file.open(options.out);
+        if (!file)
+        {
+            std::cerr << argv[0] << ": cannot write " << options.out << std::endl;
+            return 2;
+        }
+    }
+    std::ostream& out = options.out.empty() ? std::cout : file;
+
+    ResultCache results;
+    if (!options.cache.empty())
+    {
+        if (!results.open(options.cache))
+        {
+            std::cerr << argv[0] << ": " << results.error() << std::endl;
+            return 2;
+        }
+        cache = &results;
+    }
+    const Corpus* source = options.corpus.empty() ? nullptr : &corpus;
+
+    if (options.size != 8 && options.size != 16 && options.size != 32 &&
+        options.size != 64 && options.size != 128 && options.size != 256)
+    {
+        std::cerr << argv[0] << ": unsupported maze size " << options.size << std::endl;
+        return 2;
+    }
+
+    bool ok;
+    switch (options.policy)
+    {
+    case PolicyKind::Nearest:   ok = farm<NearestUnvisited>(options, source, out); break;
+    case PolicyKind::FloodFill: ok = farm<FloodFillToCenter>(options, source, out); break;
+    default:                    ok = farm<CandidateFirst>(options, source, out); break;
+    }
+
+    if (!options.trace.empty())
+    {
+        if (!traceEnabled)
+            std::cerr << argv[0] << ": built without MAZE_TRACE, the trace is empty" << std::endl;
+        if (!writeTrace(options.trace))
+        {
+            std::cerr << argv[0] << ": cannot write " << options.trace << std::endl;
+            return 2;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
+
+
+bool parsePolicy(const std::string& name, PolicyKind& policy)
+{
+    if (name == "candidate")
+        policy = PolicyKind::Candidate;
+    else if (name == "nearest")
+        policy = PolicyKind::Nearest;
+    else if (name == "floodfill")
+        policy = PolicyKind::FloodFill;
+    else
+        return false;
+    return true;
+}
+
+
+// Dispatches on the maze size, which main() has checked
+template<template<int, int> class Policy>
+bool farm(const Options& options, const Corpus* corpus, std::ostream& out)
+{
+    switch (options.size)
+    {
+    case 8:   return farm<8, 8, Policy<8, 8>>(options, corpus, out);
+    case 16:  return farm<16, 16, Policy<16, 16>>(options, corpus, out);
+    case 32:  return farm<32, 32, Policy<32, 32>>(options, corpus, out);
+    case 64:  return farm<64, 64, Policy<64, 64>>(options, corpus, out);
+    case 128: return farm<128, 128, Policy<128, 128>>(options, corpus, out);
+    default:  return farm<256, 256, Policy<256, 256>>(options, corpus, out);
+    }
+}
+
+
+template<int m, int n, class Policy>
+bool farm(const Options& options, const Corpus* corpus, std::ostream& out)
+{
+    // Everything a worker touches is its own; only the results are shared,
+    // and each maze writes a different entry
+    struct Worker
+    {
+        FarmWorkspace<m, n, Policy> work;
+        MazeGenerator<m, n> generator;
+        Maze<m, n> maze;
+        CanonicalMaze<m, n> canonical;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int t = 0; t < options.threads; ++t)
+    {
+        workers.emplace_back(new Worker);
+        if (options.speedRuns)
+            workers.back()->work.planner.reset(new SpeedRunPlanner<m, n>);
+    }
+
+    std::vector<FarmResult> results(options.count);
+    Node start = {m - 1, 0};
+    Node goal = {m / 2, n / 2};
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    long simulated = options.count;
+    if (!cache)
+    {
+        parallelFor(options.count, options.threads, [&](int t, long k) {
+            Worker& w = *workers[t];
+            loadMaze(options, corpus, k, w.generator, w.maze);
+            results[k] = simulateMaze(w.maze, start, goal, w.work);
+        });
+    }
+    else
+    {
+        std::vector<MazeKey> keys(options.count);
+        parallelFor(options.count, options.threads, [&](int t, long k) {
+            Worker& w = *workers[t];
+            loadMaze(options, corpus, k, w.generator, w.maze);
+            w.canonical.compute(w.maze, start, goal, noSymmetries);
+            keys[k] = w.canonical.key();
+        });
+
+        // Simulate the first maze of each key that is not in the cache, and
+        // give the others its result
+        std::string tag = cacheTag(options);
+        std::vector<long> todo;
+        std::vector<long> same(options.count, -1);
+        std::map<MazeKey, long> first;
+        for (long k = 0; k < options.count; ++k)
+        {
+            const std::string* value = cache->find(keys[k], tag);
+            if (value && parseResult(*value, results[k]))
+                continue;
+            auto it = first.insert(std::make_pair(keys[k], k)).first;
+            if (it->second == k)
+                todo.push_back(k);
+            else
+                same[k] = it->second;
+        }
+
+        parallelFor(todo.size(), options.threads, [&](int t, long x) {
+            Worker& w = *workers[t];
+            long k = todo[x];
+            loadMaze(options, corpus, k, w.generator, w.maze);
+            results[k] = simulateMaze(w.maze, start, goal, w.work);
+        });
+
+        for (long k : todo)
+            if (!cache->insert(keys[k], tag, formatResult(results[k])))
+                std::cerr << "cannot write to the cache " << options.cache << std::endl;
+        for (long k = 0; k < options.count; ++k)
+            if (same[k] >= 0)
+                results[k] = results[same[k]];
+        simulated = todo.size();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    double visited = 0;
+    double mappingSteps = 0;
+    double scoreRatio = 0;
+    long reached = 0;
+
+    // Runs without a plan, after mapping or in the true maze, are left out
+    // of the mean and counted apart
+    double runRatio = 0;
+    long planned = 0;
+
+    out << "index,visited,inferred,search_steps,goal_steps,mapping_steps,score,best_score"
+        << (options.speedRuns ? ",run_time,best_run_time\n" : "\n");
+    for (long k = 0; k < options.count; ++k)
+    {
+        const FarmResult& r = results[k];
+        out << k << ',' << r.visited << ',' << r.inferred << ','
+            << r.searchSteps << ',' << r.goalSteps << ',' << r.mappingSteps << ','
+            << r.score << ',' << r.bestScore;
+        if (options.speedRuns)
+        {
+            out << ',' << r.runTime << ',' << r.bestRunTime;
+            if (r.runTime >= 0.f && r.bestRunTime >= 0.f)
+            {
+                runRatio += r.runTime / r.bestRunTime;
+                ++planned;
+            }
+        }
+        out << '\n';
+
+        visited += r.visited;
+        mappingSteps += r.mappingSteps;
+        scoreRatio += r.score / r.bestScore;
+        reached += r.searchSteps >= 0;
+    }
+    out.flush();
+
+    long recorded = options.recordings.empty() ? 0 : recordFailures<m, n, Policy>(options, corpus, results);
+    if (recorded < 0)
+        return false;
+
+    if (options.count > 0)
+    {
+        std::cerr << options.count << " mazes in " << seconds << " s ("
+                  << options.count / seconds << " mazes/s, " << options.threads << " threads)" << std::endl
+                  << "search reached goal: " << reached << '/' << options.count
+                  << ", mean visited: " << visited / options.count
+                  << ", mean mapping steps: " << mappingSteps / options.count
+                  << ", mean score / best: " << scoreRatio / options.count << std::endl;
+        if (options.speedRuns)
+            std::cerr << "mean run time / best: " << (planned > 0 ? runRatio / planned : 0.)
+                      << ", speed runs without a plan: " << options.count - planned << std::endl;
+        if (cache)
+            std::cerr << "simulated " << simulated << ", " << options.count - simulated
+                      << " from the cache or duplicates" << std::endl;
+    }
+    if (!options.recordings.empty())
+        std::cerr << recorded << " failed mazes recorded in " << options.recordings << std::endl;
+
+    return bool(out);
+}
+
+
+// Runs the failed mazes again with recordings and writes them. Returns the
+// number of mazes recorded, or -1 if a recording could not be written.
+template<int m, int n, class Policy>
+long recordFailures(const Options& options, const Corpus* corpus,
+                    const std::vector<FarmResult>& results)
+{
+    std::unique_ptr<FarmWorkspace<m, n, Policy>> work(new FarmWorkspace<m, n, Policy>);
+    std::unique_ptr<MazeGenerator<m, n>> generator(new MazeGenerator<m, n>);
+    std::unique_ptr<Maze<m, n>> maze(new Maze<m, n>);
+    RunRecording<m, n> searchRun;
+    RunRecording<m, n> mappingRun;
+    long recorded = 0;
+
+    for (long k = 0; k < options.count; ++k)
+    {
+        if (!resultFailed(results[k], Simulator<m, n>::stepLimit()))
+            continue;
+
+        Node start = {m - 1, 0};
+        Node goal = {m / 2, n / 2};
+        loadMaze(options, corpus, k, *generator, *maze);
+
+        // Corpus mazes are recorded with seed 0 and their index as stream
+        searchRun.setSeed(corpus ? 0 : options.seed, k);
+        mappingRun.setSeed(corpus ? 0 : options.seed, k);
+        simulateMaze(*maze, start, goal, *work, &searchRun, &mappingRun);
+
+        std::string base = options.recordings + "/" + std::to_string(k);
+        std::ofstream searchFile(base + "-search.mzr", std::ios::binary);
+        std::ofstream mappingFile(base + "-mapping.mzr", std::ios::binary);
+        if (!searchRun.save(searchFile) || !mappingRun.save(mappingFile))
+        {
+            std::cerr << "cannot write the recordings of maze " << k << " to " << options.recordings << std::endl;
+            return -1;
+        }
+        ++recorded;
+    }
+
+    return recorded;
+}
+
+
+template<int m, int n>
+void loadMaze(const Options& options, const Corpus* corpus, long k,
+              MazeGenerator<m, n>& generator, Maze<m, n>& maze)
+{
+    if (corpus)
+        corpus->view<m, n>(k).copyTo(maze);
+    else
+        generator.generate(maze, options.algorithm, options.seed, k);
+}
+
+
+// Results are cached per version of the simulation, per policy, and with
+// speed runs or without
+std::string cacheTag(const Options& options)
+{
+    const char* policy = options.policy == PolicyKind::Nearest ? "nearest" :
+                         options.policy == PolicyKind::FloodFill ? "floodfill" : "candidate";
+    return "farm" + std::to_string(farmResultVersion) + "-" + policy + (options.speedRuns ? "-v" : "");
+}
+
+
+// The fields of FarmResult in order, with enough digits to read the floats
+// back exactly
+std::string formatResult(const FarmResult& r)
+{
+    std::ostringstream ss;
+    ss.precision(9);
+    ss << r.visited << ' ' << r.inferred << ' ' << r.searchSteps << ' ' << r.goalSteps << ' '
+       << r.mappingSteps << ' ' << r.score << ' ' << r.bestScore << ' '
+       << r.runTime << ' ' << r.bestRunTime;
+    return ss.str();
+}
+
+
+bool parseResult(const std::string& text, FarmResult& r)
+{
+    std::istringstream ss(text);
+    return bool(ss >> r.visited >> r.inferred >> r.searchSteps >> r.goalSteps
+                   >> r.mappingSteps >> r.score >> r.bestScore
+                   >> r.runTime >> r.bestRunTime);
+}
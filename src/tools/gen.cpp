@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Maze.hpp"
+#include "Generator.hpp"
+#include "Corpus.hpp"
+#include "Parallel.hpp"
+
+
+/* Generates mazes in bulk.
+ *
+ *     maze-gen [-a algorithm] [-s seed] [-n count] [-m size] [-j threads] [-o out.mzc]
+ *
+ *     -a   backtracker, kruskal, wilson or micromouse (default micromouse)
+ *     -s   seed (default 1)
+ *     -n   number of mazes (default 1)
+ *     -m   maze size, 8, 16, 32, 64, 128 or 256 (default 16)
+ *     -j   number of threads (default: all cores)
+ *     -o   write a binary corpus instead of maze strings on stdout
+ *
+ * Maze k is generated from stream k of the seed, so the output depends only
+ * on the algorithm, seed, size and count, not on the number of threads. The
+ * throughput is reported on stderr.
+ */
+
+
+struct Options
+{
+    MazeAlgorithm algorithm = MazeAlgorithm::Micromouse;
+    std::uint64_t seed = 1;
+    long count = 1;
+    int size = 16;
+    int threads = 0;
+    std::string out;
+};
+
+
+template<int m, int n>
+bool generate(const Options& options);
+
+
+int main(int argc, char** argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    Options options;
+    bool usage = false;
+
+    for (int arg = 1; arg < argc && !usage; ++arg)
+    {
+        std::string opt = argv[arg];
+        if (arg + 1 >= argc)
+            usage = true;
+        else if (opt == "-a")
+            usage = !parseAlgorithm(argv[++arg], options.algorithm);
+        else if (opt == "-s")
+            options.seed = std::strtoull(argv[++arg], nullptr, 10);
+        else if (opt == "-n")
+            options.count = std::atol(argv[++arg]);
+        else if (opt == "-m")
+            options.size = std::atoi(argv[++arg]);
+        else if (opt == "-j")
+            options.threads = std::atoi(argv[++arg]);
+        else if (opt == "-o")
+            options.out = argv[++arg];
+        else
+            usage = true;
+    }
+
+    if (usage || options.count < 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [-a backtracker|kruskal|wilson|micromouse]"
+                  << " [-s seed] [-n count] [-m size] [-j threads] [-o out.mzc]" << std::endl;
+        return 2;
+    }
+
+    if (options.threads <= 0)
+        options.threads = defaultThreads();
+
+    bool ok;
+    switch (options.size)
+    {
+    case 8:   ok = generate<8, 8>(options); break;
+    case 16:  ok = generate<16, 16>(options); break;
+    case 32:  ok = generate<32, 32>(options); break;
+    case 64:  ok = generate<64, 64>(options); break;
+    case 128: ok = generate<128, 128>(options); break;
+    case 256: ok = generate<256, 256>(options); break;
+    default:
+        std::cerr << argv[0] << ": unsupported maze size " << options.size << std::endl;
+        return 2;
+    }
+
+    return ok ? 0 : 1;
+}
+
+
+// Mazes are made in blocks: all threads fill one block, then the block is
+// written out in order
+template<int m, int n>
+bool generate(const Options& options)
+{
+    const long blockSize = 16384;
+    const int recordSize = Maze<m, n>::byteCount;
+
+    CorpusWriter writer;
+    if (!options.out.empty() && !writer.open(options.out, m, n))
+    {
+        std::cerr << "cannot write " << options.out << std::endl;
+        return false;
+    }
+
+    struct Worker
+    {
+        MazeGenerator<m, n> generator;
+        Maze<m, n> maze;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int t = 0; t < options.threads; ++t)
+        workers.emplace_back(new Worker);
+
+    std::vector<unsigned char> block(std::min(blockSize, options.count) * recordSize);
+    std::unique_ptr<Maze<m, n>> text(new Maze<m, n>);
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (long first = 0; first < options.count; first += blockSize)
+    {
+        long size = std::min(blockSize, options.count - first);
+
+        parallelFor(size, options.threads, [&](int t, long k) {
+            Worker& w = *workers[t];
+            w.generator.generate(w.maze, options.algorithm, options.seed, first + k);
+            w.maze.saveBytes(&block[k * recordSize]);
+        }, 64);
+
+        for (long k = 0; k < size; ++k)
+        {
+            if (!options.out.empty())
+            {
+                if (!writer.append(&block[k * recordSize]))
+                {
+                    std::cerr << "cannot write " << options.out << std::endl;
+                    return false;
+                }
+            }
+            else
+            {
+                text->loadBytes(&block[k * recordSize]);
+                std::cout << text->save() << '\n';
+            }
+        }
+    }
+
+    if (!writer.close())
+    {
+        std::cerr << "cannot write " << options.out << std::endl;
+        return false;
+    }
+    std::cout.flush();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cerr << options.count << " " << m << 'x' << n << " mazes ("
+              << algorithmName(options.algorithm) << ", " << options.threads
+              << " threads) in " << seconds << " s, "
+              << options.count / seconds << " mazes/s" << std::endl;
+
+    return true;
+}